@@ -1,43 +1,52 @@
 #pragma once
 #include "vector4.h"
 #include <limits>
+#include <cstring>
 
 namespace Math3d
 {
+	// Column-major 4x4 matrix. Trivially copyable (arrays of it can be
+	// memcpy'd) and a literal type: the constexpr members below can build
+	// transform tables at compile time. The default constructor leaves the
+	// elements uninitialized.
 	template<class T> 
 	class StaticMatrix4
 	{
 	private:
 		T data[16];
+
+		constexpr T product(const StaticMatrix4<T>& mm, const int row, const int column) const;
 	public:
-		StaticMatrix4(void);
+		StaticMatrix4() = default;
 		StaticMatrix4(T* data);
-		StaticMatrix4(const Math3d::Vector4D<T>& c1, const Math3d::Vector4D<T>& c2, const Math3d::Vector4D<T>& c3, const Math3d::Vector4D<T>& c4);
-		~StaticMatrix4(void);
+		// Elements in column-major order
+		constexpr StaticMatrix4(T m0, T m1, T m2, T m3, T m4, T m5, T m6, T m7, T m8, T m9, T m10, T m11, T m12, T m13, T m14, T m15);
+		constexpr StaticMatrix4(const Math3d::Vector4D<T>& c1, const Math3d::Vector4D<T>& c2, const Math3d::Vector4D<T>& c3, const Math3d::Vector4D<T>& c4);
 
 		void setRow(const int row, const Math3d::Vector4D<T>& v);
 		void setColumn(const int column, const Math3d::Vector4D<T>& v);
-		Math3d::Vector4D<T> getRow(const int row) const;
-		Math3d::Vector4D<T> getColumn(const int column) const;
+		constexpr Math3d::Vector4D<T> getRow(const int row) const;
+		constexpr Math3d::Vector4D<T> getColumn(const int column) const;
 
 		void negateRow(const int row);
 		void negateColumn(const int column);
 
 		inline const T* getData() const;
+		inline T* getData();
 
-		inline T get(const int row, const int column) const;
+		constexpr T get(const int row, const int column) const;
 		inline void set(const int row, const int column, const T v);
 		inline void set(const int offset, const T v);
 
-		static StaticMatrix4 identity();
+		static constexpr StaticMatrix4 identity();
 
 		// Transforms
 		static StaticMatrix4 rotationX(const T angle);
 		static StaticMatrix4 rotationY(const T angle);
 		static StaticMatrix4 rotationZ(const T angle);
 		static StaticMatrix4 rotation(const T angle, const Math3d::Vector3D<T>& axis);
-		static StaticMatrix4 scale(const Math3d::Vector3D<T>& size);
-		static StaticMatrix4 translation(const Math3d::Vector3D<T>& position);
+		static constexpr StaticMatrix4 scale(const Math3d::Vector3D<T>& size);
+		static constexpr StaticMatrix4 translation(const Math3d::Vector3D<T>& position);
 		static StaticMatrix4 perspProj(const T fov, const T aspect, const T near, const T far);
 		static void look_at(const Math3d::Vector3D<T>& position, const Math3d::Vector3D<T>& target, const Math3d::Vector3D<T>& up, StaticMatrix4<T>& out_lookat);
 		Math3d::Vector3D<T> get_rotation() const;
@@ -47,18 +56,14 @@ namespace Math3d
 		StaticMatrix4 getInverse() const;
 		void getInverse(StaticMatrix4& out_inverse) const;
 
-		StaticMatrix4<T> operator *(const StaticMatrix4<T>& mm);
+		constexpr StaticMatrix4<T> operator *(const StaticMatrix4<T>& mm) const;
 
 	};
 
 	//
-	template<class T> Math3d::Vector4D<T> operator*(const StaticMatrix4<T>& m, const Math3d::Vector4D<T>& v);
-	template<class T> Math3d::Vector4D<T> operator*(const Math3d::Vector4D<T>& v, const StaticMatrix4<T>& m);
+	template<class T> constexpr Math3d::Vector4D<T> operator*(const StaticMatrix4<T>& m, const Math3d::Vector4D<T>& v);
+	template<class T> constexpr Math3d::Vector4D<T> operator*(const Math3d::Vector4D<T>& v, const StaticMatrix4<T>& m);
 
-	template<class T>
-	StaticMatrix4<T>::StaticMatrix4(void)
-	{
-	}
 	template<class T>
 	StaticMatrix4<T>::StaticMatrix4(T* _data)
 	{
@@ -66,15 +71,14 @@ namespace Math3d
 	}
 
 	template<class T>
-	StaticMatrix4<T>::StaticMatrix4(const Math3d::Vector4D<T>& c1, const Math3d::Vector4D<T>& c2, const Math3d::Vector4D<T>& c3, const Math3d::Vector4D<T>& c4)
+	constexpr StaticMatrix4<T>::StaticMatrix4(T m0, T m1, T m2, T m3, T m4, T m5, T m6, T m7, T m8, T m9, T m10, T m11, T m12, T m13, T m14, T m15)
+		: data{ m0, m1, m2, m3, m4, m5, m6, m7, m8, m9, m10, m11, m12, m13, m14, m15 }
 	{
-		this->setColumn( 0, c1 );
-		this->setColumn( 1, c2 );
-		this->setColumn( 2, c3 );
-		this->setColumn( 3, c4 );
 	}
+
 	template<class T>
-	StaticMatrix4<T>::~StaticMatrix4(void)
+	constexpr StaticMatrix4<T>::StaticMatrix4(const Math3d::Vector4D<T>& c1, const Math3d::Vector4D<T>& c2, const Math3d::Vector4D<T>& c3, const Math3d::Vector4D<T>& c4)
+		: data{ c1.x, c1.y, c1.z, c1.w, c2.x, c2.y, c2.z, c2.w, c3.x, c3.y, c3.z, c3.w, c4.x, c4.y, c4.z, c4.w }
 	{
 	}
 
@@ -95,12 +99,12 @@ namespace Math3d
 		this->set(3,column, v.w);
 	}
 	template<class T>
-	Math3d::Vector4D<T> StaticMatrix4<T>::getRow(const int row) const
+	constexpr Math3d::Vector4D<T> StaticMatrix4<T>::getRow(const int row) const
 	{
 		return Math3d::Vector4D<T>(this->get(row,0), this->get(row,1), this->get(row,2), this->get(row,3));
 	}
 	template<class T>
-	Math3d::Vector4D<T> StaticMatrix4<T>::getColumn(const int column) const
+	constexpr Math3d::Vector4D<T> StaticMatrix4<T>::getColumn(const int column) const
 	{
 		return Math3d::Vector4D<T>(this->get(0,column), this->get(1,column), this->get(2,column), this->get(3,column));
 	}
@@ -129,10 +133,15 @@ namespace Math3d
 	{
 		return this->data;
 	}
+	template<class T>
+	inline T* StaticMatrix4<T>::getData()
+	{
+		return this->data;
+	}
 
 
 	template<class T>
-	inline T StaticMatrix4<T>::get(const int row, const int column) const
+	constexpr T StaticMatrix4<T>::get(const int row, const int column) const
 	{
 		return this->data[row+column*4];
 	}
@@ -147,16 +156,12 @@ namespace Math3d
 		this->data[offset] = v;
 	}
 	template<class T>
-	StaticMatrix4<T> StaticMatrix4<T>::identity()
-	{
-		StaticMatrix4<T> m;
-		
-		m.set(0,0,1); m.set(1,0,0); m.set(2,0,0); m.set(3,0,0);
-		m.set(0,1,0); m.set(1,1,1); m.set(2,1,0); m.set(3,1,0);
-		m.set(0,2,0); m.set(1,2,0); m.set(2,2,1); m.set(3,2,0); 
-		m.set(0,3,0); m.set(1,3,0); m.set(2,3,0); m.set(3,3,1); 
-		
-		return m;
+	constexpr StaticMatrix4<T> StaticMatrix4<T>::identity()
+	{
+		return StaticMatrix4<T>(1,0,0,0,
+								0,1,0,0,
+								0,0,1,0,
+								0,0,0,1);
 	}
 
 	// Transforms
@@ -212,22 +217,20 @@ namespace Math3d
 		return StaticMatrix4(r1, r2, r3, r4);
 	}
 	template<class T>
-	StaticMatrix4<T> StaticMatrix4<T>::scale(const Math3d::Vector3D<T>& size)
+	constexpr StaticMatrix4<T> StaticMatrix4<T>::scale(const Math3d::Vector3D<T>& size)
 	{
-		Math3d::Vector4D<T> r1(size.x,0,0,0);
-		Math3d::Vector4D<T> r2(0,size.y,0,0);
-		Math3d::Vector4D<T> r3(0,0,size.z,0);
-		Math3d::Vector4D<T> r4(0,0,0,1);
-		return StaticMatrix4(r1, r2, r3, r4);
+		return StaticMatrix4<T>(size.x,0,0,0,
+								0,size.y,0,0,
+								0,0,size.z,0,
+								0,0,0,1);
 	}
 	template<class T>
-	StaticMatrix4<T> StaticMatrix4<T>::translation(const Math3d::Vector3D<T>& position)
+	constexpr StaticMatrix4<T> StaticMatrix4<T>::translation(const Math3d::Vector3D<T>& position)
 	{
-		Math3d::Vector4D<T> r1(1,0,0,0);
-		Math3d::Vector4D<T> r2(0,1,0,0);
-		Math3d::Vector4D<T> r3(0,0,1,0);
-		Math3d::Vector4D<T> r4(position.x,position.y,position.z,1);
-		return StaticMatrix4(r1, r2, r3, r4);
+		return StaticMatrix4<T>(1,0,0,0,
+								0,1,0,0,
+								0,0,1,0,
+								position.x,position.y,position.z,1);
 	}
 	template<class T>
 	StaticMatrix4<T> StaticMatrix4<T>::perspProj(const T fov, const T aspect, const T near, const T far)
@@ -288,74 +291,31 @@ namespace Math3d
 	{
 	}
 
+	// Row of this matrix dotted with a column of mm
 	template<class T>
-	StaticMatrix4<T> StaticMatrix4<T>::operator *(const StaticMatrix4<T>& mm)
-	{
-		T newM[16];
-		
-		newM[0] = (this->getRow(0)*mm.getColumn(0));
-		newM[1] = (this->getRow(1)*mm.getColumn(0));
-		newM[2] = (this->getRow(2)*mm.getColumn(0));
-		newM[3] = (this->getRow(3)*mm.getColumn(0));
-
-		newM[4] = (this->getRow(0)*mm.getColumn(1));
-		newM[5] = (this->getRow(1)*mm.getColumn(1));
-		newM[6] = (this->getRow(2)*mm.getColumn(1));
-		newM[7] = (this->getRow(3)*mm.getColumn(1));
-
-		newM[8] = (this->getRow(0)*mm.getColumn(2));
-		newM[9] = (this->getRow(1)*mm.getColumn(2));
-		newM[10] = (this->getRow(2)*mm.getColumn(2));
-		newM[11] = (this->getRow(3)*mm.getColumn(2));
-
-		newM[12] = (this->getRow(0)*mm.getColumn(3));
-		newM[13] = (this->getRow(1)*mm.getColumn(3));
-		newM[14] = (this->getRow(2)*mm.getColumn(3));
-		newM[15] = (this->getRow(3)*mm.getColumn(3));
-
-		/*newM[0] = (this->getColumn(0)*mm.getRow(0));
-		newM[1] = (this->getColumn(1)*mm.getRow(0));
-		newM[2] = (this->getColumn(2)*mm.getRow(0));
-		newM[3] = (this->getColumn(3)*mm.getRow(0));
-
-		newM[4] = (this->getColumn(0)*mm.getRow(1));
-		newM[5] = (this->getColumn(1)*mm.getRow(1));
-		newM[6] = (this->getColumn(2)*mm.getRow(1));
-		newM[7] = (this->getColumn(3)*mm.getRow(1));
-
-		newM[8] = (this->getColumn(0)*mm.getRow(2));
-		newM[9] = (this->getColumn(1)*mm.getRow(2));
-		newM[10] = (this->getColumn(2)*mm.getRow(2));
-		newM[11] = (this->getColumn(3)*mm.getRow(2));
-
-		newM[12] = (this->getColumn(0)*mm.getRow(3));
-		newM[13] = (this->getColumn(1)*mm.getRow(3));
-		newM[14] = (this->getColumn(2)*mm.getRow(3));
-		newM[15] = (this->getColumn(3)*mm.getRow(3));*/
-		
-		return StaticMatrix4<T>(newM);
+	constexpr T StaticMatrix4<T>::product(const StaticMatrix4<T>& mm, const int row, const int column) const
+	{
+		return data[row]*mm.data[column*4] + data[row+4]*mm.data[column*4+1] + data[row+8]*mm.data[column*4+2] + data[row+12]*mm.data[column*4+3];
 	}
 
 	template<class T>
-	Math3d::Vector4D<T> operator *(const StaticMatrix4<T>& m, const Math3d::Vector4D<T>& v)
-	{
-		Math3d::Vector4D<T> result;
-		result.x = v*m.getRow(0);
-		result.y = v*m.getRow(1);
-		result.z = v*m.getRow(2);
-		result.w = v*m.getRow(3);
-		return result;
+	constexpr StaticMatrix4<T> StaticMatrix4<T>::operator *(const StaticMatrix4<T>& mm) const
+	{
+		return StaticMatrix4<T>(product(mm,0,0), product(mm,1,0), product(mm,2,0), product(mm,3,0),
+								product(mm,0,1), product(mm,1,1), product(mm,2,1), product(mm,3,1),
+								product(mm,0,2), product(mm,1,2), product(mm,2,2), product(mm,3,2),
+								product(mm,0,3), product(mm,1,3), product(mm,2,3), product(mm,3,3));
 	}
+
 	template<class T>
-	Math3d::Vector4D<T> operator*(const Math3d::Vector4D<T>& v, const StaticMatrix4<T>& m)
+	constexpr Math3d::Vector4D<T> operator *(const StaticMatrix4<T>& m, const Math3d::Vector4D<T>& v)
 	{
-		Math3d::Vector4D<T> result;
-		result.x = v*m.getColumn(0);
-		result.y = v*m.getColumn(1);
-		result.z = v*m.getColumn(2);
-		result.w = v*m.getColumn(3);
-
-		return result;
+		return Math3d::Vector4D<T>(v*m.getRow(0), v*m.getRow(1), v*m.getRow(2), v*m.getRow(3));
+	}
+	template<class T>
+	constexpr Math3d::Vector4D<T> operator*(const Math3d::Vector4D<T>& v, const StaticMatrix4<T>& m)
+	{
+		return Math3d::Vector4D<T>(v*m.getColumn(0), v*m.getColumn(1), v*m.getColumn(2), v*m.getColumn(3));
 	}
 
 	template<class T>
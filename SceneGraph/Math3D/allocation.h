@@ -0,0 +1,33 @@
+// allocation.h
+
+#pragma once
+
+#include <stddef.h>
+
+// Math3D does its own heap allocations (Matrix3D storage, alignedAlloc).
+// An application can have them reported to its memory accounting by
+// installing a hook; bytes is positive for allocations and negative for
+// frees. Install it before any allocation it should see.
+
+namespace Math3d
+{
+	typedef void (*AllocationHook)(long long bytes);
+
+	inline AllocationHook& allocationHook()
+	{
+		static AllocationHook hook = 0;
+		return hook;
+	}
+
+	inline void setAllocationHook(AllocationHook hook)
+	{
+		allocationHook() = hook;
+	}
+
+	inline void reportAllocation(long long bytes)
+	{
+		AllocationHook hook = allocationHook();
+		if(hook)
+			hook(bytes);
+	}
+};
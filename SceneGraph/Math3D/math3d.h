@@ -3,8 +3,10 @@
 #pragma once
 
 #include "matrix.h"
-#include "staticmatrix4.h"
+#include "StaticMatrix4.h"
 #include "vector4.h"
+#include "quaternion.h"
+#include <type_traits>
 
 #define PI 3.1415967 
 typedef double Real;
@@ -27,3 +29,11 @@ typedef Math3d::Ray3D<float> Fray;
 typedef Math3d::Matrix3D<double> Dmatrix;
 typedef Math3d::Matrix3D<float> Fmatrix;
 typedef Math3d::StaticMatrix4<float> FSmatrix4;
+
+typedef Math3d::Quaternion<double> Dquaternion;
+typedef Math3d::Quaternion<float> Fquaternion;
+
+// Vectors and StaticMatrix4 are trivially copyable literal types: bulk
+// arrays may be memcpy'd and constexpr tables built at compile time
+static_assert(std::is_trivially_copyable<Fvector>::value && std::is_trivially_copyable<Fvector4>::value && std::is_trivially_copyable<FSmatrix4>::value, "Math3D types must stay trivially copyable");
+static_assert(FSmatrix4::translation(Fvector(1.0f, 2.0f, 3.0f)).get(2, 3) == 3.0f, "StaticMatrix4 must stay constexpr");
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "ray.h"
+#include "allocation.h"
 
 namespace Math3d {
 
@@ -70,6 +71,7 @@ private:
 template<class T> Matrix3D<T>::Matrix3D() : data(0)
 {
     data = new T[16];
+    reportAllocation(16 * sizeof(T));
     T* ptr(data);
     *(ptr++) = 1;
     *(ptr++) = 0;
@@ -95,6 +97,7 @@ template<class T> Matrix3D<T>::Matrix3D() : data(0)
 template<class T> Matrix3D<T>::Matrix3D(T* d)
 {
 	this->data = new T[16];
+	reportAllocation(16 * sizeof(T));
 	T* ptr = this->data;
 	for(int i=0; i<16; i++)
 	{
@@ -105,6 +108,7 @@ template<class T> Matrix3D<T>::Matrix3D(T* d)
 template<class T> Matrix3D<T>::Matrix3D(const Matrix3D<T> & _m) : data(0)
 {
     data = new T[16];
+    reportAllocation(16 * sizeof(T));
     const T* mat(_m.getData());
     T* ptr(data);
     for(int i(16); i--; ) *(ptr++) = *(mat++); 
@@ -120,7 +124,11 @@ template<class T> Matrix3D<T> & Matrix3D<T>::operator=(const Matrix3D<T> & _m)
 
 template<class T> Matrix3D<T>::~Matrix3D()
 {
-    if(data) delete [] data;
+    if(data)
+    {
+        delete [] data;
+        reportAllocation(-(long long)(16 * sizeof(T)));
+    }
 };
 
 template<class T> Matrix3D<T> Matrix3D<T>::getInv() const
@@ -0,0 +1,316 @@
+// matrixops.h
+
+#pragma once
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "simd.h"
+#include "allocation.h"
+#include "StaticMatrix4.h"
+
+// Raw kernels over column-major 4x4 float matrices (the StaticMatrix4
+// layout), for hot loops that work on contiguous arrays of matrices.
+
+namespace Math3d
+{
+	// out = a * b. out may not alias a or b.
+	inline void multiplyMatrix4(const float* a, const float* b, float* out)
+	{
+#ifdef MATH3D_SSE
+		__m128 c0 = _mm_loadu_ps(a);
+		__m128 c1 = _mm_loadu_ps(a + 4);
+		__m128 c2 = _mm_loadu_ps(a + 8);
+		__m128 c3 = _mm_loadu_ps(a + 12);
+
+		for(int j = 0; j < 4; j++)
+		{
+			const float* col = b + j*4;
+			__m128 r = _mm_mul_ps(c0, _mm_set1_ps(col[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(col[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(col[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(col[3])));
+			_mm_storeu_ps(out + j*4, r);
+		}
+#else
+		for(int j = 0; j < 4; j++)
+		{
+			for(int i = 0; i < 4; i++)
+			{
+				out[i + j*4] = a[i]*b[j*4] + a[i + 4]*b[j*4 + 1] + a[i + 8]*b[j*4 + 2] + a[i + 12]*b[j*4 + 3];
+			}
+		}
+#endif
+	}
+
+	inline void multiplyMatrix4(const StaticMatrix4<float>& a, const StaticMatrix4<float>& b, StaticMatrix4<float>& out)
+	{
+		multiplyMatrix4(a.getData(), b.getData(), out.getData());
+	}
+
+#ifdef MATH3D_AVX_DISPATCH
+	// AVX body of multiplyMatrices (matrixopsavx.cpp); only call it when cpuHasAVX()
+	void multiplyMatricesAVX(const float* a, const float* b, float* out, size_t count);
+#endif
+
+	// out[i] = a[i] * b[i] for count matrices of 16 floats. On CPUs with AVX
+	// each register works on two output columns of one product: the columns
+	// of a[i] are broadcast to both halves and each half picks its element of
+	// b[i] with an in-lane permute, so a product takes eight multiplies
+	// instead of sixteen and no shuffles across lanes. Transposing eight
+	// matrices into SoA registers and multiplying eight products at a time was
+	// measured slower than this, since the transposes in and out cost more
+	// than the multiplies they save. Without AVX every pair goes through
+	// multiplyMatrix4. Sums are taken in the same order either way, so the
+	// results match multiplyMatrix4 exactly. out may not alias a or b.
+	inline void multiplyMatrices(const float* a, const float* b, float* out, size_t count)
+	{
+#ifdef MATH3D_AVX_DISPATCH
+		if(cpuHasAVX())
+		{
+			multiplyMatricesAVX(a, b, out, count);
+			return;
+		}
+#endif
+		for(size_t i = 0; i < count; i++)
+		{
+			multiplyMatrix4(a + i*16, b + i*16, out + i*16);
+		}
+	}
+
+	inline void multiplyMatrices(const StaticMatrix4<float>* a, const StaticMatrix4<float>* b, StaticMatrix4<float>* out, size_t count)
+	{
+		multiplyMatrices(a->getData(), b->getData(), out->getData(), count);
+	}
+
+	// Batch transforms of many vectors by one matrix. The matrix is read
+	// once; AoS arrays are packed xyz triples (the Vector3D<float> layout)
+	// and SoA arrays are separate x, y and z streams. in and out may be the
+	// same array, for transforming in place, but must not overlap otherwise.
+
+	// c holds the three columns of a 3x3 matrix followed by a translation, xyz each
+	inline void transformAffine3(const float* c, const float* in, float* out, size_t count)
+	{
+		size_t i = 0;
+#ifdef MATH3D_SSE
+		__m128 m0 = _mm_set1_ps(c[0]), m1 = _mm_set1_ps(c[1]), m2 = _mm_set1_ps(c[2]);
+		__m128 m3 = _mm_set1_ps(c[3]), m4 = _mm_set1_ps(c[4]), m5 = _mm_set1_ps(c[5]);
+		__m128 m6 = _mm_set1_ps(c[6]), m7 = _mm_set1_ps(c[7]), m8 = _mm_set1_ps(c[8]);
+		__m128 tx = _mm_set1_ps(c[9]), ty = _mm_set1_ps(c[10]), tz = _mm_set1_ps(c[11]);
+
+		// four vectors (12 floats) at a time, deinterleaved into x, y and z lanes
+		for(; i + 4 <= count; i += 4)
+		{
+			const float* p = in + i*3;
+			__m128 a = _mm_loadu_ps(p);        // x0 y0 z0 x1
+			__m128 b = _mm_loadu_ps(p + 4);    // y1 z1 x2 y2
+			__m128 d = _mm_loadu_ps(p + 8);    // z2 x3 y3 z3
+
+			__m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, d, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,3,0));
+			__m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm_shuffle_ps(b, d, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+			__m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm_shuffle_ps(d, d, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+
+			__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m3, y)), _mm_add_ps(_mm_mul_ps(m6, z), tx));
+			__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m4, y)), _mm_add_ps(_mm_mul_ps(m7, z), ty));
+			__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m8, z), tz));
+
+			float* q = out + i*3;
+			_mm_storeu_ps(q, _mm_shuffle_ps(_mm_shuffle_ps(rx, ry, _MM_SHUFFLE(0,0,0,0)), _mm_shuffle_ps(rz, rx, _MM_SHUFFLE(1,1,0,0)), _MM_SHUFFLE(2,0,2,0)));
+			_mm_storeu_ps(q + 4, _mm_shuffle_ps(_mm_shuffle_ps(ry, rz, _MM_SHUFFLE(1,1,1,1)), _mm_shuffle_ps(rx, ry, _MM_SHUFFLE(2,2,2,2)), _MM_SHUFFLE(2,0,2,0)));
+			_mm_storeu_ps(q + 8, _mm_shuffle_ps(_mm_shuffle_ps(rz, rx, _MM_SHUFFLE(3,3,2,2)), _mm_shuffle_ps(ry, rz, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(2,0,2,0)));
+		}
+#endif
+		for(in += i*3, out += i*3; i < count; i++, in += 3, out += 3)
+		{
+			float x = in[0], y = in[1], z = in[2];
+			out[0] = c[0]*x + c[3]*y + c[6]*z + c[9];
+			out[1] = c[1]*x + c[4]*y + c[7]*z + c[10];
+			out[2] = c[2]*x + c[5]*y + c[8]*z + c[11];
+		}
+	}
+
+	// SoA form of transformAffine3; each stream is transformed in place if out == in
+	inline void transformAffine3(const float* c, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, size_t count)
+	{
+		size_t i = 0;
+#ifdef MATH3D_SSE
+		__m128 m0 = _mm_set1_ps(c[0]), m1 = _mm_set1_ps(c[1]), m2 = _mm_set1_ps(c[2]);
+		__m128 m3 = _mm_set1_ps(c[3]), m4 = _mm_set1_ps(c[4]), m5 = _mm_set1_ps(c[5]);
+		__m128 m6 = _mm_set1_ps(c[6]), m7 = _mm_set1_ps(c[7]), m8 = _mm_set1_ps(c[8]);
+		__m128 tx = _mm_set1_ps(c[9]), ty = _mm_set1_ps(c[10]), tz = _mm_set1_ps(c[11]);
+
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(inX + i);
+			__m128 y = _mm_loadu_ps(inY + i);
+			__m128 z = _mm_loadu_ps(inZ + i);
+			_mm_storeu_ps(outX + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m3, y)), _mm_add_ps(_mm_mul_ps(m6, z), tx)));
+			_mm_storeu_ps(outY + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m4, y)), _mm_add_ps(_mm_mul_ps(m7, z), ty)));
+			_mm_storeu_ps(outZ + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m8, z), tz)));
+		}
+#endif
+		for(; i < count; i++)
+		{
+			float x = inX[i], y = inY[i], z = inZ[i];
+			outX[i] = c[0]*x + c[3]*y + c[6]*z + c[9];
+			outY[i] = c[1]*x + c[4]*y + c[7]*z + c[10];
+			outZ[i] = c[2]*x + c[5]*y + c[8]*z + c[11];
+		}
+	}
+
+	// Coefficients for transformAffine3 from a 4x4 matrix; directions drop the translation
+	inline void affineColumns(const float* m, bool translate, float* c)
+	{
+		c[0] = m[0]; c[1] = m[1]; c[2]  = m[2];
+		c[3] = m[4]; c[4] = m[5]; c[5]  = m[6];
+		c[6] = m[8]; c[7] = m[9]; c[8]  = m[10];
+		c[9] = translate ? m[12] : 0.0f; c[10] = translate ? m[13] : 0.0f; c[11] = translate ? m[14] : 0.0f;
+	}
+
+	// Inverse transpose of the upper 3x3, as transformAffine3 coefficients.
+	// It is computed from the cofactors divided by the determinant, so
+	// lengths are only preserved for rotations.
+	inline void normalColumns(const float* m, float* c)
+	{
+		float cof[9] = {
+			m[5]*m[10] - m[6]*m[9],  m[6]*m[8] - m[4]*m[10],  m[4]*m[9] - m[5]*m[8],
+			m[2]*m[9] - m[1]*m[10],  m[0]*m[10] - m[2]*m[8],  m[1]*m[8] - m[0]*m[9],
+			m[1]*m[6] - m[2]*m[5],   m[2]*m[4] - m[0]*m[6],   m[0]*m[5] - m[1]*m[4] };
+		float det = m[0]*cof[0] + m[1]*cof[1] + m[2]*cof[2];
+		float inv = det != 0.0f ? 1.0f / det : 0.0f;
+
+		// cofactors are listed column by column, so they are already in place
+		for(int i = 0; i < 9; i++)
+		{
+			c[i] = cof[i] * inv;
+		}
+		c[9] = c[10] = c[11] = 0.0f;
+	}
+
+	// Points (w = 1) by a column-major 4x4 matrix
+	inline void transformPoints(const float* m, const float* in, float* out, size_t count)
+	{
+		float c[12];
+		affineColumns(m, true, c);
+		transformAffine3(c, in, out, count);
+	}
+
+	// Directions (w = 0)
+	inline void transformDirections(const float* m, const float* in, float* out, size_t count)
+	{
+		float c[12];
+		affineColumns(m, false, c);
+		transformAffine3(c, in, out, count);
+	}
+
+	// Normals, by the inverse transpose so they stay perpendicular to
+	// transformed surfaces under non-uniform scale; normalized unless asked not to
+	inline void transformNormals(const float* m, const float* in, float* out, size_t count, bool normalize = true)
+	{
+		float c[12];
+		normalColumns(m, c);
+		transformAffine3(c, in, out, count);
+		if(!normalize)
+			return;
+
+		for(size_t i = 0; i < count; i++)
+		{
+			float* n = out + i*3;
+			float l = n[0]*n[0] + n[1]*n[1] + n[2]*n[2];
+			if(l > 0.0f)
+			{
+				l = 1.0f / sqrtf(l);
+				n[0] *= l; n[1] *= l; n[2] *= l;
+			}
+		}
+	}
+
+	inline void transformPoints(const float* m, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, size_t count)
+	{
+		float c[12];
+		affineColumns(m, true, c);
+		transformAffine3(c, inX, inY, inZ, outX, outY, outZ, count);
+	}
+
+	inline void transformDirections(const float* m, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, size_t count)
+	{
+		float c[12];
+		affineColumns(m, false, c);
+		transformAffine3(c, inX, inY, inZ, outX, outY, outZ, count);
+	}
+
+	// Bounding spheres stored as x, y, z, radius. Centers are transformed as
+	// points and radii grow by the largest axis scale, so the result still
+	// encloses the transformed volume.
+	inline void transformSpheres(const float* m, const float* in, float* out, size_t count)
+	{
+		float scale = sqrtf(std::max(m[0]*m[0] + m[1]*m[1] + m[2]*m[2], std::max(m[4]*m[4] + m[5]*m[5] + m[6]*m[6], m[8]*m[8] + m[9]*m[9] + m[10]*m[10])));
+#ifdef MATH3D_SSE
+		__m128 c0 = _mm_setr_ps(m[0], m[1], m[2], 0.0f);
+		__m128 c1 = _mm_setr_ps(m[4], m[5], m[6], 0.0f);
+		__m128 c2 = _mm_setr_ps(m[8], m[9], m[10], 0.0f);
+		__m128 c3 = _mm_setr_ps(m[12], m[13], m[14], 0.0f);
+		__m128 r = _mm_setr_ps(0.0f, 0.0f, 0.0f, scale);
+
+		for(size_t i = 0; i < count; i++)
+		{
+			__m128 s = _mm_loadu_ps(in + i*4);
+			__m128 v = _mm_add_ps(_mm_mul_ps(c0, _mm_shuffle_ps(s, s, _MM_SHUFFLE(0,0,0,0))), _mm_mul_ps(c1, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1,1,1,1))));
+			v = _mm_add_ps(v, _mm_mul_ps(c2, _mm_shuffle_ps(s, s, _MM_SHUFFLE(2,2,2,2))));
+			v = _mm_add_ps(v, _mm_add_ps(c3, _mm_mul_ps(r, s)));
+			_mm_storeu_ps(out + i*4, v);
+		}
+#else
+		for(size_t i = 0; i < count; i++)
+		{
+			float x = in[i*4], y = in[i*4 + 1], z = in[i*4 + 2], radius = in[i*4 + 3];
+			out[i*4]     = m[0]*x + m[4]*y + m[8]*z + m[12];
+			out[i*4 + 1] = m[1]*x + m[5]*y + m[9]*z + m[13];
+			out[i*4 + 2] = m[2]*x + m[6]*y + m[10]*z + m[14];
+			out[i*4 + 3] = radius * scale;
+		}
+#endif
+	}
+
+	// Vector3D<float> arrays are packed xyz, so they go straight to the kernels
+	static_assert(sizeof(Vector3D<float>) == 3*sizeof(float), "Vector3D<float> must be packed");
+
+	inline void transformPoints(const StaticMatrix4<float>& m, const Vector3D<float>* in, Vector3D<float>* out, size_t count)
+	{
+		transformPoints(m.getData(), &in->x, &out->x, count);
+	}
+
+	inline void transformDirections(const StaticMatrix4<float>& m, const Vector3D<float>* in, Vector3D<float>* out, size_t count)
+	{
+		transformDirections(m.getData(), &in->x, &out->x, count);
+	}
+
+	inline void transformNormals(const StaticMatrix4<float>& m, const Vector3D<float>* in, Vector3D<float>* out, size_t count, bool normalize = true)
+	{
+		transformNormals(m.getData(), &in->x, &out->x, count, normalize);
+	}
+
+	// Aligned allocation for matrix arrays (use alignment >= 16 for the SSE
+	// kernels). The block is preceded by the raw pointer and the size, so
+	// alignedFree can report what it releases.
+	inline void* alignedAlloc(size_t bytes, size_t alignment)
+	{
+		const size_t header = 2 * sizeof(void*);
+		void* raw = malloc(bytes + alignment + header);
+		if(!raw)
+			return 0;
+		size_t address = ((size_t)raw + header + alignment - 1) & ~(alignment - 1);
+		((void**)address)[-1] = raw;
+		((size_t*)address)[-2] = bytes;
+		reportAllocation((long long)bytes);
+		return (void*)address;
+	}
+
+	inline void alignedFree(void* p)
+	{
+		if(!p)
+			return;
+		reportAllocation(-(long long)((size_t*)p)[-2]);
+		free(((void**)p)[-1]);
+	}
+};
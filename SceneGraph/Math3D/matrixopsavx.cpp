@@ -0,0 +1,45 @@
+// matrixopsavx.cpp
+//
+// AVX kernels of matrixops.h. This file is built with AVX enabled (/arch:AVX
+// on this file in the project, a target attribute elsewhere) and is only
+// entered after Math3d::cpuHasAVX(). It deliberately includes no Math3D
+// headers: their inline functions would be compiled for AVX here too, and the
+// linker could pick those copies for the SSE2 code paths.
+
+#include <cstddef>
+
+// the MATH3D_AVX_DISPATCH condition of simd.h
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)) && (defined(_MSC_VER) || defined(__GNUC__))
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__AVX__)
+#define MATH3D_AVX_TARGET __attribute__((target("avx")))
+#else
+#define MATH3D_AVX_TARGET
+#endif
+
+namespace Math3d
+{
+	MATH3D_AVX_TARGET void multiplyMatricesAVX(const float* a, const float* b, float* out, size_t count)
+	{
+		for(size_t i = 0; i < count; i++, a += 16, b += 16, out += 16)
+		{
+			__m256 c0 = _mm256_broadcast_ps((const __m128*)a);
+			__m256 c1 = _mm256_broadcast_ps((const __m128*)(a + 4));
+			__m256 c2 = _mm256_broadcast_ps((const __m128*)(a + 8));
+			__m256 c3 = _mm256_broadcast_ps((const __m128*)(a + 12));
+
+			// columns 0-1, then 2-3
+			for(int j = 0; j < 2; j++)
+			{
+				__m256 cols = _mm256_loadu_ps(b + j*8);
+				__m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(cols, 0x00));
+				r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(cols, 0x55)));
+				r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(cols, 0xAA)));
+				r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(cols, 0xFF)));
+				_mm256_storeu_ps(out + j*8, r);
+			}
+		}
+	}
+}
+#endif
@@ -0,0 +1,221 @@
+// quaternion.h
+
+#pragma once
+
+#include <math.h>
+#include <cmath>
+
+#include "vector.h"
+#include "StaticMatrix4.h"
+
+namespace Math3d
+{
+
+	template<class T> class Quaternion
+	{
+	public:
+		Quaternion(T _x = 0, T _y = 0, T _z = 0, T _w = 1);
+		Quaternion(const Vector3D<T> & _axis, T _angle);   // angle in degrees, like StaticMatrix4::rotation
+
+		void set(T _x, T _y, T _z, T _w);
+
+		Quaternion<T> operator*(const Quaternion<T> & _q) const;
+		Quaternion<T> operator+(const Quaternion<T> & _q) const;
+		Quaternion<T> operator*(T _d) const;
+		Quaternion<T> operator-() const;
+		T dot(const Quaternion<T> & _q) const;
+
+		Quaternion<T> conjugate() const;
+		T length() const;
+		Quaternion<T> & normalize();
+
+		Vector3D<T> rotate(const Vector3D<T> & _v) const;
+		StaticMatrix4<T> toMatrix() const;
+		static Quaternion<T> fromMatrix(const StaticMatrix4<T> & m);
+
+		static Quaternion<T> slerp(const Quaternion<T> & a, const Quaternion<T> & b, T t);
+		static Quaternion<T> nlerp(const Quaternion<T> & a, const Quaternion<T> & b, T t);
+
+		T x, y, z, w;
+	};
+
+	// Translation * Rotation * Scale, the usual local transform layout
+	template<class T> StaticMatrix4<T> composeTRS(const Vector3D<T> & t, const Quaternion<T> & r, const Vector3D<T> & s);
+	// Inverse of composeTRS for matrices without shear; a mirrored matrix gets a negative s.x
+	template<class T> void decomposeTRS(const StaticMatrix4<T> & m, Vector3D<T> & t, Quaternion<T> & r, Vector3D<T> & s);
+
+	template<class T> Quaternion<T>::Quaternion(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
+	{
+	}
+
+	template<class T> Quaternion<T>::Quaternion(const Vector3D<T> & _axis, T _angle)
+	{
+		T half = _angle*T(3.141592653589793/360.0);
+		T s = sin(half);
+		x = _axis.x*s;
+		y = _axis.y*s;
+		z = _axis.z*s;
+		w = cos(half);
+	}
+
+	template<class T> void Quaternion<T>::set(T _x, T _y, T _z, T _w)
+	{
+		x=_x;
+		y=_y;
+		z=_z;
+		w=_w;
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::operator*(const Quaternion<T> & _q) const
+	{
+		return Quaternion<T>( w*_q.x + x*_q.w + y*_q.z - z*_q.y,
+							  w*_q.y - x*_q.z + y*_q.w + z*_q.x,
+							  w*_q.z + x*_q.y - y*_q.x + z*_q.w,
+							  w*_q.w - x*_q.x - y*_q.y - z*_q.z );
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::operator+(const Quaternion<T> & _q) const
+	{
+		return Quaternion<T>(x+_q.x, y+_q.y, z+_q.z, w+_q.w);
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::operator*(T _d) const
+	{
+		return Quaternion<T>(x*_d, y*_d, z*_d, w*_d);
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::operator-() const
+	{
+		return Quaternion<T>(-x, -y, -z, -w);
+	}
+
+	template<class T> T Quaternion<T>::dot(const Quaternion<T> & _q) const
+	{
+		return x*_q.x + y*_q.y + z*_q.z + w*_q.w;
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::conjugate() const
+	{
+		return Quaternion<T>(-x, -y, -z, w);
+	}
+
+	template<class T> T Quaternion<T>::length() const
+	{
+		return sqrt(x*x + y*y + z*z + w*w);
+	}
+
+	template<class T> Quaternion<T> & Quaternion<T>::normalize()
+	{
+		T l = length();
+		if(l > 0.00001)
+		{
+			x/=l; y/=l; z/=l; w/=l;
+		}
+		return *this;
+	}
+
+	template<class T> Vector3D<T> Quaternion<T>::rotate(const Vector3D<T> & _v) const
+	{
+		Quaternion<T> r = (*this) * Quaternion<T>(_v.x, _v.y, _v.z, 0) * conjugate();
+		return Vector3D<T>(r.x, r.y, r.z);
+	}
+
+	template<class T> StaticMatrix4<T> Quaternion<T>::toMatrix() const
+	{
+		return composeTRS(Vector3D<T>(0,0,0), *this, Vector3D<T>(1,1,1));
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::fromMatrix(const StaticMatrix4<T> & m)
+	{
+		// m must be a pure rotation (normalize the columns first if it carries scale)
+		Quaternion<T> q;
+		T trace = m.get(0,0) + m.get(1,1) + m.get(2,2);
+		if(trace > 0)
+		{
+			T s = sqrt(trace + 1)*2;
+			q.set((m.get(2,1) - m.get(1,2))/s, (m.get(0,2) - m.get(2,0))/s, (m.get(1,0) - m.get(0,1))/s, s/4);
+		}
+		else if(m.get(0,0) > m.get(1,1) && m.get(0,0) > m.get(2,2))
+		{
+			T s = sqrt(1 + m.get(0,0) - m.get(1,1) - m.get(2,2))*2;
+			q.set(s/4, (m.get(0,1) + m.get(1,0))/s, (m.get(0,2) + m.get(2,0))/s, (m.get(2,1) - m.get(1,2))/s);
+		}
+		else if(m.get(1,1) > m.get(2,2))
+		{
+			T s = sqrt(1 + m.get(1,1) - m.get(0,0) - m.get(2,2))*2;
+			q.set((m.get(0,1) + m.get(1,0))/s, s/4, (m.get(1,2) + m.get(2,1))/s, (m.get(0,2) - m.get(2,0))/s);
+		}
+		else
+		{
+			T s = sqrt(1 + m.get(2,2) - m.get(0,0) - m.get(1,1))*2;
+			q.set((m.get(0,2) + m.get(2,0))/s, (m.get(1,2) + m.get(2,1))/s, s/4, (m.get(1,0) - m.get(0,1))/s);
+		}
+		return q.normalize();
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::slerp(const Quaternion<T> & a, const Quaternion<T> & b, T t)
+	{
+		T c = a.dot(b);
+		Quaternion<T> end = b;
+		if(c < 0)
+		{
+			c = -c;
+			end = -b;
+		}
+		if(c > T(0.9995))
+			return nlerp(a, end, t);
+
+		T theta = acos(c);
+		T s = sin(theta);
+		return a*(sin((1-t)*theta)/s) + end*(sin(t*theta)/s);
+	}
+
+	template<class T> Quaternion<T> Quaternion<T>::nlerp(const Quaternion<T> & a, const Quaternion<T> & b, T t)
+	{
+		Quaternion<T> end = a.dot(b) < 0 ? -b : b;
+		Quaternion<T> r = a*(1-t) + end*t;
+		return r.normalize();
+	}
+
+	template<class T> StaticMatrix4<T> composeTRS(const Vector3D<T> & t, const Quaternion<T> & r, const Vector3D<T> & s)
+	{
+		T xx = r.x*r.x, yy = r.y*r.y, zz = r.z*r.z;
+		T xy = r.x*r.y, xz = r.x*r.z, yz = r.y*r.z;
+		T wx = r.w*r.x, wy = r.w*r.y, wz = r.w*r.z;
+
+		StaticMatrix4<T> m;
+		m.set(0,0, (1 - 2*(yy + zz))*s.x); m.set(1,0, 2*(xy + wz)*s.x);       m.set(2,0, 2*(xz - wy)*s.x);       m.set(3,0, 0);
+		m.set(0,1, 2*(xy - wz)*s.y);       m.set(1,1, (1 - 2*(xx + zz))*s.y); m.set(2,1, 2*(yz + wx)*s.y);       m.set(3,1, 0);
+		m.set(0,2, 2*(xz + wy)*s.z);       m.set(1,2, 2*(yz - wx)*s.z);       m.set(2,2, (1 - 2*(xx + yy))*s.z); m.set(3,2, 0);
+		m.set(0,3, t.x);                   m.set(1,3, t.y);                   m.set(2,3, t.z);                   m.set(3,3, 1);
+		return m;
+	}
+
+	template<class T> void decomposeTRS(const StaticMatrix4<T> & m, Vector3D<T> & t, Quaternion<T> & r, Vector3D<T> & s)
+	{
+		const T* d = m.getData();
+		T scale[3];
+		for(int c = 0; c < 3; c++)
+		{
+			scale[c] = sqrt(d[c*4]*d[c*4] + d[c*4 + 1]*d[c*4 + 1] + d[c*4 + 2]*d[c*4 + 2]);
+		}
+		T det = d[0]*(d[5]*d[10] - d[9]*d[6]) - d[4]*(d[1]*d[10] - d[9]*d[2]) + d[8]*(d[1]*d[6] - d[5]*d[2]);
+		if(det < 0)
+			scale[0] = -scale[0];
+
+		StaticMatrix4<T> rotation = StaticMatrix4<T>::identity();
+		for(int c = 0; c < 3; c++)
+		{
+			T inv = fabs(scale[c]) > 1e-12 ? 1 / scale[c] : 0;
+			for(int i = 0; i < 3; i++)
+			{
+				rotation.set(i, c, d[c*4 + i] * inv);
+			}
+		}
+
+		t.set(d[12], d[13], d[14]);
+		s.set(scale[0], scale[1], scale[2]);
+		r = Quaternion<T>::fromMatrix(rotation);
+	}
+
+};
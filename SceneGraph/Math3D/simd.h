@@ -0,0 +1,49 @@
+// simd.h
+
+#pragma once
+
+// SSE is available on every x86/x64 target we build for; other targets
+// fall back to the scalar paths.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MATH3D_SSE 1
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define MATH3D_AVX 1
+#include <immintrin.h>
+#endif
+
+// Kernels in matrixopsavx.cpp are compiled for AVX on their own (/arch:AVX
+// for that file only, or a target attribute) and called after cpuHasAVX,
+// so the rest of the build still runs on SSE2-only machines.
+#if defined(MATH3D_SSE) && (defined(_MSC_VER) || defined(__GNUC__))
+#define MATH3D_AVX_DISPATCH 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace Math3d
+{
+	// CPU and OS support AVX (the OS must save the ymm registers)
+	inline bool cpuHasAVX()
+	{
+#if defined(MATH3D_AVX)
+		return true;
+#elif defined(_MSC_VER)
+		static const bool avx = []() {
+			int info[4];
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+			return osxsave && avx && (_xgetbv(0) & 6) == 6;
+		}();
+		return avx;
+#else
+		static const bool avx = __builtin_cpu_supports("avx") != 0;
+		return avx;
+#endif
+	}
+}
+#endif
@@ -12,30 +12,29 @@ namespace Math3d {
 template<class T> class Vector3D {
 
 public:
-    Vector3D(T _x = 0, T _y = 0, T _z = 0);
-    Vector3D(const Vector3D<T> & _v);
-    Vector3D(const Vector3D<T> & _from, const Vector3D<T> & _to);
-    ~Vector3D();
+    // Copies, assignment and destruction are the implicit ones, so the type
+    // is trivially copyable; the constexpr members work at compile time
+    constexpr Vector3D(T _x = 0, T _y = 0, T _z = 0);
+    constexpr Vector3D(const Vector3D<T> & _from, const Vector3D<T> & _to);
 
     void set(T _x, T _y, T _z);
     
-    Vector3D<T> operator+(const Vector3D<T> & _v) const;
-    Vector3D<T> operator-(const Vector3D<T> & _v) const;
-    T operator*(const Vector3D<T> & _v) const;
+    constexpr Vector3D<T> operator+(const Vector3D<T> & _v) const;
+    constexpr Vector3D<T> operator-(const Vector3D<T> & _v) const;
+    constexpr T operator*(const Vector3D<T> & _v) const;
 
-    Vector3D<T> operator^(const Vector3D<T> & _v) const;
+    constexpr Vector3D<T> operator^(const Vector3D<T> & _v) const;
 	static void cross(const Vector3D<T>& A, const Vector3D<T>& B, Vector3D<T>& R);
 
-	Vector3D<T> mult(const Vector3D<T> & _v) const;
-    Vector3D<T> operator*(T _d) const;
-    Vector3D<T> operator/(T _d) const;
+	constexpr Vector3D<T> mult(const Vector3D<T> & _v) const;
+    constexpr Vector3D<T> operator*(T _d) const;
+    constexpr Vector3D<T> operator/(T _d) const;
 
-    Vector3D<T> & operator=(const Vector3D<T> & _v);
     Vector3D<T> & operator+=(const Vector3D<T> & _v);
     Vector3D<T> & operator-=(const Vector3D<T> & _v);
     Vector3D<T> & operator*=(T _d);
     Vector3D<T> & operator/=(T _d);
-    Vector3D<T> operator-();
+    constexpr Vector3D<T> operator-() const;
 
     Vector3D<T> getUnit() const;
     Vector3D<T> & normalize();
@@ -44,13 +43,13 @@ public:
 	void computeComplementBasis(Vector3D<T>& out_U, Vector3D<T>& out_V) const;
 
     T length() const;
-    T length2() const;
+    constexpr T length2() const;
     T distance(const Vector3D<T> & _v) const;
-    T distance2(const Vector3D<T> & _v) const;
+    constexpr T distance2(const Vector3D<T> & _v) const;
 
-    Vector3D<T> rotateX(T cosa, T sina) const;
-    Vector3D<T> rotateY(T cosa, T sina) const;
-    Vector3D<T> rotateZ(T cosa, T sina) const;
+    constexpr Vector3D<T> rotateX(T cosa, T sina) const;
+    constexpr Vector3D<T> rotateY(T cosa, T sina) const;
+    constexpr Vector3D<T> rotateZ(T cosa, T sina) const;
     Vector3D<T> rotate(const Vector3D<T> & _axe, T cosa, T sina) const;
     
 	bool isInfinite() const;
@@ -59,19 +58,11 @@ public:
     T x, y, z;
 };
 
-template<class T> Vector3D<T>::Vector3D(T _x, T _y, T _z) : x(_x), y(_y), z(_z)
+template<class T> constexpr Vector3D<T>::Vector3D(T _x, T _y, T _z) : x(_x), y(_y), z(_z)
 {
 };
 
-template<class T> Vector3D<T>::Vector3D(const Vector3D<T> & _v) : x(_v.x), y(_v.y), z(_v.z)
-{
-};
-
-template<class T> Vector3D<T>::Vector3D(const Vector3D<T> & _from, const Vector3D<T> & _to) : x(_to.x - _from.x), y(_to.y - _from.y), z(_to.z - _from.z)
-{
-};
-
-template<class T> Vector3D<T>::~Vector3D()
+template<class T> constexpr Vector3D<T>::Vector3D(const Vector3D<T> & _from, const Vector3D<T> & _to) : x(_to.x - _from.x), y(_to.y - _from.y), z(_to.z - _from.z)
 {
 };
 
@@ -98,25 +89,25 @@ template<class T> void Vector3D<T>::set(T _x, T _y, T _z)
     z=_z;
 };
 
-template<class T> Vector3D<T> Vector3D<T>::operator+(const Vector3D<T> & _v) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator+(const Vector3D<T> & _v) const
 {
     return Vector3D(x+_v.x, y+_v.y, z+_v.z);
 };
-template<class T> Vector3D<T> Vector3D<T>::mult(const Vector3D<T> & _v) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::mult(const Vector3D<T> & _v) const
 {
 	return Vector3D(x*_v.x, y*_v.y, z*_v.z);
 }
-template<class T> Vector3D<T> Vector3D<T>::operator-(const Vector3D<T> & _v) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator-(const Vector3D<T> & _v) const
 {
     return Vector3D(x-_v.x, y-_v.y, z-_v.z);
 }
 
-template<class T> T Vector3D<T>::operator*(const Vector3D<T> & _v) const
+template<class T> constexpr T Vector3D<T>::operator*(const Vector3D<T> & _v) const
 {
     return x*_v.x + y*_v.y + z*_v.z;
 };
 
-template<class T> Vector3D<T> Vector3D<T>::operator^(const Vector3D<T> & _v) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator^(const Vector3D<T> & _v) const
 {
     return Vector3D<T>( y*_v.z - _v.y*z, z*_v.x - _v.z*x, x*_v.y - _v.x*y );
 };
@@ -126,24 +117,16 @@ void Vector3D<T>::cross(const Vector3D<T>& A, const Vector3D<T>& B, Vector3D<T>&
 	R.set(  A.y*B.z - B.y*A.z, A.z*B.x - B.z*A.x, A.x*B.y - B.x*A.y );
 }
 
-template<class T> Vector3D<T> Vector3D<T>::operator*(T _d) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator*(T _d) const
 {
     return Vector3D<T>(x*_d, y*_d, z*_d);
 };
 
-template<class T> Vector3D<T> Vector3D<T>::operator/(T _d) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator/(T _d) const
 {
     return Vector3D<T>(x/_d, y/_d, z/_d);
 };
 
-template<class T> Vector3D<T> & Vector3D<T>::operator=(const Vector3D<T> & _v)
-{
-    x=_v.x;
-    y=_v.y;
-    z=_v.z;
-    return *this;
-};
-
 template<class T> Vector3D<T> & Vector3D<T>::operator+=(const Vector3D<T> & _v)
 {
     x+=_v.x;
@@ -176,7 +159,7 @@ template<class T> Vector3D<T> & Vector3D<T>::operator/=(T _d)
     return *this;
 };
 
-template<class T> Vector3D<T> Vector3D<T>::operator-()
+template<class T> constexpr Vector3D<T> Vector3D<T>::operator-() const
 {
     return Vector3D<T>(-x, -y, -z);
 };
@@ -216,7 +199,7 @@ template<class T> T Vector3D<T>::length() const
     return sqrt(x*x + y*y + z*z);
 };
 
-template<class T> T Vector3D<T>::length2() const
+template<class T> constexpr T Vector3D<T>::length2() const
 {
     return x*x + y*y + z*z;
 };
@@ -229,25 +212,22 @@ template<class T> T Vector3D<T>::distance(const Vector3D<T> & _v) const
     return sqrt(tx*tx + ty*ty + tz*tz);
 };
 
-template<class T> T Vector3D<T>::distance2(const Vector3D<T> & _v) const
+template<class T> constexpr T Vector3D<T>::distance2(const Vector3D<T> & _v) const
 {
-    T tx(_v.x-x);
-    T ty(_v.y-y);
-    T tz(_v.z-z);
-    return tx*tx + ty*ty + tz*tz;
+    return (_v.x-x)*(_v.x-x) + (_v.y-y)*(_v.y-y) + (_v.z-z)*(_v.z-z);
 };
 
-template<class T> Vector3D<T> Vector3D<T>::rotateX(T cosa, T sina) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::rotateX(T cosa, T sina) const
 {
     return Vector3D<T>( x, cosa*y-sina*z, sina*y+cosa*z);
 };
 
-template<class T> Vector3D<T> Vector3D<T>::rotateY(T cosa, T sina) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::rotateY(T cosa, T sina) const
 {
     return Vector3D<T>( cosa*x+sina*z, y, cosa*z-sina*x);
 };
 
-template<class T> Vector3D<T> Vector3D<T>::rotateZ(T cosa, T sina) const
+template<class T> constexpr Vector3D<T> Vector3D<T>::rotateZ(T cosa, T sina) const
 {
     return Vector3D<T>( cosa*x-sina*y, sina*x+cosa*y, z);
 };
@@ -15,34 +15,32 @@ namespace Math3d
 	template<class T> class Vector4D
 	{
 	public:
-		Vector4D(T _x = 0, T _y = 0, T _z = 0, T _w = 0);
-		Vector4D(const Vector4D<T> & _v);
-		Vector4D(const Vector4D<T> & _from, const Vector4D<T> & _to);
-		~Vector4D();
+		// Trivially copyable, like Vector3D
+		constexpr Vector4D(T _x = 0, T _y = 0, T _z = 0, T _w = 0);
+		constexpr Vector4D(const Vector4D<T> & _from, const Vector4D<T> & _to);
 
-		Vector3D<T> xyz() const;
+		constexpr Vector3D<T> xyz() const;
 
 		void set(T _x, T _y, T _z, T _w);
 	    
-		Vector4D<T> operator+(const Vector4D<T> & _v) const;
-		Vector4D<T> operator-(const Vector4D<T> & _v) const;
-		T operator*(const Vector4D<T> & _v) const;
+		constexpr Vector4D<T> operator+(const Vector4D<T> & _v) const;
+		constexpr Vector4D<T> operator-(const Vector4D<T> & _v) const;
+		constexpr T operator*(const Vector4D<T> & _v) const;
 
-		Vector4D<T> mult(const Vector4D<T> & _v) const;
-		Vector4D<T> operator*(T _d) const;
-		Vector4D<T> operator/(T _d) const;
+		constexpr Vector4D<T> mult(const Vector4D<T> & _v) const;
+		constexpr Vector4D<T> operator*(T _d) const;
+		constexpr Vector4D<T> operator/(T _d) const;
 
-		Vector4D<T> & operator=(const Vector4D<T> & _v);
 		Vector4D<T> & operator+=(const Vector4D<T> & _v);
 		Vector4D<T> & operator-=(const Vector4D<T> & _v);
 		Vector4D<T> & operator*=(T _d);
 		Vector4D<T> & operator/=(T _d);
-		Vector4D<T> operator-();
+		constexpr Vector4D<T> operator-() const;
 
 		T length() const;
-		T length2() const;
+		constexpr T length2() const;
 		T distance(const Vector4D<T> & _v) const;
-		T distance2(const Vector4D<T> & _v) const;
+		constexpr T distance2(const Vector4D<T> & _v) const;
 
 		void normalize();
 	    
@@ -50,22 +48,15 @@ namespace Math3d
 		T x, y, z, w;
 	};
 
-	template<class T> Vector4D<T>::Vector4D(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
+	template<class T> constexpr Vector4D<T>::Vector4D(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w)
 	{
 	}
 
-	template<class T> Vector4D<T>::Vector4D(const Vector4D<T> & _v) : x(_v.x), y(_v.y), z(_v.z), w(_v.w)
+	template<class T> constexpr Vector4D<T>::Vector4D(const Vector4D<T> & _from, const Vector4D<T> & _to) : x(_to.x - _from.x), y(_to.y - _from.y), z(_to.z - _from.z), w(_to.w - _from.w)
 	{
 	}
 
-	template<class T> Vector4D<T>::Vector4D(const Vector4D<T> & _from, const Vector4D<T> & _to) : x(_to.x - _from.x), y(_to.y - _from.y), z(_to.z - _from.z), w(_to.w - _from.w)
-	{
-	}
-
-	template<class T> Vector4D<T>::~Vector4D()
-	{
-	}
-	template<class T> Vector3D<T> Vector4D<T>::xyz() const
+	template<class T> constexpr Vector3D<T> Vector4D<T>::xyz() const
 	{
 		return Vector3D<T>(x,y,z);
 	}
@@ -78,44 +69,35 @@ namespace Math3d
 		w=_w;
 	}
 
-	template<class T> Vector4D<T> Vector4D<T>::operator+(const Vector4D<T> & _v) const
+	template<class T> constexpr Vector4D<T> Vector4D<T>::operator+(const Vector4D<T> & _v) const
 	{
 		return Vector4D(x+_v.x, y+_v.y, z+_v.z, w+_v.w);
 	}
-	template<class T> Vector4D<T> Vector4D<T>::mult(const Vector4D<T> & _v) const
+	template<class T> constexpr Vector4D<T> Vector4D<T>::mult(const Vector4D<T> & _v) const
 	{
 		return Vector4D(x*_v.x, y*_v.y, z*_v.z, w*_v.w);
 	}
-	template<class T> Vector4D<T> Vector4D<T>::operator-(const Vector4D<T> & _v) const
+	template<class T> constexpr Vector4D<T> Vector4D<T>::operator-(const Vector4D<T> & _v) const
 	{
 		return Vector4D(x-_v.x, y-_v.y, z-_v.z, w-_v.w);
 	}
 
-	template<class T> T Vector4D<T>::operator*(const Vector4D<T> & _v) const
+	template<class T> constexpr T Vector4D<T>::operator*(const Vector4D<T> & _v) const
 	{
 		return x*_v.x + y*_v.y + z*_v.z + w*_v.w;
 	};
 
 
-	template<class T> Vector4D<T> Vector4D<T>::operator*(T _d) const
+	template<class T> constexpr Vector4D<T> Vector4D<T>::operator*(T _d) const
 	{
-		return Vector4D<T>(x*_d, y*_d, z*_d, w+_d);
+		return Vector4D<T>(x*_d, y*_d, z*_d, w*_d);
 	}
 
-	template<class T> Vector4D<T> Vector4D<T>::operator/(T _d) const
+	template<class T> constexpr Vector4D<T> Vector4D<T>::operator/(T _d) const
 	{
 		return Vector4D<T>(x/_d, y/_d, z/_d, w/_d);
 	}
 
-	template<class T> Vector4D<T> & Vector4D<T>::operator=(const Vector4D<T> & _v)
-	{
-		x=_v.x;
-		y=_v.y;
-		z=_v.z;
-		w=_v.w;
-		return *this;
-	}
-
 	template<class T> Vector4D<T> & Vector4D<T>::operator+=(const Vector4D<T> & _v)
 	{
 		x+=_v.x;
@@ -139,7 +121,7 @@ namespace Math3d
 		x*=_d;
 		y*=_d;
 		z*=_d;
-		w*=d;
+		w*=_d;
 		return *this;
 	}
 
@@ -152,7 +134,7 @@ namespace Math3d
 		return *this;
 	}
 
-	template<class T> Vector4D<T> Vector4D<T>::operator-()
+	template<class T> constexpr Vector4D<T> Vector4D<T>::operator-() const
 	{
 		return Vector4D<T>(-x, -y, -z, -w);
 	}
@@ -163,7 +145,7 @@ namespace Math3d
 		return sqrt(x*x + y*y + z*z + w*w);
 	}
 
-	template<class T> T Vector4D<T>::length2() const
+	template<class T> constexpr T Vector4D<T>::length2() const
 	{
 		return x*x + y*y + z*z +w*w;
 	}
@@ -177,13 +159,9 @@ namespace Math3d
 		return sqrt(tx*tx + ty*ty + tz*tz + tw*tw);
 	}
 
-	template<class T> T Vector4D<T>::distance2(const Vector4D<T> & _v) const
+	template<class T> constexpr T Vector4D<T>::distance2(const Vector4D<T> & _v) const
 	{
-		T tx(_v.x-x);
-		T ty(_v.y-y);
-		T tz(_v.z-z);
-		T tw(_v.w-w);
-		return tx*tx + ty*ty + tz*tz + tw*tw;
+		return (_v.x-x)*(_v.x-x) + (_v.y-y)*(_v.y-y) + (_v.z-z)*(_v.z-z) + (_v.w-w)*(_v.w-w);
 	}
 
 	template<class T> void Vector4D<T>::normalize()
@@ -0,0 +1,320 @@
+#include "Animation.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+
+
+AnimationClip::AnimationClip(const std::string& name)
+{
+	Name = name;
+	Duration = 0.0f;
+}
+
+AnimationClip::~AnimationClip()
+{
+}
+
+unsigned int AnimationClip::AddTrack(const std::string& name)
+{
+	AnimationTrack track;
+	track.Name = name;
+	Tracks.push_back(track);
+	return (unsigned int)Tracks.size() - 1;
+}
+
+void AnimationClip::AddKey(unsigned int track, const TRSKey& key)
+{
+	auto& keys = Tracks[track].Keys;
+
+	// keep the keys sorted by time
+	auto it = keys.begin();
+	while(it != keys.end() && it->Time <= key.Time)
+		++it;
+	keys.insert(it, key);
+
+	Duration = std::max(Duration, key.Time);
+}
+
+
+Animator::Animator()
+{
+}
+
+Animator::~Animator()
+{
+}
+
+AnimationHandle Animator::Play(shared_ptr<AnimationClip> clip, const std::vector<shared_ptr<SceneNode>>& targets, float speed, bool loop)
+{
+	Instance instance;
+	instance.Clip = clip;
+	instance.Time = 0.0f;
+	instance.Speed = speed;
+	instance.Loop = loop;
+	instance.Active = true;
+
+	// reuse a stopped slot if there is one
+	AnimationHandle handle = (AnimationHandle)Instances.size();
+	for(size_t i = 0; i < Instances.size(); i++)
+	{
+		if(!Instances[i].Active)
+		{
+			handle = (AnimationHandle)i;
+			break;
+		}
+	}
+	if(handle == Instances.size())
+		Instances.push_back(instance);
+	else
+		Instances[handle] = instance;
+
+	unsigned int tracks = std::min(clip->GetTrackCount(), (unsigned int)targets.size());
+	for(unsigned int i = 0; i < tracks; i++)
+	{
+		if(!targets[i] || clip->GetTrack(i).Keys.empty())
+			continue;
+
+		Channel channel;
+		channel.Instance = handle;
+		channel.Track = i;
+		channel.Target = targets[i];
+		channel.Cursor = 0;
+		Channels.push_back(channel);
+	}
+
+	return handle;
+}
+
+void Animator::Stop(AnimationHandle handle)
+{
+	if(handle >= Instances.size())
+		return;
+
+	Instances[handle].Active = false;
+	Instances[handle].Clip.reset();
+
+	Channels.erase(std::remove_if(Channels.begin(), Channels.end(),
+		[handle](const Channel& c) { return c.Instance == handle; }), Channels.end());
+}
+
+void Animator::UnbindNode(const SceneNode* node)
+{
+	Channels.erase(std::remove_if(Channels.begin(), Channels.end(), [node](const Channel& c)
+	{
+		for(const SceneNode* n = c.Target.get(); n; n = n->GetParent())
+		{
+			if(n == node)
+				return true;
+		}
+		return false;
+	}), Channels.end());
+}
+
+void Animator::StopAll()
+{
+	Instances.clear();
+	Channels.clear();
+}
+
+bool Animator::IsPlaying(AnimationHandle handle) const
+{
+	return handle < Instances.size() && Instances[handle].Active;
+}
+
+void Animator::Update(float dt)
+{
+	if(Channels.empty())
+		return;
+
+	std::vector<AnimationHandle> finished;
+	for(size_t i = 0; i < Instances.size(); i++)
+	{
+		Instance& instance = Instances[i];
+		if(!instance.Active)
+			continue;
+
+		float duration = instance.Clip->GetDuration();
+		instance.Time += dt * instance.Speed;
+		if(instance.Loop && duration > 0.0f)
+		{
+			instance.Time = fmod(instance.Time, duration);
+			if(instance.Time < 0.0f)
+				instance.Time += duration;
+		}
+		else if(instance.Time >= duration)
+		{
+			// write the last pose this frame, then stop
+			instance.Time = duration;
+			finished.push_back((AnimationHandle)i);
+		}
+	}
+
+	// Gather the key pair and blend factor of every channel into SoA lanes
+	size_t count = Channels.size();
+	size_t lanes = (count + 3) & ~(size_t)3;
+	Alpha.assign(lanes, 0.0f);
+	for(int k = 0; k < 3; k++)
+	{
+		T0[k].assign(lanes, 0.0f); T1[k].assign(lanes, 0.0f);
+		S0[k].assign(lanes, 1.0f); S1[k].assign(lanes, 1.0f);
+	}
+	for(int k = 0; k < 4; k++)
+	{
+		R0[k].assign(lanes, k == 3 ? 1.0f : 0.0f);
+		R1[k].assign(lanes, k == 3 ? 1.0f : 0.0f);
+	}
+	for(int k = 0; k < 16; k++)
+	{
+		Out[k].resize(lanes);
+	}
+
+	for(size_t c = 0; c < count; c++)
+	{
+		Channel& channel = Channels[c];
+		const Instance& instance = Instances[channel.Instance];
+		const auto& keys = instance.Clip->GetTrack(channel.Track).Keys;
+		float time = instance.Time;
+
+		size_t k0 = 0, k1 = 0;
+		if(keys.size() > 1)
+		{
+			if(channel.Cursor + 1 >= keys.size() || time < keys[channel.Cursor].Time)
+				channel.Cursor = 0;
+			while(channel.Cursor + 2 < keys.size() && keys[channel.Cursor + 1].Time <= time)
+				channel.Cursor++;
+
+			k0 = channel.Cursor;
+			k1 = channel.Cursor + 1;
+			float span = keys[k1].Time - keys[k0].Time;
+			float a = span > 0.0f ? (time - keys[k0].Time) / span : 0.0f;
+			Alpha[c] = std::min(std::max(a, 0.0f), 1.0f);
+		}
+
+		const TRSKey& a = keys[k0];
+		const TRSKey& b = keys[k1];
+		T0[0][c] = a.Translation.x; T0[1][c] = a.Translation.y; T0[2][c] = a.Translation.z;
+		T1[0][c] = b.Translation.x; T1[1][c] = b.Translation.y; T1[2][c] = b.Translation.z;
+		S0[0][c] = a.Scale.x; S0[1][c] = a.Scale.y; S0[2][c] = a.Scale.z;
+		S1[0][c] = b.Scale.x; S1[1][c] = b.Scale.y; S1[2][c] = b.Scale.z;
+		R0[0][c] = a.Rotation.x; R0[1][c] = a.Rotation.y; R0[2][c] = a.Rotation.z; R0[3][c] = a.Rotation.w;
+		R1[0][c] = b.Rotation.x; R1[1][c] = b.Rotation.y; R1[2][c] = b.Rotation.z; R1[3][c] = b.Rotation.w;
+	}
+
+	SampleBatch(0, lanes);
+
+	// Scatter the composed matrices into the nodes
+	for(size_t c = 0; c < count; c++)
+	{
+		float data[16];
+		for(int k = 0; k < 16; k++)
+			data[k] = Out[k][c];
+
+		FSmatrix4 local(data);
+		Channels[c].Target->SetTransformation(local);
+	}
+
+	for(AnimationHandle handle : finished)
+	{
+		Stop(handle);
+	}
+}
+
+// Coefficients of Eberly's polynomial slerp approximation ("A Fast and Accurate
+// Algorithm for Computing SLERP"); no trigonometry, so it vectorizes and agrees
+// with the exact slerp to within 2e-5.
+static const float SlerpMu = 1.85298109240830f;
+static const float SlerpU[8] = { 1.0f/(1*3), 1.0f/(2*5), 1.0f/(3*7), 1.0f/(4*9), 1.0f/(5*11), 1.0f/(6*13), 1.0f/(7*15), SlerpMu/(8*17) };
+static const float SlerpV[8] = { 1.0f/3, 2.0f/5, 3.0f/7, 4.0f/9, 5.0f/11, 6.0f/13, 7.0f/15, SlerpMu*8/17 };
+
+// Lerp translation and scale, slerp rotation and compose T*R*S for
+// channels [first, first+count), four lanes at a time
+void Animator::SampleBatch(size_t first, size_t count)
+{
+#ifdef MATH3D_SSE
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	for(size_t i = first; i < first + count; i += 4)
+	{
+		__m128 t = _mm_loadu_ps(&Alpha[i]);
+		__m128 d = _mm_sub_ps(one, t);
+
+		__m128 tr[3], sc[3];
+		for(int k = 0; k < 3; k++)
+		{
+			__m128 a = _mm_loadu_ps(&T0[k][i]);
+			tr[k] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&T1[k][i]), a), t));
+			__m128 s = _mm_loadu_ps(&S0[k][i]);
+			sc[k] = _mm_add_ps(s, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&S1[k][i]), s), t));
+		}
+
+		__m128 q0[4], q1[4];
+		for(int k = 0; k < 4; k++)
+		{
+			q0[k] = _mm_loadu_ps(&R0[k][i]);
+			q1[k] = _mm_loadu_ps(&R1[k][i]);
+		}
+
+		// take the short way round
+		__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q0[0], q1[0]), _mm_mul_ps(q0[1], q1[1])),
+							  _mm_add_ps(_mm_mul_ps(q0[2], q1[2]), _mm_mul_ps(q0[3], q1[3])));
+		__m128 sign = _mm_and_ps(x, signBit);
+		x = _mm_andnot_ps(signBit, x);
+
+		__m128 xm1 = _mm_sub_ps(x, one);
+		__m128 sqrT = _mm_mul_ps(t, t);
+		__m128 sqrD = _mm_mul_ps(d, d);
+		__m128 cT = one, cD = one;
+		for(int k = 7; k >= 0; k--)
+		{
+			__m128 u = _mm_set1_ps(SlerpU[k]);
+			__m128 v = _mm_set1_ps(SlerpV[k]);
+			__m128 bT = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrT), v), xm1);
+			__m128 bD = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrD), v), xm1);
+			cT = _mm_add_ps(one, _mm_mul_ps(bT, cT));
+			cD = _mm_add_ps(one, _mm_mul_ps(bD, cD));
+		}
+		cT = _mm_xor_ps(_mm_mul_ps(t, cT), sign);
+		cD = _mm_mul_ps(d, cD);
+
+		__m128 q[4];
+		for(int k = 0; k < 4; k++)
+			q[k] = _mm_add_ps(_mm_mul_ps(q0[k], cD), _mm_mul_ps(q1[k], cT));
+
+		__m128 xx = _mm_mul_ps(q[0], q[0]), yy = _mm_mul_ps(q[1], q[1]), zz = _mm_mul_ps(q[2], q[2]);
+		__m128 xy = _mm_mul_ps(q[0], q[1]), xz = _mm_mul_ps(q[0], q[2]), yz = _mm_mul_ps(q[1], q[2]);
+		__m128 wx = _mm_mul_ps(q[3], q[0]), wy = _mm_mul_ps(q[3], q[1]), wz = _mm_mul_ps(q[3], q[2]);
+
+		// column-major, element (row, column) at row + column*4
+		_mm_storeu_ps(&Out[0][i],  _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sc[0]));
+		_mm_storeu_ps(&Out[1][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sc[0]));
+		_mm_storeu_ps(&Out[2][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sc[0]));
+		_mm_storeu_ps(&Out[3][i],  _mm_setzero_ps());
+		_mm_storeu_ps(&Out[4][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sc[1]));
+		_mm_storeu_ps(&Out[5][i],  _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sc[1]));
+		_mm_storeu_ps(&Out[6][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sc[1]));
+		_mm_storeu_ps(&Out[7][i],  _mm_setzero_ps());
+		_mm_storeu_ps(&Out[8][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sc[2]));
+		_mm_storeu_ps(&Out[9][i],  _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sc[2]));
+		_mm_storeu_ps(&Out[10][i], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sc[2]));
+		_mm_storeu_ps(&Out[11][i], _mm_setzero_ps());
+		_mm_storeu_ps(&Out[12][i], tr[0]);
+		_mm_storeu_ps(&Out[13][i], tr[1]);
+		_mm_storeu_ps(&Out[14][i], tr[2]);
+		_mm_storeu_ps(&Out[15][i], one);
+	}
+#else
+	for(size_t i = first; i < first + count; i++)
+	{
+		float t = Alpha[i];
+		Fvector tr(T0[0][i] + (T1[0][i] - T0[0][i])*t, T0[1][i] + (T1[1][i] - T0[1][i])*t, T0[2][i] + (T1[2][i] - T0[2][i])*t);
+		Fvector sc(S0[0][i] + (S1[0][i] - S0[0][i])*t, S0[1][i] + (S1[1][i] - S0[1][i])*t, S0[2][i] + (S1[2][i] - S0[2][i])*t);
+		Fquaternion q = Fquaternion::slerp(Fquaternion(R0[0][i], R0[1][i], R0[2][i], R0[3][i]),
+										   Fquaternion(R1[0][i], R1[1][i], R1[2][i], R1[3][i]), t);
+
+		FSmatrix4 m = Math3d::composeTRS(tr, q, sc);
+		for(int k = 0; k < 16; k++)
+			Out[k][i] = m.getData()[k];
+	}
+#endif
+}
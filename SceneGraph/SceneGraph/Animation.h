@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "SceneNode.h"
+
+// Keyframe animation. A clip holds TRS key tracks; playing a clip binds
+// each track to a scene node. All active tracks are sampled together in
+// one batched SIMD pass and written into the nodes' local transforms
+// before the scene updates its world transforms.
+
+struct TRSKey
+{
+	float Time;
+	Fvector Translation;
+	Fquaternion Rotation;
+	Fvector Scale;
+};
+
+struct AnimationTrack
+{
+	std::string Name;            // e.g. the name of the node it was authored for
+	TrackedVector<TRSKey, Mem_Animation> Keys;    // sorted by time
+};
+
+class AnimationClip
+{
+public:
+	AnimationClip(const std::string& name);
+	~AnimationClip();
+
+	// Returns the index of the new track
+	unsigned int AddTrack(const std::string& name);
+	void AddKey(unsigned int track, const TRSKey& key);
+
+	const std::string& GetName() const { return Name;}
+	float GetDuration() const { return Duration;}
+	unsigned int GetTrackCount() const { return (unsigned int)Tracks.size();}
+	const AnimationTrack& GetTrack(unsigned int track) const { return Tracks[track];}
+
+protected:
+	std::string Name;
+	float Duration;
+	TrackedVector<AnimationTrack, Mem_Animation> Tracks;
+};
+
+typedef unsigned int AnimationHandle;
+
+class Animator
+{
+public:
+	Animator();
+	~Animator();
+
+	// Track i of the clip drives targets[i]; null targets are skipped
+	AnimationHandle Play(shared_ptr<AnimationClip> clip, const std::vector<shared_ptr<SceneNode>>& targets, float speed = 1.0f, bool loop = true);
+	void Stop(AnimationHandle handle);
+	void StopAll();
+	// Drop the channels driving the node or its descendants; the clips keep playing
+	void UnbindNode(const SceneNode* node);
+	bool IsPlaying(AnimationHandle handle) const;
+
+	// Advance all playing clips and write the sampled transforms into the nodes
+	void Update(float dt);
+	unsigned int GetActiveTrackCount() const { return (unsigned int)Channels.size();}
+
+protected:
+	struct Instance
+	{
+		shared_ptr<AnimationClip> Clip;
+		float Time;
+		float Speed;
+		bool Loop;
+		bool Active;
+	};
+
+	// One bound track of a playing instance
+	struct Channel
+	{
+		unsigned int Instance;
+		unsigned int Track;      // index into the clip, which may still grow
+		shared_ptr<SceneNode> Target;
+		unsigned int Cursor;     // last key interval, reused while time moves forward
+	};
+
+	void SampleBatch(size_t first, size_t count);
+
+	TrackedVector<Instance, Mem_Animation> Instances;
+	TrackedVector<Channel, Mem_Animation> Channels;
+
+	// SoA staging for the batched sampling, one lane per channel
+	TrackedVector<float, Mem_Animation> Alpha;
+	TrackedVector<float, Mem_Animation> T0[3], T1[3], R0[4], R1[4], S0[3], S1[3];
+	TrackedVector<float, Mem_Animation> Out[16];
+};
@@ -0,0 +1,236 @@
+#include "Behaviour.h"
+#include <mutex>
+#include <functional>
+
+// Pools of 32-byte size classes up to 512 bytes, carved from 16 KB slabs
+// that live as long as the program (and stay counted under Mem_Components)
+namespace
+{
+	const size_t ClassSize = 32;
+	const size_t ClassCount = 16;
+	const size_t SlabSize = 16 * 1024;
+
+	struct FreeBlock
+	{
+		FreeBlock* Next;
+	};
+
+	struct BehaviourPool
+	{
+		std::mutex Lock;
+		FreeBlock* Free[ClassCount];
+
+		BehaviourPool()
+		{
+			for(size_t c = 0; c < ClassCount; c++)
+			{
+				Free[c] = nullptr;
+			}
+		}
+	};
+
+	BehaviourPool& GetPool()
+	{
+		static BehaviourPool pool;
+		return pool;
+	}
+}
+
+void* Behaviour::operator new(size_t size)
+{
+	size_t c = (size + ClassSize - 1) / ClassSize - 1;
+	if(c >= ClassCount)
+	{
+		SceneMemory::Allocated(Mem_Components, size);
+		return ::operator new(size);
+	}
+
+	BehaviourPool& pool = GetPool();
+	std::lock_guard<std::mutex> guard(pool.Lock);
+	if(!pool.Free[c])
+	{
+		size_t block = (c + 1) * ClassSize;
+		char* slab = (char*)::operator new(SlabSize);
+		SceneMemory::Allocated(Mem_Components, SlabSize);
+		for(size_t offset = 0; offset + block <= SlabSize; offset += block)
+		{
+			FreeBlock* b = (FreeBlock*)(slab + offset);
+			b->Next = pool.Free[c];
+			pool.Free[c] = b;
+		}
+	}
+
+	FreeBlock* b = pool.Free[c];
+	pool.Free[c] = b->Next;
+	return b;
+}
+
+void Behaviour::operator delete(void* p, size_t size)
+{
+	if(!p)
+		return;
+
+	size_t c = (size + ClassSize - 1) / ClassSize - 1;
+	if(c >= ClassCount)
+	{
+		SceneMemory::Freed(Mem_Components, size);
+		::operator delete(p);
+		return;
+	}
+
+	BehaviourPool& pool = GetPool();
+	std::lock_guard<std::mutex> guard(pool.Lock);
+	FreeBlock* b = (FreeBlock*)p;
+	b->Next = pool.Free[c];
+	pool.Free[c] = b;
+}
+
+
+BehaviourScheduler::BehaviourScheduler()
+{
+	Time = 0.0;
+}
+
+BehaviourScheduler::~BehaviourScheduler()
+{
+	Clear();
+}
+
+unsigned int BehaviourScheduler::FindEntry(BehaviourHandle handle) const
+{
+	unsigned int index = (unsigned int)handle;
+	if(handle == InvalidBehaviour || index >= Entries.size() || !Entries[index].Script || Entries[index].Generation != (unsigned int)(handle >> 32))
+		return ~0u;
+	return index;
+}
+
+BehaviourHandle BehaviourScheduler::Start(shared_ptr<SceneNode> node, Behaviour* behaviour)
+{
+	if(!behaviour)
+		return InvalidBehaviour;
+
+	unsigned int index;
+	if(FreeEntries.empty())
+	{
+		index = (unsigned int)Entries.size();
+		Entry e;
+		e.Script = nullptr;
+		e.LastResume = -1.0;
+		e.Generation = 0;
+		Entries.push_back(e);
+	}
+	else
+	{
+		index = FreeEntries.back();
+		FreeEntries.pop_back();
+	}
+
+	Entry& e = Entries[index];
+	e.Script = behaviour;
+	e.Node = node;
+	e.LastResume = -1.0;
+
+	BehaviourHandle handle = MakeHandle(index);
+	Ready.push_back(handle);
+	return handle;
+}
+
+// Queued handles of a stopped behaviour go stale with the generation change
+void BehaviourScheduler::Stop(BehaviourHandle handle)
+{
+	unsigned int index = FindEntry(handle);
+	if(index == ~0u)
+		return;
+
+	Entry& e = Entries[index];
+	delete e.Script;
+	e.Script = nullptr;
+	e.Node.reset();
+	e.Generation++;
+	FreeEntries.push_back(index);
+}
+
+void BehaviourScheduler::StopNode(const SceneNode* node)
+{
+	for(unsigned int i = 0; i < Entries.size(); i++)
+	{
+		if(Entries[i].Script && Entries[i].Node.get() == node)
+			Stop(MakeHandle(i));
+	}
+}
+
+void BehaviourScheduler::Clear()
+{
+	for(unsigned int i = 0; i < Entries.size(); i++)
+	{
+		if(Entries[i].Script)
+			Stop(MakeHandle(i));
+	}
+	Ready.clear();
+	Running.clear();
+	Timers = TimerQueue();
+	Waiters.clear();
+}
+
+bool BehaviourScheduler::IsRunning(BehaviourHandle handle) const
+{
+	return FindEntry(handle) != ~0u;
+}
+
+void BehaviourScheduler::Signal(NameID event)
+{
+	auto it = Waiters.find(event);
+	if(it == Waiters.end())
+		return;
+
+	Ready.insert(Ready.end(), it->second.begin(), it->second.end());
+	it->second.clear();
+}
+
+unsigned int BehaviourScheduler::Update(float dt)
+{
+	Time += dt;
+
+	while(!Timers.empty() && Timers.top().first <= Time)
+	{
+		Ready.push_back(Timers.top().second);
+		Timers.pop();
+	}
+
+	// behaviours readied while this batch runs wait for the next Update
+	Running.swap(Ready);
+	Ready.clear();
+
+	unsigned int resumed = 0;
+	for(BehaviourHandle handle : Running)
+	{
+		unsigned int index = FindEntry(handle);
+		if(index == ~0u)
+			continue;
+
+		Entry& e = Entries[index];
+		float elapsed = e.LastResume < 0.0 ? 0.0f : (float)(Time - e.LastResume);
+		e.LastResume = Time;
+		BehaviourWait wait = e.Script->Resume(e.Node.get(), elapsed);
+		resumed++;
+
+		// Resume may have started behaviours and grown Entries
+		switch(wait.Type)
+		{
+		case BehaviourWait::Wait_Frame:
+			Ready.push_back(handle);
+			break;
+		case BehaviourWait::Wait_Seconds:
+			Timers.push(Timer(Time + wait.Seconds, handle));
+			break;
+		case BehaviourWait::Wait_Event:
+			Waiters[wait.Event].push_back(handle);
+			break;
+		case BehaviourWait::Wait_Done:
+			Stop(handle);
+			break;
+		}
+	}
+	Running.clear();
+	return resumed;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <map>
+#include "SceneNode.h"
+
+// What a behaviour waits for after returning from Resume
+struct BehaviourWait
+{
+	enum Kind
+	{
+		Wait_Frame,
+		Wait_Seconds,
+		Wait_Event,
+		Wait_Done
+	};
+
+	Kind Type;
+	float Seconds;
+	NameID Event;
+};
+
+inline BehaviourWait WaitFrame() { BehaviourWait w = { BehaviourWait::Wait_Frame, 0.0f, InvalidName }; return w;}
+inline BehaviourWait WaitSeconds(float seconds) { BehaviourWait w = { BehaviourWait::Wait_Seconds, seconds, InvalidName }; return w;}
+inline BehaviourWait WaitEvent(NameID e) { BehaviourWait w = { BehaviourWait::Wait_Event, 0.0f, e }; return w;}
+inline BehaviourWait Finished() { BehaviourWait w = { BehaviourWait::Wait_Done, 0.0f, InvalidName }; return w;}
+
+// Script attached to a node, written as a resumable state machine: Resume
+// runs until the behaviour has to wait, records in Step where to carry on
+// and returns what it waits for.
+//
+//   BehaviourWait Resume(SceneNode* node, float dt)
+//   {
+//       switch(Step)
+//       {
+//       case 0: Step = 1; return WaitEvent(NameTable::Intern("door_open"));
+//       case 1: Open(node); Step = 2; return WaitSeconds(5.0f);
+//       case 2: Close(node); Step = 0; return WaitFrame();
+//       }
+//       return Finished();
+//   }
+//
+// Behaviours are allocated from size-class pools, so starting and
+// finishing many short scripts does not go through the general heap.
+class Behaviour
+{
+public:
+	Behaviour() { Step = 0;}
+	virtual ~Behaviour() {}
+
+	// dt is the time since the previous resume (0 for the first one)
+	virtual BehaviourWait Resume(SceneNode* node, float dt) = 0;
+
+	static void* operator new(size_t size);
+	static void operator delete(void* p, size_t size);
+
+protected:
+	unsigned int Step;
+};
+
+// Slot index (low 32 bits) and generation (high 32 bits) of a running
+// behaviour; a slot would have to be reused 2^32 times before an old handle
+// matched again
+typedef unsigned long long BehaviourHandle;
+const BehaviourHandle InvalidBehaviour = ~0ull;
+
+// Runs behaviours when what they wait for happens. Ready behaviours are
+// kept in a list that is resumed as one batch per Update; waiting ones sit
+// in a timer heap or on an event's waiter list and are not touched until
+// they are due, so idle behaviours cost nothing per frame.
+class BehaviourScheduler
+{
+public:
+	BehaviourScheduler();
+	~BehaviourScheduler();
+
+	// Takes ownership; the first resume happens on the next Update
+	BehaviourHandle Start(shared_ptr<SceneNode> node, Behaviour* behaviour);
+	void Stop(BehaviourHandle handle);
+	// Stop every behaviour attached to the node
+	void StopNode(const SceneNode* node);
+	void Clear();
+	bool IsRunning(BehaviourHandle handle) const;
+	unsigned int GetCount() const { return (unsigned int)(Entries.size() - FreeEntries.size());}
+
+	// Behaviours waiting for the event resume on the next Update
+	void Signal(NameID event);
+
+	// Resume everything that is due; returns how many behaviours ran
+	unsigned int Update(float dt);
+
+protected:
+	struct Entry
+	{
+		Behaviour* Script;
+		shared_ptr<SceneNode> Node;
+		double LastResume;
+		unsigned int Generation;
+	};
+
+	typedef std::pair<double, BehaviourHandle> Timer;
+	typedef std::priority_queue<Timer, TrackedVector<Timer, Mem_Components>, std::greater<Timer>> TimerQueue;
+
+	BehaviourHandle MakeHandle(unsigned int index) const { return index | ((BehaviourHandle)Entries[index].Generation << 32);}
+	unsigned int FindEntry(BehaviourHandle handle) const;
+
+	TrackedVector<Entry, Mem_Components> Entries;
+	TrackedVector<unsigned int, Mem_Components> FreeEntries;
+	TrackedVector<BehaviourHandle, Mem_Components> Ready;
+	TrackedVector<BehaviourHandle, Mem_Components> Running;
+	TimerQueue Timers;
+	TrackedMap<NameID, TrackedVector<BehaviourHandle, Mem_Components>, Mem_Components> Waiters;
+	double Time;
+};
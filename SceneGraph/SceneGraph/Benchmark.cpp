@@ -0,0 +1,199 @@
+#include "Benchmark.h"
+#include "Scene.h"
+#include "../Math3D/matrixops.h"
+#include <chrono>
+#include <iostream>
+
+static volatile float BenchmarkSink;
+
+Benchmark::Benchmark(bool useCounters)
+{
+	UseCounters = useCounters;
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+BenchmarkResult Benchmark::Run(const std::string& name, unsigned int iterations, unsigned int items, const std::function<void()>& body)
+{
+	BenchmarkResult r;
+	r.Name = name;
+	r.Iterations = iterations > 0 ? iterations : 1;
+	r.Items = items > 0 ? items : 1;
+
+	// warm up caches and branch predictors
+	body();
+
+	bool counters = HasCounters();
+	if(counters)
+		Counters.Start();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for(unsigned int i = 0; i < r.Iterations; i++)
+	{
+		body();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	if(counters)
+		Counters.Stop();
+
+	r.WallMs = elapsed.count();
+	Counters.Read(r.Counters);
+	for(int e = 0; e < PE_Count; e++)
+	{
+		r.HasCounter[e] = counters && Counters.IsAvailable((PerfEvent)e);
+	}
+
+	return r;
+}
+
+void Benchmark::Report(const BenchmarkResult& r)
+{
+	double perIteration = 1.0 / r.Iterations;
+	double perItem = perIteration / r.Items;
+
+	std::cout<<r.Name<<": "<<r.Iterations<<" iterations x "<<r.Items<<" items"<<std::endl;
+	std::cout<<"  wall ms: total "<<r.WallMs<<", per iteration "<<r.WallMs*perIteration
+		<<", per item (ns) "<<r.WallMs*perItem*1.0e6<<std::endl;
+
+	bool any = false;
+	for(int e = 0; e < PE_Count; e++)
+	{
+		if(!r.HasCounter[e])
+			continue;
+
+		any = true;
+		std::cout<<"  "<<PerfCounters::GetEventName((PerfEvent)e)<<": total "<<r.Counters[e]
+			<<", per iteration "<<r.Counters[e]*perIteration
+			<<", per item "<<r.Counters[e]*perItem<<std::endl;
+	}
+	if(!any)
+	{
+		std::cout<<"  (hardware counters unavailable)"<<std::endl;
+	}
+}
+
+// Builds one demo robot (body, head, arms and legs, each with a mesh)
+static shared_ptr<SceneNode> BuildRobot(ActorID& id)
+{
+	const char* parts[] = { "head", "left arm", "right arm", "left leg", "right leg" };
+	const float offsets[][3] = { {0, 0, 5}, {-2, 0, 3}, {2, 0, 3}, {-1, 0, -3}, {1, 0, -3} };
+
+	shared_ptr<SceneNode> body = MakeNode<SceneNode>("body", id++);
+	FSmatrix4 bodyTransform = FSmatrix4::identity();
+	body->SetTransformation(bodyTransform);
+	body->AddChild(MakeNode<MeshNode>("body mesh", id++));
+
+	for(int i = 0; i < 5; i++)
+	{
+		shared_ptr<SceneNode> part = MakeNode<SceneNode>(parts[i], id++);
+		FSmatrix4 transform = FSmatrix4::translation(Fvector(offsets[i][0], offsets[i][1], offsets[i][2]));
+		part->SetTransformation(transform);
+		part->AddChild(MakeNode<MeshNode>(string(parts[i]) + " mesh", id++));
+		body->AddChild(part);
+	}
+	return body;
+}
+
+// Adds one demo robot to the scene
+static unsigned int AddRobot(Scene& scene, ActorID firstId)
+{
+	ActorID id = firstId;
+	scene.AddChild(firstId, BuildRobot(id));
+	return id - firstId;
+}
+
+void RunSceneBenchmarks(bool useCounters)
+{
+	bool verbose = SceneNode::Verbose;
+	SceneNode::Verbose = false;
+
+	Benchmark bench(useCounters);
+	if(useCounters && !bench.HasCounters())
+	{
+		std::cout<<"Hardware counters unavailable, reporting wall time only"<<std::endl;
+	}
+
+	// Scene::OnUpdate over 1000 robots
+	{
+		Scene scene;
+		unsigned int nodes = 1;   // scene root
+		ActorID id = 2;
+		for(int i = 0; i < 1000; i++)
+		{
+			unsigned int added = AddRobot(scene, id);
+			nodes += added;
+			id += added;
+		}
+
+		Benchmark::Report(bench.Run("Scene::OnUpdate", 100, nodes, [&scene]() { scene.OnUpdate(1.0f / 60.0f); }));
+	}
+
+	// the same 1000 robots as instances of one prefab
+	{
+		Scene scene;
+		ActorID id = 3;
+		shared_ptr<Prefab> robot = make_shared<Prefab>(BuildRobot(id));
+		shared_ptr<PrefabNode> robots = MakeNode<PrefabNode>("robots", 2, robot);
+		for(int i = 0; i < 1000; i++)
+		{
+			robots->AddInstance(FSmatrix4::translation(Fvector((float)(i % 32) * 10.0f, 0.0f, (float)(i / 32) * 10.0f)));
+		}
+		scene.AddChild(2, robots);
+
+		Benchmark::Report(bench.Run("Scene::OnUpdate (prefab)", 100, 1 + 1000 * robot->GetNodeCount(), [&scene]() { scene.OnUpdate(1.0f / 60.0f); }));
+	}
+
+	// StaticMatrix4 kernels over a contiguous array of matrices
+	{
+		const unsigned int count = 4096;
+		std::vector<FSmatrix4> a(count), b(count), out(count);
+		std::vector<Fvector4> v(count);
+		for(unsigned int i = 0; i < count; i++)
+		{
+			a[i] = FSmatrix4::rotationZ((float)i) * FSmatrix4::translation(Fvector((float)i, 1.0f, 2.0f));
+			b[i] = FSmatrix4::rotationX((float)i) * FSmatrix4::scale(Fvector(1.0f, 2.0f, 3.0f));
+			v[i] = Fvector4((float)i, 1.0f, 2.0f, 1.0f);
+		}
+
+		Benchmark::Report(bench.Run("StaticMatrix4::operator*", 200, count, [&]() {
+			for(unsigned int i = 0; i < count; i++)
+				out[i] = a[i] * b[i];
+			BenchmarkSink = out[count - 1].get(0, 0);
+		}));
+
+		Benchmark::Report(bench.Run("Math3d::multiplyMatrices", 200, count, [&]() {
+			Math3d::multiplyMatrices(a.data(), b.data(), out.data(), count);
+			BenchmarkSink = out[count - 1].get(0, 0);
+		}));
+
+		Benchmark::Report(bench.Run("StaticMatrix4::getInverse", 200, count, [&]() {
+			for(unsigned int i = 0; i < count; i++)
+				out[i] = a[i].getInverse();
+			BenchmarkSink = out[count - 1].get(0, 0);
+		}));
+
+		Benchmark::Report(bench.Run("StaticMatrix4 * Vector4D", 200, count, [&]() {
+			float sum = 0.0f;
+			for(unsigned int i = 0; i < count; i++)
+				sum += (a[i] * v[i]).x;
+			BenchmarkSink = sum;
+		}));
+
+		// the same points through the batch kernel, one matrix for the array
+		std::vector<Fvector> points(count), moved(count);
+		for(unsigned int i = 0; i < count; i++)
+		{
+			points[i] = Fvector((float)i, 1.0f, 2.0f);
+		}
+
+		Benchmark::Report(bench.Run("Math3d::transformPoints", 200, count, [&]() {
+			Math3d::transformPoints(a[0], points.data(), moved.data(), count);
+			BenchmarkSink = moved[count - 1].x;
+		}));
+	}
+
+	SceneNode::Verbose = verbose;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <functional>
+#include "PerfCounters.h"
+
+// Small benchmark harness. Each run reports wall time and, when the
+// platform allows it, hardware counters in total, per iteration and per
+// item (node or matrix) processed.
+
+struct BenchmarkResult
+{
+	std::string Name;
+	unsigned int Iterations;
+	unsigned int Items;         // nodes/matrices processed by one iteration
+	double WallMs;
+	bool HasCounter[PE_Count];
+	unsigned long long Counters[PE_Count];
+};
+
+class Benchmark
+{
+public:
+	Benchmark(bool useCounters = true);
+	~Benchmark();
+
+	bool HasCounters() const { return UseCounters && Counters.IsAvailable();}
+
+	BenchmarkResult Run(const std::string& name, unsigned int iterations, unsigned int items, const std::function<void()>& body);
+	static void Report(const BenchmarkResult& r);
+
+private:
+	PerfCounters Counters;
+	bool UseCounters;
+};
+
+// Benchmarks Scene::OnUpdate on a scene of demo robots and the StaticMatrix4 kernels
+void RunSceneBenchmarks(bool useCounters);
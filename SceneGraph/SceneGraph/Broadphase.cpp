@@ -0,0 +1,247 @@
+#include "Broadphase.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+#include <cfloat>
+
+
+SweepAndPrune::SweepAndPrune()
+{
+	Axis = 0;
+	Added = 0;
+	Removed = 0;
+}
+
+SweepAndPrune::~SweepAndPrune()
+{
+}
+
+void SweepAndPrune::AddNode(shared_ptr<SceneNode> node)
+{
+	if(!node || BodyIndex.count(node->GetNodeID()))
+		return;
+
+	BodyIndex[node->GetNodeID()] = (unsigned int)Bodies.size();
+	Order.push_back((unsigned int)Bodies.size());
+	Keys.push_back(-FLT_MAX);    // sorted into place on the next update
+	Bodies.push_back(node);
+	Added++;
+}
+
+void SweepAndPrune::RemoveNode(ActorID id)
+{
+	auto it = BodyIndex.find(id);
+	if(it == BodyIndex.end())
+		return;
+
+	Bodies[it->second].reset();
+	BodyIndex.erase(it);
+	Removed++;
+}
+
+// Drop the removed bodies and their entries in the sorted order
+void SweepAndPrune::Compact()
+{
+	if(!Removed)
+		return;
+
+	std::vector<unsigned int> remap(Bodies.size(), ~0u);
+	unsigned int kept = 0;
+	for(size_t i = 0; i < Bodies.size(); i++)
+	{
+		if(!Bodies[i])
+			continue;
+		remap[i] = kept;
+		BodyIndex[Bodies[i]->GetNodeID()] = kept;
+		Bodies[kept++] = std::move(Bodies[i]);
+	}
+	Bodies.resize(kept);
+
+	size_t k2 = 0;
+	for(size_t k = 0; k < Order.size(); k++)
+	{
+		if(remap[Order[k]] == ~0u)
+			continue;
+		Order[k2] = remap[Order[k]];
+		Keys[k2] = Keys[k];
+		k2++;
+	}
+	Order.resize(k2);
+	Keys.resize(k2);
+	Removed = 0;
+}
+
+void SweepAndPrune::Clear()
+{
+	Bodies.clear();
+	BodyIndex.clear();
+	Order.clear();
+	Keys.clear();
+	Overlaps.clear();
+	Added = 0;
+	Removed = 0;
+}
+
+void SweepAndPrune::Update()
+{
+	Overlaps.clear();
+	Compact();
+	if(Bodies.size() < 2)
+		return;
+
+	RefreshBounds();
+	SortAxis();
+	Sweep();
+}
+
+// World-space bounding sphere: the node's radius scaled by its model scale and
+// the largest axis scale of its world transformation
+void SweepAndPrune::RefreshBounds()
+{
+	Spheres.resize(Bodies.size() * 4);
+
+	for(size_t i = 0; i < Bodies.size(); i++)
+	{
+		SceneNode* node = Bodies[i].get();
+		const FSmatrix4& world = node->GetWorldTransformation();
+		const float* m = world.getData();
+
+		Fvector s = node->GetModelScale();
+		float modelScale = std::max(fabs(s.x), std::max(fabs(s.y), fabs(s.z)));
+		float sx = m[0]*m[0] + m[1]*m[1] + m[2]*m[2];
+		float sy = m[4]*m[4] + m[5]*m[5] + m[6]*m[6];
+		float sz = m[8]*m[8] + m[9]*m[9] + m[10]*m[10];
+		float worldScale = sqrt(std::max(sx, std::max(sy, sz)));
+
+		float* sphere = &Spheres[i * 4];
+		sphere[0] = m[12];
+		sphere[1] = m[13];
+		sphere[2] = m[14];
+		sphere[3] = node->Radius() * modelScale * worldScale;
+	}
+}
+
+// Insertion sort of the previous frame's order. Bodies move little between
+// frames, so this is close to linear.
+void SweepAndPrune::SortAxis()
+{
+	size_t n = Order.size();
+	for(size_t k = 0; k < n; k++)
+	{
+		const float* sphere = &Spheres[Order[k] * 4];
+		Keys[k] = sphere[Axis] - sphere[3];
+	}
+
+	// a batch of new bodies has no coherence to exploit, do a full sort instead
+	if(Added > 16 && Added * 8 > n)
+	{
+		std::vector<std::pair<float, unsigned int>> sorted(n);
+		for(size_t k = 0; k < n; k++)
+			sorted[k] = std::make_pair(Keys[k], Order[k]);
+		std::sort(sorted.begin(), sorted.end());
+		for(size_t k = 0; k < n; k++)
+		{
+			Keys[k] = sorted[k].first;
+			Order[k] = sorted[k].second;
+		}
+		Added = 0;
+		return;
+	}
+	Added = 0;
+
+	for(size_t k = 1; k < n; k++)
+	{
+#ifdef MATH3D_SSE
+		// skip runs of four keys that are each no smaller than the one before;
+		// the prefix stays sorted, so only keys that moved back are inserted
+		while(k + 4 <= n && !_mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(&Keys[k]), _mm_loadu_ps(&Keys[k - 1]))))
+			k += 4;
+		if(k >= n)
+			break;
+#endif
+		float key = Keys[k];
+		unsigned int body = Order[k];
+		size_t j = k;
+		while(j > 0 && Keys[j - 1] > key)
+		{
+			Keys[j] = Keys[j - 1];
+			Order[j] = Order[j - 1];
+			j--;
+		}
+		Keys[j] = key;
+		Order[j] = body;
+	}
+}
+
+void SweepAndPrune::Sweep()
+{
+	size_t n = Order.size();
+	// pad so the 4-wide loads never read past the end; padding never overlaps
+	size_t padded = ((n + 3) & ~(size_t)3) + 4;
+	SortedMin.assign(padded, FLT_MAX);
+	SortedMax.assign(padded, -FLT_MAX);
+	SortedX.assign(padded, 0.0f);
+	SortedY.assign(padded, 0.0f);
+	SortedZ.assign(padded, 0.0f);
+	SortedR.assign(padded, 0.0f);
+
+	for(size_t k = 0; k < n; k++)
+	{
+		const float* sphere = &Spheres[Order[k] * 4];
+		SortedMin[k] = Keys[k];
+		SortedMax[k] = sphere[Axis] + sphere[3];
+		SortedX[k] = sphere[0];
+		SortedY[k] = sphere[1];
+		SortedZ[k] = sphere[2];
+		SortedR[k] = sphere[3];
+	}
+
+	for(size_t i = 0; i + 1 < n; i++)
+	{
+		float maxI = SortedMax[i];
+		ActorID idI = Bodies[Order[i]]->GetNodeID();
+
+#ifdef MATH3D_SSE
+		__m128 max4 = _mm_set1_ps(maxI);
+		__m128 x4 = _mm_set1_ps(SortedX[i]);
+		__m128 y4 = _mm_set1_ps(SortedY[i]);
+		__m128 z4 = _mm_set1_ps(SortedZ[i]);
+		__m128 r4 = _mm_set1_ps(SortedR[i]);
+
+		for(size_t j = i + 1; j < n && SortedMin[j] <= maxI; j += 4)
+		{
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(&SortedX[j]), x4);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(&SortedY[j]), y4);
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(&SortedZ[j]), z4);
+			__m128 rr = _mm_add_ps(_mm_loadu_ps(&SortedR[j]), r4);
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&SortedMin[j]), max4), _mm_cmple_ps(d2, _mm_mul_ps(rr, rr)));
+			int mask = _mm_movemask_ps(overlap);
+			while(mask)
+			{
+				int bit = 0;
+				while(!(mask & (1 << bit))) bit++;
+				mask &= ~(1 << bit);
+
+				if(j + bit >= n)
+					break;
+				ActorID idJ = Bodies[Order[j + bit]]->GetNodeID();
+				Overlaps.push_back(ActorPair(std::min(idI, idJ), std::max(idI, idJ)));
+			}
+		}
+#else
+		for(size_t j = i + 1; j < n && SortedMin[j] <= maxI; j++)
+		{
+			float dx = SortedX[j] - SortedX[i];
+			float dy = SortedY[j] - SortedY[i];
+			float dz = SortedZ[j] - SortedZ[i];
+			float rr = SortedR[j] + SortedR[i];
+			if(dx*dx + dy*dy + dz*dz <= rr*rr)
+			{
+				ActorID idJ = Bodies[Order[j]]->GetNodeID();
+				Overlaps.push_back(ActorPair(std::min(idI, idJ), std::max(idI, idJ)));
+			}
+		}
+#endif
+	}
+}
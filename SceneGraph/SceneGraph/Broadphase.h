@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include "SceneNode.h"
+
+typedef std::pair<ActorID, ActorID> ActorPair;
+
+// Sweep-and-prune broadphase over the world-space bounding spheres of
+// opted-in nodes. Bodies are kept sorted by their minimum on one axis
+// between frames, so the per-frame insertion sort only has to fix up the
+// few bodies that moved past each other; runs that are still in order are
+// skipped four keys at a time. Removed bodies are dropped in one pass at the
+// start of the next Update.
+class SweepAndPrune
+{
+public:
+	SweepAndPrune();
+	~SweepAndPrune();
+
+	void AddNode(shared_ptr<SceneNode> node);
+	void RemoveNode(ActorID id);
+	void Clear();
+	unsigned int GetNodeCount() const { return (unsigned int)BodyIndex.size();}
+
+	// 0 = x, 1 = y, 2 = z
+	void SetAxis(int axis) { Axis = axis;}
+
+	// Refresh the bounds from the nodes' world transforms, re-sort and find overlaps
+	void Update();
+	const TrackedVector<ActorPair, Mem_Indices>& GetOverlaps() const { return Overlaps;}
+
+protected:
+	void Compact();
+	void RefreshBounds();
+	void SortAxis();
+	void Sweep();
+
+	TrackedVector<shared_ptr<SceneNode>, Mem_Indices> Bodies;   // null once removed, until Compact
+	TrackedMap<ActorID, unsigned int, Mem_Indices> BodyIndex;
+	TrackedVector<float, Mem_Indices> Spheres;      // x, y, z, radius per body
+	TrackedVector<unsigned int, Mem_Indices> Order; // bodies sorted by axis minimum, kept between frames
+	TrackedVector<float, Mem_Indices> Keys;         // axis minimum for each entry of Order
+
+	// Sorted SoA copy used by the sweep, padded to a multiple of 4
+	TrackedVector<float, Mem_Indices> SortedMin, SortedMax, SortedX, SortedY, SortedZ, SortedR;
+
+	TrackedVector<ActorPair, Mem_Indices> Overlaps;
+	int Axis;
+	unsigned int Added;                // bodies added since the last sort
+	unsigned int Removed;              // null bodies waiting for Compact
+};
@@ -0,0 +1,205 @@
+#include "ComponentStore.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cstdlib>
+
+// sizes of the registered component types
+static std::vector<size_t>& TypeSizes()
+{
+	static std::vector<size_t> sizes;
+	return sizes;
+}
+
+
+Archetype::Archetype(ComponentMask signature)
+{
+	Signature = signature;
+}
+
+int Archetype::FindColumn(ComponentType type) const
+{
+	for(size_t c = 0; c < Columns.size(); c++)
+	{
+		if(Columns[c].Type == type)
+			return (int)c;
+	}
+	return -1;
+}
+
+unsigned int Archetype::AddRow(ActorID actor, SceneNode* node)
+{
+	Actors.push_back(actor);
+	Nodes.push_back(node);
+	World.push_back(node ? node->GetWorldTransformation() : FSmatrix4::identity());
+	for(Column& column : Columns)
+	{
+		column.Data.resize(column.Data.size() + column.Size);
+	}
+	return GetCount() - 1;
+}
+
+void Archetype::RemoveRow(unsigned int row)
+{
+	unsigned int last = GetCount() - 1;
+	Actors[row] = Actors[last];
+	Nodes[row] = Nodes[last];
+	World[row] = World[last];
+	Actors.pop_back();
+	Nodes.pop_back();
+	World.pop_back();
+
+	for(Column& column : Columns)
+	{
+		if(row != last)
+			memcpy(&column.Data[row * column.Size], &column.Data[last * column.Size], column.Size);
+		column.Data.resize(last * column.Size);
+	}
+}
+
+
+ComponentStore::ComponentStore()
+{
+	OwnerScene = nullptr;
+}
+
+ComponentStore::~ComponentStore()
+{
+}
+
+ComponentType ComponentStore::RegisterType(size_t size)
+{
+	// the masks have one bit per type
+	std::vector<size_t>& sizes = TypeSizes();
+	if(sizes.size() >= MaxComponentTypes)
+	{
+		std::cout<<"ComponentStore: more than "<<MaxComponentTypes<<" component types"<<std::endl;
+		std::abort();
+	}
+	sizes.push_back(size);
+	return (ComponentType)sizes.size() - 1;
+}
+
+size_t ComponentStore::GetTypeSize(ComponentType type)
+{
+	return TypeSizes()[type];
+}
+
+ComponentMask ComponentStore::GetMask(ActorID actor) const
+{
+	auto it = Locations.find(actor);
+	return it == Locations.end() ? 0 : Archetypes[it->second.Archetype]->GetSignature();
+}
+
+unsigned int ComponentStore::FindArchetype(ComponentMask signature)
+{
+	auto it = ArchetypeMap.find(signature);
+	if(it != ArchetypeMap.end())
+		return it->second;
+
+	std::unique_ptr<Archetype> archetype(new Archetype(signature));
+	for(ComponentType type = 0; type < 64; type++)
+	{
+		if(signature & (1ull << type))
+		{
+			Archetype::Column column;
+			column.Type = type;
+			column.Size = GetTypeSize(type);
+			archetype->Columns.push_back(column);
+		}
+	}
+
+	unsigned int index = (unsigned int)Archetypes.size();
+	Archetypes.push_back(std::move(archetype));
+	ArchetypeMap[signature] = index;
+	return index;
+}
+
+unsigned int ComponentStore::MoveActor(ActorID actor, ComponentMask signature)
+{
+	auto it = Locations.find(actor);
+	if(it != Locations.end() && Archetypes[it->second.Archetype]->GetSignature() == signature)
+		return it->second.Row;
+
+	if(signature == 0)
+	{
+		RemoveActor(actor);
+		return ~0u;
+	}
+
+	Archetype& target = *Archetypes[FindArchetype(signature)];
+	if(it == Locations.end())
+	{
+		SceneNode* node = OwnerScene ? OwnerScene->FindActor(actor).get() : nullptr;
+		Location location = { FindArchetype(signature), target.AddRow(actor, node) };
+		Locations[actor] = location;
+		return location.Row;
+	}
+
+	// copy the components both archetypes have, then drop the old row
+	Archetype& source = *Archetypes[it->second.Archetype];
+	unsigned int from = it->second.Row;
+	unsigned int row = target.AddRow(actor, source.Nodes[from]);
+	target.World[row] = source.World[from];
+	for(Archetype::Column& column : target.Columns)
+	{
+		int c = source.FindColumn(column.Type);
+		if(c >= 0)
+			memcpy(&column.Data[row * column.Size], &source.Columns[c].Data[from * column.Size], column.Size);
+	}
+
+	source.RemoveRow(from);
+	if(from < source.GetCount())
+		Locations[source.Actors[from]].Row = from;
+
+	it->second.Archetype = FindArchetype(signature);
+	it->second.Row = row;
+	return row;
+}
+
+void* ComponentStore::GetComponent(ActorID actor, ComponentType type)
+{
+	auto it = Locations.find(actor);
+	if(it == Locations.end())
+		return nullptr;
+
+	Archetype& archetype = *Archetypes[it->second.Archetype];
+	int c = archetype.FindColumn(type);
+	if(c < 0)
+		return nullptr;
+	Archetype::Column& column = archetype.Columns[c];
+	return &column.Data[it->second.Row * column.Size];
+}
+
+void ComponentStore::RemoveActor(ActorID actor)
+{
+	auto it = Locations.find(actor);
+	if(it == Locations.end())
+		return;
+
+	Archetype& archetype = *Archetypes[it->second.Archetype];
+	unsigned int row = it->second.Row;
+	archetype.RemoveRow(row);
+	if(row < archetype.GetCount())
+		Locations[archetype.Actors[row]].Row = row;
+	Locations.erase(it);
+}
+
+void ComponentStore::Clear()
+{
+	Archetypes.clear();
+	ArchetypeMap.clear();
+	Locations.clear();
+}
+
+void ComponentStore::SyncTransforms()
+{
+	for(auto& archetype : Archetypes)
+	{
+		unsigned int count = archetype->GetCount();
+		for(unsigned int row = 0; row < count; row++)
+		{
+			if(archetype->Nodes[row])
+				archetype->World[row] = archetype->Nodes[row]->GetWorldTransformation();
+		}
+	}
+}
@@ -0,0 +1,203 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <cstring>
+#include <type_traits>
+#include "SceneNode.h"
+
+class Scene;
+
+// Id of a component type; at most MaxComponentTypes per program
+typedef unsigned int ComponentType;
+const unsigned int MaxComponentTypes = 64;
+// Bit set of component types
+typedef unsigned long long ComponentMask;
+
+// All actors with exactly the same set of components. Every component type
+// is one contiguous column and row i of each column belongs to Actors[i];
+// the actors' nodes and world matrices sit in columns of their own.
+class Archetype
+{
+public:
+	Archetype(ComponentMask signature);
+
+	ComponentMask GetSignature() const { return Signature;}
+	unsigned int GetCount() const { return (unsigned int)Actors.size();}
+	const ActorID* GetActors() const { return Actors.data();}
+	SceneNode* const* GetNodes() const { return Nodes.data();}
+	// World matrices as of the last Scene::OnUpdate
+	const FSmatrix4* GetWorld() const { return World.data();}
+
+	// Column of a component type in the archetype, or nullptr
+	template<class T> T* GetColumn();
+
+	// f(actor, world, components...) for every row
+	template<class... Ts, class F> void Each(F& f);
+
+protected:
+	friend class ComponentStore;
+
+	struct Column
+	{
+		ComponentType Type;
+		size_t Size;
+		TrackedVector<unsigned char, Mem_Components> Data;
+	};
+
+	int FindColumn(ComponentType type) const;
+	unsigned int AddRow(ActorID actor, SceneNode* node);
+	// Swaps the last row into the freed one
+	void RemoveRow(unsigned int row);
+
+	template<class F, class Tuple, size_t... I> void EachRow(F& f, const Tuple& columns, std::index_sequence<I...>);
+
+	ComponentMask Signature;
+	TrackedVector<Column, Mem_Components> Columns;     // sorted by type
+	TrackedVector<ActorID, Mem_Components> Actors;
+	TrackedVector<SceneNode*, Mem_Components> Nodes;
+	TrackedVector<FSmatrix4, Mem_Components> World;
+};
+
+// Archetype-based store of plain-data components keyed by ActorID. Adding
+// or removing a component moves the actor's row to the archetype of its
+// new component set, so systems iterate every actor that has a set of
+// components in tight loops over contiguous columns:
+//
+//   store.ForEach<Velocity, RigidBody>([](ActorID actor, const FSmatrix4& world, Velocity& v, RigidBody& b) { ... });
+//
+// Components must be trivially copyable; they are moved with memcpy.
+class ComponentStore
+{
+public:
+	ComponentStore();
+	~ComponentStore();
+
+	// Scene whose actors the components belong to, for their nodes
+	void SetScene(Scene* s) { OwnerScene = s;}
+
+	template<class T> T& Add(ActorID actor, const T& value = T());
+	template<class T> void Remove(ActorID actor);
+	template<class T> T* Get(ActorID actor);
+	template<class T> bool Has(ActorID actor) const { return (GetMask(actor) & Bit<T>()) != 0;}
+	ComponentMask GetMask(ActorID actor) const;
+	// Drop all components of the actor
+	void RemoveActor(ActorID actor);
+	void Clear();
+
+	// Call f(actor, world, components...) for every actor with all the components
+	template<class... Ts, class F> void ForEach(F f);
+	// Archetypes that have all the components, for hand-written loops over the columns
+	template<class... Ts> void GetArchetypes(std::vector<Archetype*>& archetypes);
+
+	unsigned int GetArchetypeCount() const { return (unsigned int)Archetypes.size();}
+	Archetype& GetArchetype(unsigned int i) { return *Archetypes[i];}
+
+	// Copy the world matrices of all rows from their nodes; run by Scene::OnUpdate
+	void SyncTransforms();
+
+	template<class T> static ComponentType TypeOf();
+	template<class T> static ComponentMask Bit() { return 1ull << TypeOf<T>();}
+	template<class... Ts> static ComponentMask MaskOf();
+
+protected:
+	struct Location
+	{
+		unsigned int Archetype;
+		unsigned int Row;
+	};
+
+	static ComponentType RegisterType(size_t size);
+	static size_t GetTypeSize(ComponentType type);
+
+	unsigned int FindArchetype(ComponentMask signature);
+	// Move the actor's row to the archetype with the new signature; returns the new row
+	unsigned int MoveActor(ActorID actor, ComponentMask signature);
+	void* GetComponent(ActorID actor, ComponentType type);
+
+	Scene* OwnerScene;
+	TrackedVector<std::unique_ptr<Archetype>, Mem_Components> Archetypes;   // stable addresses
+	TrackedMap<ComponentMask, unsigned int, Mem_Components> ArchetypeMap;
+	TrackedMap<ActorID, Location, Mem_Components> Locations;
+};
+
+
+template<class T> ComponentType ComponentStore::TypeOf()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "components must be trivially copyable");
+	static const ComponentType type = RegisterType(sizeof(T));
+	return type;
+}
+
+template<class... Ts> ComponentMask ComponentStore::MaskOf()
+{
+	ComponentMask bits[] = { 0ull, Bit<Ts>()... };
+	ComponentMask mask = 0;
+	for(ComponentMask b : bits)
+	{
+		mask |= b;
+	}
+	return mask;
+}
+
+template<class T> T* Archetype::GetColumn()
+{
+	int column = FindColumn(ComponentStore::TypeOf<T>());
+	return column < 0 ? nullptr : (T*)Columns[column].Data.data();
+}
+
+template<class... Ts, class F> void Archetype::Each(F& f)
+{
+	EachRow(f, std::make_tuple(GetColumn<Ts>()...), std::index_sequence_for<Ts...>());
+}
+
+template<class F, class Tuple, size_t... I> void Archetype::EachRow(F& f, const Tuple& columns, std::index_sequence<I...>)
+{
+	unsigned int count = GetCount();
+	for(unsigned int row = 0; row < count; row++)
+	{
+		f(Actors[row], World[row], std::get<I>(columns)[row]...);
+	}
+}
+
+template<class T> T& ComponentStore::Add(ActorID actor, const T& value)
+{
+	// value may live in a column that the move reallocates
+	T copy = value;
+	unsigned int row = MoveActor(actor, GetMask(actor) | Bit<T>());
+	T* column = Archetypes[Locations[actor].Archetype]->GetColumn<T>();
+	column[row] = copy;
+	return column[row];
+}
+
+template<class T> void ComponentStore::Remove(ActorID actor)
+{
+	if(Has<T>(actor))
+		MoveActor(actor, GetMask(actor) & ~Bit<T>());
+}
+
+template<class T> T* ComponentStore::Get(ActorID actor)
+{
+	return (T*)GetComponent(actor, TypeOf<T>());
+}
+
+template<class... Ts, class F> void ComponentStore::ForEach(F f)
+{
+	ComponentMask mask = MaskOf<Ts...>();
+	for(auto& archetype : Archetypes)
+	{
+		if((archetype->GetSignature() & mask) == mask && archetype->GetCount())
+			archetype->Each<Ts...>(f);
+	}
+}
+
+template<class... Ts> void ComponentStore::GetArchetypes(std::vector<Archetype*>& archetypes)
+{
+	ComponentMask mask = MaskOf<Ts...>();
+	for(auto& archetype : Archetypes)
+	{
+		if((archetype->GetSignature() & mask) == mask && archetype->GetCount())
+			archetypes.push_back(archetype.get());
+	}
+}
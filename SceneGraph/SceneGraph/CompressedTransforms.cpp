@@ -0,0 +1,466 @@
+#include "CompressedTransforms.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static const float QuaternionRange = 0.70710678f;   // the three smallest components lie in [-1/sqrt2, 1/sqrt2]
+
+static unsigned short FloatToHalf(float value)
+{
+	unsigned int f;
+	memcpy(&f, &value, sizeof(f));
+	unsigned int sign = (f >> 16) & 0x8000;
+	int exponent = (int)((f >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = f & 0x7fffff;
+
+	if(exponent >= 31)
+		return (unsigned short)(sign | 0x7bff);          // clamp to the largest half
+	if(exponent <= 0)
+	{
+		if(exponent < -10)
+			return (unsigned short)sign;
+		// subnormal half, round to nearest
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - exponent;
+		unsigned int half = (mantissa + (1u << (shift - 1))) >> shift;
+		return (unsigned short)(sign | half);
+	}
+
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if(mantissa & 0x1000)
+		half++;    // round to nearest; a carry into the exponent is still correct
+	return (unsigned short)std::min(half, sign | 0x7bffu);
+}
+
+static float HalfToFloat(unsigned short h)
+{
+	// shift the bits into float position and rescale the exponent bias
+	unsigned int bits = (unsigned int)(h & 0x7fff) << 13;
+	float magnitude;
+	memcpy(&magnitude, &bits, sizeof(magnitude));
+	magnitude *= 5.192296858534828e33f;    // 2^112
+	return (h & 0x8000) ? -magnitude : magnitude;
+}
+
+
+CompressedTransforms::CompressedTransforms(const TransformPrecision& precision)
+{
+	Precision.PositionStep = 1.0f;
+	ChunkSize = 65534.0f;
+	SetPrecision(precision);
+}
+
+CompressedTransforms::~CompressedTransforms()
+{
+}
+
+bool CompressedTransforms::SetPrecision(const TransformPrecision& precision)
+{
+	// a zero step would make every position fall outside any chunk
+	if(!Rotation.empty() || !(precision.PositionStep > 0.0f) || !std::isfinite(precision.PositionStep * 65534.0f))
+		return false;
+
+	Precision = precision;
+	Precision.RotationBits = std::max(8u, std::min(20u, precision.RotationBits));
+	ChunkSize = Precision.PositionStep * 65534.0f;
+	ChunkOrigins.clear();
+	ChunkMap.clear();
+	return true;
+}
+
+float CompressedTransforms::GetRotationError() const
+{
+	// half a quantization step per stored component; the rebuilt largest one
+	// at most doubles the quaternion error and the angle is twice that
+	float step = QuaternionRange / (float)((1u << Precision.RotationBits) - 1);
+	return 4.0f * 1.7320508f * step;
+}
+
+size_t CompressedTransforms::GetMemoryBytes() const
+{
+	return Rotation.capacity() * (3 * sizeof(short) + sizeof(unsigned int) + sizeof(unsigned long long) + 3 * sizeof(unsigned short))
+		+ ChunkOrigins.capacity() * sizeof(Fvector);
+}
+
+void CompressedTransforms::Reserve(unsigned int count)
+{
+	TX.reserve(count); TY.reserve(count); TZ.reserve(count);
+	Chunk.reserve(count);
+	Rotation.reserve(count);
+	SX.reserve(count); SY.reserve(count); SZ.reserve(count);
+}
+
+unsigned int CompressedTransforms::Add(const FSmatrix4& m)
+{
+	TX.push_back(0); TY.push_back(0); TZ.push_back(0);
+	Chunk.push_back(0);
+	Rotation.push_back(0);
+	SX.push_back(0); SY.push_back(0); SZ.push_back(0);
+
+	unsigned int i = GetCount() - 1;
+	Encode(i, m);
+	return i;
+}
+
+void CompressedTransforms::Remove(unsigned int i)
+{
+	TX[i] = TX.back(); TX.pop_back();
+	TY[i] = TY.back(); TY.pop_back();
+	TZ[i] = TZ.back(); TZ.pop_back();
+	Chunk[i] = Chunk.back(); Chunk.pop_back();
+	Rotation[i] = Rotation.back(); Rotation.pop_back();
+	SX[i] = SX.back(); SX.pop_back();
+	SY[i] = SY.back(); SY.pop_back();
+	SZ[i] = SZ.back(); SZ.pop_back();
+}
+
+void CompressedTransforms::Clear()
+{
+	TX.clear(); TY.clear(); TZ.clear();
+	Chunk.clear();
+	Rotation.clear();
+	SX.clear(); SY.clear(); SZ.clear();
+	ChunkOrigins.clear();
+	ChunkMap.clear();
+}
+
+// Chunks are cubes of ChunkSize; the origin is the cube's center, so every
+// position inside it is within 32767 steps
+unsigned int CompressedTransforms::FindChunk(const Fvector& position)
+{
+	long long cell[3];
+	const float p[3] = { position.x, position.y, position.z };
+	for(int a = 0; a < 3; a++)
+	{
+		cell[a] = (long long)floor(p[a] / ChunkSize);
+	}
+	unsigned long long key = ((unsigned long long)(cell[0] & 0x1fffff) << 42) | ((unsigned long long)(cell[1] & 0x1fffff) << 21) | (unsigned long long)(cell[2] & 0x1fffff);
+
+	auto it = ChunkMap.find(key);
+	if(it != ChunkMap.end())
+		return it->second;
+
+	unsigned int chunk = (unsigned int)ChunkOrigins.size();
+	ChunkOrigins.push_back(Fvector((cell[0] + 0.5f) * ChunkSize, (cell[1] + 0.5f) * ChunkSize, (cell[2] + 0.5f) * ChunkSize));
+	ChunkMap[key] = chunk;
+	return chunk;
+}
+
+void CompressedTransforms::Encode(unsigned int i, const FSmatrix4& m)
+{
+	Fvector t, s;
+	Fquaternion r;
+	Math3d::decomposeTRS(m, t, r, s);
+
+	unsigned int chunk = FindChunk(t);
+	Chunk[i] = chunk;
+	const Fvector& origin = ChunkOrigins[chunk];
+	float inv = 1.0f / Precision.PositionStep;
+	TX[i] = (short)std::max(-32767.0f, std::min(32767.0f, floor((t.x - origin.x) * inv + 0.5f)));
+	TY[i] = (short)std::max(-32767.0f, std::min(32767.0f, floor((t.y - origin.y) * inv + 0.5f)));
+	TZ[i] = (short)std::max(-32767.0f, std::min(32767.0f, floor((t.z - origin.z) * inv + 0.5f)));
+
+	SX[i] = FloatToHalf(s.x);
+	SY[i] = FloatToHalf(s.y);
+	SZ[i] = FloatToHalf(s.z);
+
+	// smallest three, the dropped largest component made positive
+	float v[4] = { r.x, r.y, r.z, r.w };
+	unsigned int largest = 0;
+	for(unsigned int c = 1; c < 4; c++)
+	{
+		if(fabs(v[c]) > fabs(v[largest]))
+			largest = c;
+	}
+	float sign = v[largest] < 0.0f ? -1.0f : 1.0f;
+
+	unsigned int bits = Precision.RotationBits;
+	float steps = (float)((1u << bits) - 1);
+	unsigned long long packed = largest;
+	unsigned int shift = 2;
+	for(unsigned int c = 0; c < 4; c++)
+	{
+		if(c == largest)
+			continue;
+		float n = std::max(0.0f, std::min(1.0f, (v[c] * sign / QuaternionRange) * 0.5f + 0.5f));
+		packed |= (unsigned long long)floor(n * steps + 0.5f) << shift;
+		shift += bits;
+	}
+	Rotation[i] = packed;
+}
+
+// Angle between two rotations, stable for tiny angles where acos is not
+static double RotationAngle(const Fquaternion& a, const Fquaternion& b)
+{
+	double s = a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w < 0.0f ? -1.0 : 1.0;
+	double d[4] = { a.x - s*b.x, a.y - s*b.y, a.z - s*b.z, a.w - s*b.w };
+	double m[4] = { a.x + s*b.x, a.y + s*b.y, a.z + s*b.z, a.w + s*b.w };
+	double dl = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2] + d[3]*d[3]);
+	double ml = sqrt(m[0]*m[0] + m[1]*m[1] + m[2]*m[2] + m[3]*m[3]);
+	return 4.0 * atan2(dl, ml);
+}
+
+bool CompressedTransforms::Verify(const FSmatrix4* source, unsigned int count, TransformErrors* measured) const
+{
+	TransformErrors worst = { 0.0f, 0.0f, 0.0f };
+	bool ok = true;
+	const unsigned int batch = 64;
+	float decoded[batch * 16];
+
+	for(unsigned int first = 0; first < count; first += batch)
+	{
+		unsigned int n = std::min(batch, count - first);
+		Decode(first, n, decoded);
+		for(unsigned int i = 0; i < n; i++)
+		{
+			Fvector t0, s0, t1, s1;
+			Fquaternion r0, r1;
+			Math3d::decomposeTRS(source[first + i], t0, r0, s0);
+			Math3d::decomposeTRS(FSmatrix4(decoded + i*16), t1, r1, s1);
+
+			// encoding and decoding each round at the absolute position, whose
+			// magnitude is at most the chunk origin's plus half a chunk
+			const float a[3] = { t0.x, t0.y, t0.z }, b[3] = { t1.x, t1.y, t1.z };
+			for(int k = 0; k < 3; k++)
+			{
+				float e = fabs(a[k] - b[k]);
+				worst.Position = std::max(worst.Position, e);
+				if(!(e <= GetPositionError() + (fabs(a[k]) + ChunkSize) * 2.0f * FLT_EPSILON))
+					ok = false;
+			}
+
+			float r = (float)RotationAngle(r0, r1);
+			worst.Rotation = std::max(worst.Rotation, r);
+			if(!(r <= GetRotationError()))
+				ok = false;
+
+			const float c[3] = { s0.x, s0.y, s0.z }, d[3] = { s1.x, s1.y, s1.z };
+			for(int k = 0; k < 3; k++)
+			{
+				float e = c[k] != 0.0f ? fabs(d[k] - c[k]) / fabs(c[k]) : fabs(d[k]);
+				worst.Scale = std::max(worst.Scale, e);
+				if(!(e <= GetScaleError()))
+					ok = false;
+			}
+		}
+	}
+
+	if(measured)
+		*measured = worst;
+	return ok;
+}
+
+FSmatrix4 CompressedTransforms::Get(unsigned int i) const
+{
+	FSmatrix4 m;
+	Decode(i, 1, m.getData());
+	return m;
+}
+
+void CompressedTransforms::Decode(unsigned int first, unsigned int count, float* out) const
+{
+	const unsigned int bits = Precision.RotationBits;
+	const unsigned long long mask = (1ull << bits) - 1;
+	const float rotationScale = 2.0f * QuaternionRange / (float)mask;
+	const float step = Precision.PositionStep;
+
+	unsigned int i = first, end = first + count;
+#ifdef MATH3D_SSE
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+	for(; i + 4 <= end; i += 4, out += 64)
+	{
+		// unpack the lanes
+		float a[4], b[4], c[4], tx[4], ty[4], tz[4];
+		int index[4], sx[4], sy[4], sz[4];
+		for(int l = 0; l < 4; l++)
+		{
+			unsigned long long r = Rotation[i + l];
+			index[l] = (int)(r & 3);
+			a[l] = (float)((r >> 2) & mask);
+			b[l] = (float)((r >> (2 + bits)) & mask);
+			c[l] = (float)((r >> (2 + 2*bits)) & mask);
+
+			const Fvector& origin = ChunkOrigins[Chunk[i + l]];
+			tx[l] = TX[i + l] * step + origin.x;
+			ty[l] = TY[i + l] * step + origin.y;
+			tz[l] = TZ[i + l] * step + origin.z;
+			sx[l] = SX[i + l];
+			sy[l] = SY[i + l];
+			sz[l] = SZ[i + l];
+		}
+
+		// half to float: move the bits into place and rescale the exponent
+		const __m128i magnitudeMask = _mm_set1_epi32(0x7fff), signMask = _mm_set1_epi32(0x8000);
+		const __m128 rebias = _mm_set1_ps(5.192296858534828e33f);
+		__m128 scale[3];
+		int* halves[3] = { sx, sy, sz };
+		for(int k = 0; k < 3; k++)
+		{
+			__m128i h = _mm_loadu_si128((const __m128i*)halves[k]);
+			__m128 magnitude = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, magnitudeMask), 13)), rebias);
+			scale[k] = _mm_or_ps(magnitude, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, signMask), 16)));
+		}
+
+		// smallest three back to x, y, z, w
+		__m128 rs = _mm_set1_ps(rotationScale), offset = _mm_set1_ps(QuaternionRange);
+		__m128 qa = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(a), rs), offset);
+		__m128 qb = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(b), rs), offset);
+		__m128 qc = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(c), rs), offset);
+		__m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qa, qa), _mm_mul_ps(qb, qb)), _mm_mul_ps(qc, qc));
+		__m128 ql = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, sum)));
+
+		__m128i idx = _mm_loadu_si128((const __m128i*)index);
+		__m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(0)));
+		__m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(1)));
+		__m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(2)));
+		__m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(idx, _mm_set1_epi32(3)));
+#define SELECT(m, x, y) _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y))
+		__m128 x = SELECT(is0, ql, qa);
+		__m128 y = SELECT(is0, qa, SELECT(is1, ql, qb));
+		__m128 z = SELECT(is2, ql, SELECT(is3, qc, qb));
+		__m128 w = SELECT(is3, ql, qc);
+#undef SELECT
+
+		// rotation matrix columns times scale, as in composeTRS
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		float m[12][4];
+		_mm_storeu_ps(m[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scale[0]));
+		_mm_storeu_ps(m[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scale[0]));
+		_mm_storeu_ps(m[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scale[0]));
+		_mm_storeu_ps(m[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scale[1]));
+		_mm_storeu_ps(m[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scale[1]));
+		_mm_storeu_ps(m[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scale[1]));
+		_mm_storeu_ps(m[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scale[2]));
+		_mm_storeu_ps(m[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scale[2]));
+		_mm_storeu_ps(m[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scale[2]));
+		_mm_storeu_ps(m[9], _mm_loadu_ps(tx));
+		_mm_storeu_ps(m[10], _mm_loadu_ps(ty));
+		_mm_storeu_ps(m[11], _mm_loadu_ps(tz));
+
+		for(int l = 0; l < 4; l++)
+		{
+			float* o = out + l*16;
+			o[0] = m[0][l]; o[1] = m[1][l]; o[2] = m[2][l]; o[3] = 0.0f;
+			o[4] = m[3][l]; o[5] = m[4][l]; o[6] = m[5][l]; o[7] = 0.0f;
+			o[8] = m[6][l]; o[9] = m[7][l]; o[10] = m[8][l]; o[11] = 0.0f;
+			o[12] = m[9][l]; o[13] = m[10][l]; o[14] = m[11][l]; o[15] = 1.0f;
+		}
+	}
+#endif
+
+	for(; i < end; i++, out += 16)
+	{
+		unsigned long long r = Rotation[i];
+		unsigned int largest = (unsigned int)(r & 3);
+		float v[4], sum = 0.0f;
+		for(unsigned int k = 0, shift = 2; k < 4; k++)
+		{
+			if(k == largest)
+				continue;
+			v[k] = (float)((r >> shift) & mask) * rotationScale - QuaternionRange;
+			sum += v[k]*v[k];
+			shift += bits;
+		}
+		v[largest] = sqrt(std::max(0.0f, 1.0f - sum));
+
+		const Fvector& origin = ChunkOrigins[Chunk[i]];
+		Fvector t(TX[i] * step + origin.x, TY[i] * step + origin.y, TZ[i] * step + origin.z);
+		Fvector s(HalfToFloat(SX[i]), HalfToFloat(SY[i]), HalfToFloat(SZ[i]));
+		FSmatrix4 m = Math3d::composeTRS(t, Fquaternion(v[0], v[1], v[2], v[3]), s);
+		memcpy(out, m.getData(), sizeof(float) * 16);
+	}
+}
+
+template<class T, class A> static void WriteArray(std::vector<unsigned char>& out, const std::vector<T, A>& values)
+{
+	size_t at = out.size();
+	out.resize(at + values.size() * sizeof(T));
+	if(!values.empty())
+		memcpy(&out[at], &values[0], values.size() * sizeof(T));
+}
+
+template<class T, class A> static bool ReadArray(const std::vector<unsigned char>& in, size_t& offset, std::vector<T, A>& values, size_t count)
+{
+	if(offset > in.size() || count > (in.size() - offset) / sizeof(T))
+		return false;
+	values.resize(count);
+	if(count)
+		memcpy(&values[0], &in[offset], count * sizeof(T));
+	offset += count * sizeof(T);
+	return true;
+}
+
+void CompressedTransforms::Write(std::vector<unsigned char>& out) const
+{
+	unsigned int header[3] = { GetCount(), GetChunkCount(), Precision.RotationBits };
+	std::vector<unsigned int> head(header, header + 3);
+	WriteArray(out, head);
+	WriteArray(out, std::vector<float>(1, Precision.PositionStep));
+
+	std::vector<float> origins;
+	for(const Fvector& o : ChunkOrigins)
+	{
+		origins.push_back(o.x);
+		origins.push_back(o.y);
+		origins.push_back(o.z);
+	}
+	WriteArray(out, origins);
+	WriteArray(out, TX); WriteArray(out, TY); WriteArray(out, TZ);
+	WriteArray(out, Chunk);
+	WriteArray(out, Rotation);
+	WriteArray(out, SX); WriteArray(out, SY); WriteArray(out, SZ);
+}
+
+bool CompressedTransforms::Read(const std::vector<unsigned char>& in, size_t& offset)
+{
+	size_t at = offset;
+	std::vector<unsigned int> head;
+	std::vector<float> step, origins;
+	if(!ReadArray(in, at, head, 3) || !ReadArray(in, at, step, 1) || !ReadArray(in, at, origins, (size_t)head[1] * 3))
+		return false;
+
+	// read into a scratch store, so a bad block leaves this one untouched
+	CompressedTransforms read;
+	if(head[2] < 8 || head[2] > 20 || !read.SetPrecision(TransformPrecision(step[0], head[2])))
+		return false;
+
+	for(unsigned int c = 0; c < head[1]; c++)
+	{
+		Fvector origin(origins[c*3], origins[c*3 + 1], origins[c*3 + 2]);
+		// cells must fit the 21-bit chunk keys
+		const float range = 1048576.0f * read.ChunkSize;
+		if(!(fabs(origin.x) < range && fabs(origin.y) < range && fabs(origin.z) < range))
+			return false;
+		read.ChunkOrigins.push_back(origin);
+		long long cell[3] = { (long long)floor(origin.x / read.ChunkSize), (long long)floor(origin.y / read.ChunkSize), (long long)floor(origin.z / read.ChunkSize) };
+		read.ChunkMap[((unsigned long long)(cell[0] & 0x1fffff) << 42) | ((unsigned long long)(cell[1] & 0x1fffff) << 21) | (unsigned long long)(cell[2] & 0x1fffff)] = c;
+	}
+
+	unsigned int count = head[0];
+	if(!(ReadArray(in, at, read.TX, count) && ReadArray(in, at, read.TY, count) && ReadArray(in, at, read.TZ, count) &&
+		ReadArray(in, at, read.Chunk, count) && ReadArray(in, at, read.Rotation, count) &&
+		ReadArray(in, at, read.SX, count) && ReadArray(in, at, read.SY, count) && ReadArray(in, at, read.SZ, count)))
+		return false;
+
+	for(unsigned int i = 0; i < count; i++)
+	{
+		if(read.Chunk[i] >= head[1])
+			return false;
+	}
+
+	Precision = read.Precision;
+	ChunkSize = read.ChunkSize;
+	TX.swap(read.TX); TY.swap(read.TY); TZ.swap(read.TZ);
+	Chunk.swap(read.Chunk);
+	Rotation.swap(read.Rotation);
+	SX.swap(read.SX); SY.swap(read.SY); SZ.swap(read.SZ);
+	ChunkOrigins.swap(read.ChunkOrigins);
+	ChunkMap.swap(read.ChunkMap);
+	offset = at;
+	return true;
+}
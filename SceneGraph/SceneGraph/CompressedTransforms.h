@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <map>
+#include "SceneNode.h"
+
+struct TransformPrecision
+{
+	// Fixed-point translation step (> 0); one chunk spans 65534 steps per axis
+	float PositionStep;
+	// Bits per stored quaternion component (8 to 20)
+	unsigned int RotationBits;
+
+	TransformPrecision(float positionStep = 1.0f / 512.0f, unsigned int rotationBits = 16)
+	{
+		PositionStep = positionStep;
+		RotationBits = rotationBits;
+	}
+};
+
+// Largest differences between decoded transforms and the matrices they were
+// encoded from: translation per axis, rotation angle in radians and
+// relative scale, as for the error bounds below
+struct TransformErrors
+{
+	float Position;
+	float Rotation;
+	float Scale;
+};
+
+// Compact store for many TRS transforms (no shear), 24 bytes each instead
+// of a 64-byte matrix: 16-bit fixed-point translation relative to the
+// origin of the chunk the transform falls in (a 32-bit chunk index, so
+// there is no practical limit on the extent), a smallest-three quaternion
+// packed into 64 bits and half-float scale. Decoding into matrices is
+// batched and uses SSE four transforms at a time.
+class CompressedTransforms
+{
+public:
+	CompressedTransforms(const TransformPrecision& precision = TransformPrecision());
+	~CompressedTransforms();
+
+	// Only allowed while empty, and with a positive finite step
+	bool SetPrecision(const TransformPrecision& precision);
+	const TransformPrecision& GetPrecision() const { return Precision;}
+
+	unsigned int Add(const FSmatrix4& m);
+	void Set(unsigned int i, const FSmatrix4& m) { Encode(i, m);}
+	// Moves the last transform into the freed slot
+	void Remove(unsigned int i);
+	void Clear();
+	void Reserve(unsigned int count);
+	unsigned int GetCount() const { return (unsigned int)Rotation.size();}
+
+	FSmatrix4 Get(unsigned int i) const;
+	// Column-major matrices of transforms [first, first + count) into out (16 floats each)
+	void Decode(unsigned int first, unsigned int count, float* out) const;
+
+	// Worst-case decode errors for the precision in use: translation per axis
+	// (on top of float rounding at the absolute position), rotation angle in
+	// radians and relative scale error
+	float GetPositionError() const { return Precision.PositionStep * 0.5f;}
+	float GetRotationError() const;
+	float GetScaleError() const { return 1.0f / 2048.0f;}
+	// Decodes transforms [0, count) and measures them against source, the
+	// matrices they were encoded from. Returns whether every error is within
+	// the bounds above; scales outside the half-float range fail.
+	bool Verify(const FSmatrix4* source, unsigned int count, TransformErrors* measured = nullptr) const;
+
+	unsigned int GetChunkCount() const { return (unsigned int)ChunkOrigins.size();}
+	const Fvector& GetChunkOrigin(unsigned int chunk) const { return ChunkOrigins[chunk];}
+	size_t GetMemoryBytes() const;
+
+	// Raw little-endian serialization for snapshot files. Read checks the
+	// whole block before replacing anything; on failure the store and offset
+	// are left as they were.
+	void Write(std::vector<unsigned char>& out) const;
+	bool Read(const std::vector<unsigned char>& in, size_t& offset);
+
+protected:
+	void Encode(unsigned int i, const FSmatrix4& m);
+	unsigned int FindChunk(const Fvector& position);
+
+	TransformPrecision Precision;
+	float ChunkSize;
+
+	TrackedVector<short, Mem_Transforms> TX, TY, TZ;
+	TrackedVector<unsigned int, Mem_Transforms> Chunk;
+	TrackedVector<unsigned long long, Mem_Transforms> Rotation;   // 2-bit index of the dropped component, then three components
+	TrackedVector<unsigned short, Mem_Transforms> SX, SY, SZ;     // IEEE half floats
+
+	TrackedVector<Fvector, Mem_Transforms> ChunkOrigins;
+	TrackedMap<unsigned long long, unsigned int, Mem_Transforms> ChunkMap;
+};
@@ -0,0 +1,65 @@
+#include "Frustum.h"
+
+
+Frustum Frustum::FromMatrix(const FSmatrix4& viewProjection)
+{
+	// Gribb/Hartmann: each plane is the last row plus or minus one of the others
+	const float* m = viewProjection.getData();
+	Frustum f;
+	for(int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		float sign = (p & 1) ? -1.0f : 1.0f;
+		for(int c = 0; c < 4; c++)
+		{
+			f.Planes[p][c] = m[3 + c*4] + sign * m[row + c*4];
+		}
+
+		float length = sqrt(f.Planes[p][0]*f.Planes[p][0] + f.Planes[p][1]*f.Planes[p][1] + f.Planes[p][2]*f.Planes[p][2]);
+		if(length > 0.0f)
+		{
+			for(int c = 0; c < 4; c++)
+			{
+				f.Planes[p][c] /= length;
+			}
+		}
+	}
+	return f;
+}
+
+Frustum Frustum::FromBox(const Fvector& center, const Fvector axes[3], const Fvector& lo, const Fvector& hi)
+{
+	const float low[3] = { lo.x, lo.y, lo.z };
+	const float high[3] = { hi.x, hi.y, hi.z };
+
+	Frustum f;
+	for(int a = 0; a < 3; a++)
+	{
+		const Fvector& n = axes[a];
+		float offset = n * center;
+
+		// inside while low <= n.(p - center) <= high
+		float* minPlane = f.Planes[a*2];
+		minPlane[0] = n.x; minPlane[1] = n.y; minPlane[2] = n.z;
+		minPlane[3] = -offset - low[a];
+
+		float* maxPlane = f.Planes[a*2 + 1];
+		maxPlane[0] = -n.x; maxPlane[1] = -n.y; maxPlane[2] = -n.z;
+		maxPlane[3] = offset + high[a];
+	}
+	return f;
+}
+
+FrustumTest Frustum::TestSphere(const Fvector& center, float radius) const
+{
+	FrustumTest result = FT_Inside;
+	for(int p = 0; p < 6; p++)
+	{
+		float d = Planes[p][0]*center.x + Planes[p][1]*center.y + Planes[p][2]*center.z + Planes[p][3];
+		if(d < -radius)
+			return FT_Outside;
+		if(d < radius)
+			result = FT_Intersects;
+	}
+	return result;
+}
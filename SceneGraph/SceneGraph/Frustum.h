@@ -0,0 +1,26 @@
+#pragma once
+#include "../Math3D/math3d.h"
+
+// Result of a bounding volume test against a frustum
+enum FrustumTest
+{
+	FT_Outside = -1,
+	FT_Intersects = 0,
+	FT_Inside = 1
+};
+
+// Convex view volume as six world-space planes (n.p + d >= 0 is inside).
+// Built either from a view-projection matrix or, for orthographic shadow
+// views and light ranges, from an oriented box.
+struct Frustum
+{
+	// xyzw per plane: left, right, bottom, top, near, far
+	float Planes[6][4];
+
+	// Planes of an OpenGL style view-projection (clip z in [-w, w])
+	static Frustum FromMatrix(const FSmatrix4& viewProjection);
+	// Box around center along three orthonormal axes, spanning [lo, hi] on each
+	static Frustum FromBox(const Fvector& center, const Fvector axes[3], const Fvector& lo, const Fvector& hi);
+
+	FrustumTest TestSphere(const Fvector& center, float radius) const;
+};
@@ -0,0 +1,109 @@
+#include "LODSelector.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+
+
+LODSelector::LODSelector()
+{
+	Hysteresis = 0.1f;
+}
+
+LODSelector::~LODSelector()
+{
+}
+
+void LODSelector::Select(const MeshNodeList& nodes, const Fvector& eye, float projectionScale)
+{
+	size_t count = nodes.size();
+	size_t lanes = (count + 3) & ~(size_t)3;
+	X.assign(lanes, 0.0f);
+	Y.assign(lanes, 0.0f);
+	Z.assign(lanes, 0.0f);
+	R.assign(lanes, 0.0f);
+	Distance.resize(lanes);
+	ScreenSize.resize(lanes);
+
+	// gather world-space bounding spheres
+	for(size_t i = 0; i < count; i++)
+	{
+		const float* m = nodes[i]->GetWorldTransformation().getData();
+		Fvector s = nodes[i]->GetModelScale();
+		float scale = std::max(fabs(s.x), std::max(fabs(s.y), fabs(s.z)));
+		float axis = std::max(m[0]*m[0] + m[1]*m[1] + m[2]*m[2], std::max(m[4]*m[4] + m[5]*m[5] + m[6]*m[6], m[8]*m[8] + m[9]*m[9] + m[10]*m[10]));
+
+		X[i] = m[12];
+		Y[i] = m[13];
+		Z[i] = m[14];
+		R[i] = nodes[i]->Radius() * scale * sqrt(axis);
+	}
+
+	// distance and projected radius in pixels for all nodes
+#ifdef MATH3D_SSE
+	__m128 ex = _mm_set1_ps(eye.x), ey = _mm_set1_ps(eye.y), ez = _mm_set1_ps(eye.z);
+	__m128 projection = _mm_set1_ps(projectionScale);
+	__m128 nearest = _mm_set1_ps(1.0e-4f);
+	for(size_t i = 0; i < lanes; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&X[i]), ex);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&Y[i]), ey);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&Z[i]), ez);
+		__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		_mm_storeu_ps(&Distance[i], d);
+		_mm_storeu_ps(&ScreenSize[i], _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(&R[i]), projection), _mm_max_ps(d, nearest)));
+	}
+#else
+	for(size_t i = 0; i < lanes; i++)
+	{
+		float dx = X[i] - eye.x, dy = Y[i] - eye.y, dz = Z[i] - eye.z;
+		Distance[i] = sqrt(dx*dx + dy*dy + dz*dz);
+		ScreenSize[i] = R[i] * projectionScale / std::max(Distance[i], 1.0e-4f);
+	}
+#endif
+
+	for(size_t i = 0; i < count; i++)
+	{
+		MeshNode* node = nodes[i];
+		if(node->GetLODCount() > 1)
+			node->SetCurrentLOD(PickLOD(node, Distance[i], ScreenSize[i]));
+	}
+}
+
+unsigned int LODSelector::PickLOD(const MeshNode* node, float distance, float screenSize) const
+{
+	unsigned int count = node->GetLODCount();
+	unsigned int current = std::min(node->GetCurrentLOD(), count - 1);
+	bool bySize = node->GetLODMetric() == LOD_ScreenSize;
+	float value = bySize ? screenSize : distance;
+
+	// "passes" is true when the value is on the detailed side of the threshold,
+	// scaled by the hysteresis band
+	auto passes = [bySize, value](float threshold, float band) -> bool
+	{
+		return bySize ? value >= threshold*band : value <= threshold/band;
+	};
+
+	unsigned int target = count - 1;
+	for(unsigned int lod = 0; lod < count; lod++)
+	{
+		if(passes(node->GetLOD(lod).Threshold, 1.0f))
+		{
+			target = lod;
+			break;
+		}
+	}
+
+	if(target < current)
+	{
+		// more detail: must be clearly inside the finer LOD's range
+		if(!passes(node->GetLOD(target).Threshold, 1.0f + Hysteresis))
+			target = current;
+	}
+	else if(target > current)
+	{
+		// less detail: must be clearly outside the current LOD's range
+		if(passes(node->GetLOD(current).Threshold, 1.0f - Hysteresis))
+			target = current;
+	}
+
+	return target;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+
+// Batched level-of-detail selection for the visible MeshNodes of a frame.
+// Distance and projected size are computed for all nodes at once from
+// their world position and Radius(); each node then moves to the LOD its
+// thresholds pick, with a hysteresis band around every threshold so nodes
+// sitting on a boundary do not pop back and forth.
+class LODSelector
+{
+public:
+	LODSelector();
+	~LODSelector();
+
+	// Fraction of a threshold a node has to move past before it switches (default 0.1)
+	void SetHysteresis(float h) { Hysteresis = h;}
+	float GetHysteresis() const { return Hysteresis;}
+
+	// projectionScale = viewport height in pixels / (2 * tan(fovY / 2))
+	void Select(const MeshNodeList& nodes, const Fvector& eye, float projectionScale);
+
+	// Results of the last Select, indexed like the nodes
+	float GetDistance(unsigned int i) const { return Distance[i];}
+	float GetScreenSize(unsigned int i) const { return ScreenSize[i];}
+
+protected:
+	unsigned int PickLOD(const MeshNode* node, float distance, float screenSize) const;
+
+	float Hysteresis;
+	TrackedVector<float, Mem_Render> X, Y, Z, R;
+	TrackedVector<float, Mem_Render> Distance, ScreenSize;
+};
@@ -0,0 +1,194 @@
+#include "NameTable.h"
+#include <algorithm>
+
+static const std::string EmptyName;
+
+
+NameTable::NameTable()
+{
+	Slot empty = { InvalidName, nullptr };
+	Slots.assign(1024, empty);
+}
+
+NameTable& NameTable::Get()
+{
+	static NameTable table;
+	return table;
+}
+
+NameID NameTable::Hash(const char* s, size_t length)
+{
+	unsigned int h = 2166136261u;
+	for(size_t i = 0; i < length; i++)
+	{
+		h ^= (unsigned char)s[i];
+		h *= 16777619u;
+	}
+	return h == InvalidName ? 1 : h;
+}
+
+// Slot holding the id, or the empty slot where it would go
+unsigned int NameTable::FindSlot(NameID name) const
+{
+	unsigned int mask = (unsigned int)Slots.size() - 1;
+	unsigned int i = name & mask;
+	while(Slots[i].Name != InvalidName && Slots[i].Name != name)
+		i = (i + 1) & mask;
+	return i;
+}
+
+void NameTable::Grow()
+{
+	TrackedVector<Slot, Mem_Names> old;
+	old.swap(Slots);
+	Slot empty = { InvalidName, nullptr };
+	Slots.assign(old.size() * 2, empty);
+	for(const Slot& s : old)
+	{
+		if(s.Name != InvalidName)
+			Slots[FindSlot(s.Name)] = s;
+	}
+}
+
+NameID NameTable::Intern(const std::string& s)
+{
+	NameTable& table = Get();
+	std::lock_guard<std::mutex> guard(table.Lock);
+
+	// walk the ids from the hash until the string or a free id turns up
+	NameID name = Hash(s.data(), s.size());
+	for(;;)
+	{
+		unsigned int i = table.FindSlot(name);
+		if(table.Slots[i].Name == InvalidName)
+			break;
+		if(*table.Slots[i].String == s)
+			return name;
+		name = name + 1 == InvalidName ? 1 : name + 1;
+	}
+
+	if((table.Strings.size() + 1) * 2 > table.Slots.size())
+		table.Grow();
+
+	table.Strings.push_back(s);
+	SceneMemory::Allocated(Mem_Names, sizeof(std::string) + s.size() + 1);
+	Slot slot = { name, &table.Strings.back() };
+	table.Slots[table.FindSlot(name)] = slot;
+	return name;
+}
+
+NameID NameTable::Find(const char* s, size_t length)
+{
+	NameTable& table = Get();
+	std::lock_guard<std::mutex> guard(table.Lock);
+
+	NameID name = Hash(s, length);
+	for(;;)
+	{
+		unsigned int i = table.FindSlot(name);
+		if(table.Slots[i].Name == InvalidName)
+			return InvalidName;
+		if(table.Slots[i].String->compare(0, std::string::npos, s, length) == 0)
+			return name;
+		name = name + 1 == InvalidName ? 1 : name + 1;
+	}
+}
+
+const std::string& NameTable::GetString(NameID name)
+{
+	NameTable& table = Get();
+	std::lock_guard<std::mutex> guard(table.Lock);
+
+	const Slot& slot = table.Slots[table.FindSlot(name)];
+	return slot.Name == InvalidName ? EmptyName : *slot.String;
+}
+
+unsigned int NameTable::GetCount()
+{
+	NameTable& table = Get();
+	std::lock_guard<std::mutex> guard(table.Lock);
+	return (unsigned int)table.Strings.size();
+}
+
+
+NameIndex::NameIndex()
+{
+	Used = 0;
+	Slot empty = { InvalidName, 0 };
+	Slots.assign(64, empty);
+}
+
+unsigned int NameIndex::FindSlot(NameID name) const
+{
+	unsigned int mask = (unsigned int)Slots.size() - 1;
+	unsigned int i = name & mask;
+	while(Slots[i].Name != InvalidName && Slots[i].Name != name)
+		i = (i + 1) & mask;
+	return i;
+}
+
+void NameIndex::Grow()
+{
+	TrackedVector<Slot, Mem_Indices> old;
+	old.swap(Slots);
+	Slot empty = { InvalidName, 0 };
+	Slots.assign(old.size() * 2, empty);
+	for(const Slot& s : old)
+	{
+		if(s.Name != InvalidName)
+			Slots[FindSlot(s.Name)] = s;
+	}
+}
+
+void NameIndex::Add(NameID name, SceneNode* node)
+{
+	unsigned int i = FindSlot(name);
+	if(Slots[i].Name == InvalidName)
+	{
+		// names stay in the index once seen, so there are no tombstones
+		if((Used + 1) * 2 > Slots.size())
+		{
+			Grow();
+			i = FindSlot(name);
+		}
+		Slots[i].Name = name;
+		Slots[i].List = (unsigned int)Lists.size();
+		Lists.push_back(NodeList());
+		Used++;
+	}
+	Lists[Slots[i].List].push_back(node);
+}
+
+void NameIndex::Remove(NameID name, SceneNode* node)
+{
+	unsigned int i = FindSlot(name);
+	if(Slots[i].Name == InvalidName)
+		return;
+
+	NodeList& list = Lists[Slots[i].List];
+	NodeList::iterator it = std::find(list.begin(), list.end(), node);
+	if(it != list.end())
+	{
+		*it = list.back();
+		list.pop_back();
+	}
+}
+
+void NameIndex::Clear()
+{
+	Slot empty = { InvalidName, 0 };
+	Slots.assign(64, empty);
+	Lists.clear();
+	Used = 0;
+}
+
+const NameIndex::NodeList* NameIndex::Find(NameID name) const
+{
+	if(name == InvalidName)
+		return nullptr;
+
+	const Slot& slot = Slots[FindSlot(name)];
+	if(slot.Name == InvalidName || Lists[slot.List].empty())
+		return nullptr;
+	return &Lists[slot.List];
+}
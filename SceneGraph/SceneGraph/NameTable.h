@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include "SceneMemory.h"
+
+// 32-bit id of an interned string: its FNV-1a hash, moved to the next free
+// value in the unlikely case of a collision
+typedef unsigned int NameID;
+const NameID InvalidName = 0;
+
+// Process-wide table of interned strings. Every distinct string is stored
+// once and never freed, so references returned by GetString stay valid and
+// equal names compare as ids. Thread safe.
+class NameTable
+{
+public:
+	// Id of the string, adding it if it is new
+	static NameID Intern(const std::string& s);
+	// Id of the string if it was interned, otherwise InvalidName (nothing is added)
+	static NameID Find(const std::string& s) { return Find(s.data(), s.size());}
+	static NameID Find(const char* s, size_t length);
+	static const std::string& GetString(NameID name);
+	static unsigned int GetCount();
+
+	static NameID Hash(const char* s, size_t length);
+
+private:
+	struct Slot
+	{
+		NameID Name;                 // InvalidName = empty
+		const std::string* String;
+	};
+
+	NameTable();
+	static NameTable& Get();
+	unsigned int FindSlot(NameID name) const;
+	void Grow();
+
+	std::mutex Lock;
+	std::deque<std::string> Strings;        // deque, so strings never move
+	TrackedVector<Slot, Mem_Names> Slots;   // open addressing on the id, power of two size
+};
+
+class SceneNode;
+
+// Flat hash index from names to the nodes carrying them (names need not be
+// unique), used by Scene::FindByName
+class NameIndex
+{
+public:
+	NameIndex();
+
+	void Add(NameID name, SceneNode* node);
+	void Remove(NameID name, SceneNode* node);
+	void Clear();
+	typedef TrackedVector<SceneNode*, Mem_Indices> NodeList;
+
+	// Nodes with the name, or nullptr
+	const NodeList* Find(NameID name) const;
+
+private:
+	struct Slot
+	{
+		NameID Name;
+		unsigned int List;
+	};
+
+	unsigned int FindSlot(NameID name) const;
+	void Grow();
+
+	TrackedVector<Slot, Mem_Indices> Slots;
+	TrackedVector<NodeList, Mem_Indices> Lists;
+	unsigned int Used;
+};
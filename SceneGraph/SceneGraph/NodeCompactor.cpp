@@ -0,0 +1,180 @@
+#include "NodeCompactor.h"
+#include "NodeStore.h"
+
+
+NodeCompactor::NodeCompactor()
+{
+	Order = Order_DepthFirst;
+	Current = Stage_Idle;
+	Version = 0;
+	Settled = false;
+	Cursor = 0;
+	Passes = 0;
+	Moved = 0;
+	OutOfPlace = 0;
+}
+
+NodeCompactor::~NodeCompactor()
+{
+}
+
+void NodeCompactor::SetOrder(CompactionOrder order)
+{
+	if(order != Order)
+		Restart();
+	Order = order;
+}
+
+void NodeCompactor::Begin(SceneNode* root, NodeStore& store)
+{
+	Version = store.GetStructureVersion();
+	Nodes.clear();
+	Stack.clear();
+	Owners.assign(store.GetSlotCount(), nullptr);
+	Cursor = 0;
+	OutOfPlace = 0;
+
+	if(Order == Order_DepthFirst)
+	{
+		Frame f = { root, 0 };
+		Stack.push_back(f);
+	}
+	Nodes.push_back(root);
+	Current = Stage_Walk;
+}
+
+// Extend the target order; returns the work done
+unsigned int NodeCompactor::Walk(unsigned int budget)
+{
+	unsigned int done = 0;
+	if(Order == Order_DepthFirst)
+	{
+		// Nodes gets each node when it is pushed, so it ends up in pre-order
+		while(done < budget && !Stack.empty())
+		{
+			Frame& top = Stack.back();
+			if(top.Child == (unsigned int)(top.Node->GetChildInteratorEnd() - top.Node->GetChildInteratorStart()))
+			{
+				Stack.pop_back();
+				continue;
+			}
+
+			SceneNode* child = top.Node->GetChildInteratorStart()[top.Child++].get();
+			Nodes.push_back(child);
+			Frame f = { child, 0 };
+			Stack.push_back(f);
+			done++;
+		}
+		if(Stack.empty())
+			Current = Stage_Move;
+	}
+	else
+	{
+		// Nodes doubles as the queue
+		while(done < budget && Cursor < Nodes.size())
+		{
+			SceneNode* node = Nodes[Cursor++];
+			for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+			{
+				Nodes.push_back(it->get());
+			}
+			done++;
+		}
+		if(Cursor == Nodes.size())
+			Current = Stage_Move;
+	}
+
+	if(Current == Stage_Move)
+	{
+		for(unsigned int i = 0; i < Nodes.size(); i++)
+		{
+			unsigned int slot = Nodes[i]->GetStoreSlot();
+			if(slot < Owners.size())
+				Owners[slot] = Nodes[i];
+			if(slot != i)
+				OutOfPlace++;
+		}
+		Cursor = 0;
+	}
+	return done;
+}
+
+// Point the store's parent links of the node's children at its slot
+void NodeCompactor::Relink(NodeStore& store, SceneNode* node)
+{
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		unsigned int slot = (*it)->GetStoreSlot();
+		if(slot != NodeStore::NoSlot)
+			store.Relink(slot, node->GetStoreSlot());
+	}
+}
+
+unsigned int NodeCompactor::Move(NodeStore& store, unsigned int budget)
+{
+	unsigned int done = 0;
+	while(done < budget && Cursor < Nodes.size())
+	{
+		unsigned int target = Cursor++;
+		SceneNode* node = Nodes[target];
+		unsigned int from = node->GetStoreSlot();
+		if(from == target || from == NodeStore::NoSlot)
+			continue;
+
+		// whatever occupies the target, a node later in the order or a free slot, takes our place
+		SceneNode* other = Owners[target];
+		store.Swap(from, target);
+		node->SetStoreSlot(target);
+		Owners[target] = node;
+		Owners[from] = other;
+		if(other)
+			other->SetStoreSlot(from);
+
+		Relink(store, node);
+		if(other)
+			Relink(store, other);
+		Moved++;
+		done++;
+	}
+
+	if(Cursor == Nodes.size())
+	{
+		store.Trim();
+		Current = Stage_Idle;
+		Settled = true;
+		Passes++;
+	}
+	return done;
+}
+
+bool NodeCompactor::Step(SceneNode* root, NodeStore& store, unsigned int budget)
+{
+	if(!root)
+		return false;
+
+	// the walk and the slot map are only good for the structure they were made from
+	if(store.GetStructureVersion() != Version)
+		Restart();
+	else if(Settled)
+		return false;
+	if(Current == Stage_Idle)
+		Begin(root, store);
+
+	unsigned int done = 0;
+	while(done < budget && Current != Stage_Idle)
+	{
+		unsigned int work = Current == Stage_Walk ? Walk(budget - done) : Move(store, budget - done);
+		done += work;
+		if(Current == Stage_Idle)
+			return true;
+	}
+	return false;
+}
+
+void NodeCompactor::Run(SceneNode* root, NodeStore& store)
+{
+	Restart();
+	while(root && !Step(root, store, ~0u))
+	{
+	}
+}
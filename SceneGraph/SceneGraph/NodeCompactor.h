@@ -0,0 +1,83 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+
+class NodeStore;
+
+enum CompactionOrder
+{
+	Order_DepthFirst,     // a subtree is one contiguous range, matching Update
+	Order_BreadthFirst    // siblings and each level are contiguous
+};
+
+// Incremental defragmentation of a scene's NodeStore. What this reorders is
+// the store only: SceneNode::Update writes each node's transforms into its
+// store slot (reading the slot first to detect changes), so in traversal
+// order those accesses become sequential instead of scattered over the
+// pages, and snapshot readers walk the same order. The node objects
+// themselves are separate allocations that are never moved.
+//
+// A pass first walks
+// the hierarchy to get the target order, then moves nodes into slots
+// 0, 1, 2, ... of that order by swapping slot contents; node slot handles
+// and the parent links of the store are remapped as nodes move. Both
+// phases resume where they stopped, so a pass can be spread over many
+// frames at a budget of nodes per step. At the end of a pass the free
+// slots past the last node are released.
+//
+// A structural change (nodes added, removed or reparented) restarts the
+// pass; once a pass has finished, Step does nothing until the structure
+// changes again. Slots of live nodes change, so snapshot readers should look nodes
+// up with SceneSnapshot::FindSlot rather than keep slots across frames.
+class NodeCompactor
+{
+public:
+	NodeCompactor();
+	~NodeCompactor();
+
+	void SetOrder(CompactionOrder order);
+	CompactionOrder GetOrder() const { return Order;}
+
+	// Do up to budget units of work (nodes walked or moved); returns true when
+	// a pass finished in this step
+	bool Step(SceneNode* root, NodeStore& store, unsigned int budget);
+	// Run a whole pass now
+	void Run(SceneNode* root, NodeStore& store);
+	void Restart() { Current = Stage_Idle; Settled = false;}
+
+	unsigned int GetPasses() const { return Passes;}
+	unsigned int GetMoved() const { return Moved;}
+	// Nodes whose slot differs from their position in the target order, as of the last walk
+	unsigned int GetOutOfPlace() const { return OutOfPlace;}
+
+protected:
+	enum Stage
+	{
+		Stage_Idle,
+		Stage_Walk,
+		Stage_Move
+	};
+
+	struct Frame
+	{
+		SceneNode* Node;
+		unsigned int Child;
+	};
+
+	void Begin(SceneNode* root, NodeStore& store);
+	unsigned int Walk(unsigned int budget);
+	unsigned int Move(NodeStore& store, unsigned int budget);
+	void Relink(NodeStore& store, SceneNode* node);
+
+	CompactionOrder Order;
+	Stage Current;
+	unsigned int Version;              // store structure version the pass started from
+	bool Settled;                      // a pass finished and the structure is still that Version
+	TrackedVector<SceneNode*, Mem_Hierarchy> Nodes;     // target order
+	TrackedVector<Frame, Mem_Hierarchy> Stack;          // depth-first walk
+	unsigned int Cursor;               // breadth-first walk / move position
+	TrackedVector<SceneNode*, Mem_Hierarchy> Owners;    // slot -> node
+	unsigned int Passes;
+	unsigned int Moved;
+	unsigned int OutOfPlace;
+};
@@ -0,0 +1,209 @@
+#include "NodeStore.h"
+#include <cstring>
+#include <algorithm>
+
+
+NodeStore::NodeStore()
+{
+	Slots = 0;
+	Count = 0;
+	CopiedPages = 0;
+	Version = 0;
+	StructureVersion = 0;
+	Generation = 0;
+}
+
+NodeStore::~NodeStore()
+{
+}
+
+const NodeStore::Page& NodeStore::ReadPage(unsigned int slot) const
+{
+	return *Directories[slot >> (PageBits + DirectoryBits)]->Pages[(slot >> PageBits) & (DirectorySize - 1)];
+}
+
+NodeStore::Directory& NodeStore::WriteDirectory(unsigned int d)
+{
+	shared_ptr<Directory>& directory = Directories[d];
+	if(directory->Generation != Generation)
+	{
+		directory = MakeTracked<Directory, Mem_Transforms>(*directory);
+		directory->Generation = Generation;
+	}
+	return *directory;
+}
+
+// The page holding slot, made private to the live store first if a
+// snapshot was taken since it was last copied
+NodeStore::Page& NodeStore::WritePage(unsigned int slot)
+{
+	shared_ptr<Page>& page = WriteDirectory(slot >> (PageBits + DirectoryBits)).Pages[(slot >> PageBits) & (DirectorySize - 1)];
+	if(page->Generation != Generation)
+	{
+		page = MakeTracked<Page, Mem_Transforms>(*page);
+		page->Generation = Generation;
+		CopiedPages++;
+	}
+	return *page;
+}
+
+unsigned int NodeStore::Allocate(ActorID id, unsigned int parent)
+{
+	// Swap leaves stale entries for slots it filled, skip those
+	while(!FreeSlots.empty() && ReadPage(FreeSlots.back()).Alive[FreeSlots.back() & (PageSize - 1)])
+		FreeSlots.pop_back();
+
+	unsigned int slot;
+	if(!FreeSlots.empty())
+	{
+		slot = FreeSlots.back();
+		FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = Slots++;
+		unsigned int d = slot >> (PageBits + DirectoryBits);
+		if(d >= Directories.size())
+		{
+			Directories.push_back(MakeTracked<Directory, Mem_Transforms>());
+			Directories.back()->Generation = Generation;
+		}
+
+		if(!(slot & (PageSize - 1)))
+		{
+			shared_ptr<Page> fresh = MakeTracked<Page, Mem_Transforms>();
+			memset(fresh->Alive, 0, sizeof(fresh->Alive));
+			fresh->Generation = Generation;
+			WriteDirectory(d).Pages[(slot >> PageBits) & (DirectorySize - 1)] = fresh;
+		}
+	}
+
+	Page& page = WritePage(slot);
+	unsigned int i = slot & (PageSize - 1);
+	page.Id[i] = id;
+	page.Parent[i] = parent;
+	page.Local[i] = FSmatrix4::identity();
+	page.World[i] = FSmatrix4::identity();
+	page.Alive[i] = 1;
+
+	Count++;
+	Version++;
+	StructureVersion++;
+	return slot;
+}
+
+void NodeStore::Free(unsigned int slot)
+{
+	WritePage(slot).Alive[slot & (PageSize - 1)] = 0;
+	FreeSlots.push_back(slot);
+	Count--;
+	Version++;
+	StructureVersion++;
+}
+
+void NodeStore::SetParent(unsigned int slot, unsigned int parent)
+{
+	if(ReadPage(slot).Parent[slot & (PageSize - 1)] == parent)
+		return;
+
+	WritePage(slot).Parent[slot & (PageSize - 1)] = parent;
+	Version++;
+	StructureVersion++;
+}
+
+void NodeStore::Relink(unsigned int slot, unsigned int parent)
+{
+	if(ReadPage(slot).Parent[slot & (PageSize - 1)] == parent)
+		return;
+
+	WritePage(slot).Parent[slot & (PageSize - 1)] = parent;
+	Version++;
+}
+
+void NodeStore::Swap(unsigned int a, unsigned int b)
+{
+	if(a == b)
+		return;
+
+	Page& pa = WritePage(a);
+	Page& pb = WritePage(b);
+	unsigned int i = a & (PageSize - 1), j = b & (PageSize - 1);
+	std::swap(pa.Id[i], pb.Id[j]);
+	std::swap(pa.Parent[i], pb.Parent[j]);
+	std::swap(pa.Local[i], pb.Local[j]);
+	std::swap(pa.World[i], pb.World[j]);
+	std::swap(pa.Alive[i], pb.Alive[j]);
+
+	// the slot that became free goes on the free list; its old entry is now stale
+	if(!pa.Alive[i])
+		FreeSlots.push_back(a);
+	if(!pb.Alive[j])
+		FreeSlots.push_back(b);
+	Version++;
+}
+
+void NodeStore::Trim()
+{
+	unsigned int end = Slots;
+	while(end > 0 && !ReadPage(end - 1).Alive[(end - 1) & (PageSize - 1)])
+		end--;
+
+	// release whole pages and directories past the end
+	unsigned int pages = (end + PageSize - 1) >> PageBits;
+	for(unsigned int p = pages; p < ((Slots + PageSize - 1) >> PageBits); p++)
+	{
+		WriteDirectory(p >> DirectoryBits).Pages[p & (DirectorySize - 1)].reset();
+	}
+	Directories.resize((pages + DirectorySize - 1) >> DirectoryBits);
+	Slots = end;
+
+	// lowest free slot last, so allocation fills the front first
+	FreeSlots.clear();
+	for(unsigned int slot = end; slot-- > 0;)
+	{
+		if(!ReadPage(slot).Alive[slot & (PageSize - 1)])
+			FreeSlots.push_back(slot);
+	}
+	Version++;
+}
+
+bool NodeStore::Write(unsigned int slot, const FSmatrix4& local, const FSmatrix4& world)
+{
+	unsigned int i = slot & (PageSize - 1);
+	const Page& current = ReadPage(slot);
+	bool worldChanged = memcmp(current.World[i].getData(), world.getData(), sizeof(float) * 16) != 0;
+	if(!worldChanged && !memcmp(current.Local[i].getData(), local.getData(), sizeof(float) * 16))
+		return false;
+
+	Page& page = WritePage(slot);
+	page.Local[i] = local;
+	page.World[i] = world;
+	Version++;
+	return worldChanged;
+}
+
+shared_ptr<const SceneSnapshot> NodeStore::Snapshot()
+{
+	// everything the snapshot can see is shared from now on
+	Generation++;
+	return make_shared<SceneSnapshot>(Directories, Slots, Count, Version);
+}
+
+
+SceneSnapshot::SceneSnapshot(const NodeStore::DirectoryList& directories, unsigned int slots, unsigned int count, unsigned int version)
+{
+	Directories.assign(directories.begin(), directories.end());
+	Slots = slots;
+	Count = count;
+	Version = version;
+}
+
+unsigned int SceneSnapshot::FindSlot(ActorID id) const
+{
+	for(unsigned int slot = 0; slot < Slots; slot++)
+	{
+		if(IsAlive(slot) && GetId(slot) == id)
+			return slot;
+	}
+	return NodeStore::NoSlot;
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "SceneNode.h"
+#include "SceneMemory.h"
+
+// Paged copy of the hierarchy and transforms of every node in a scene, kept
+// up to date by SceneNode::Update. Pages (256 nodes) and the directories
+// that point to them (256 pages) are shared with snapshots and copied on
+// write: taking a snapshot only copies the directory pointers, and the live
+// scene copies a page the first time it changes it after a snapshot was
+// taken. Sharing is tracked with a generation that each snapshot bumps and
+// that every page and directory is stamped with when it becomes private, so
+// the writer never depends on reference counts that readers on other threads
+// are releasing. Snapshots are taken on the writing thread; readers can keep
+// one as long as they like.
+class SceneSnapshot;
+
+class NodeStore
+{
+public:
+	static const unsigned int PageBits = 8;
+	static const unsigned int PageSize = 1 << PageBits;
+	static const unsigned int DirectoryBits = 8;
+	static const unsigned int DirectorySize = 1 << DirectoryBits;
+	static const unsigned int NoSlot = ~0u;
+
+	struct Page
+	{
+		ActorID Id[PageSize];
+		unsigned int Parent[PageSize];
+		FSmatrix4 Local[PageSize];
+		FSmatrix4 World[PageSize];
+		unsigned char Alive[PageSize];
+		unsigned int Generation;     // private to the store while it matches
+	};
+
+	struct Directory
+	{
+		shared_ptr<Page> Pages[DirectorySize];
+		unsigned int Generation;
+	};
+	typedef TrackedVector<shared_ptr<Directory>, Mem_Transforms> DirectoryList;
+
+	NodeStore();
+	~NodeStore();
+
+	unsigned int Allocate(ActorID id, unsigned int parent);
+	void Free(unsigned int slot);
+	void SetParent(unsigned int slot, unsigned int parent);
+	// Copies the transforms in, touching the page only if they changed
+	// Returns whether the world transformation changed (the local one is stored either way)
+	bool Write(unsigned int slot, const FSmatrix4& local, const FSmatrix4& world);
+
+	// Exchange the contents of two slots (either may be free); parent links
+	// pointing at them are fixed by the caller with Relink
+	void Swap(unsigned int a, unsigned int b);
+	void Relink(unsigned int slot, unsigned int parent);
+	// Drop the free slots (and their pages) past the last live one
+	void Trim();
+	// Bumped by Allocate, Free and SetParent, not by transform writes or Swap
+	unsigned int GetStructureVersion() const { return StructureVersion;}
+
+	unsigned int GetNodeCount() const { return Count;}
+	unsigned int GetSlotCount() const { return Slots;}
+	// Pages copied because a snapshot may have been sharing them
+	unsigned int GetCopiedPages() const { return CopiedPages;}
+
+	// Marks every page shared, so call it on the thread that writes the store
+	shared_ptr<const SceneSnapshot> Snapshot();
+
+protected:
+	const Page& ReadPage(unsigned int slot) const;
+	Directory& WriteDirectory(unsigned int d);
+	Page& WritePage(unsigned int slot);
+
+	DirectoryList Directories;
+	TrackedVector<unsigned int, Mem_Transforms> FreeSlots;
+	unsigned int Slots;
+	unsigned int Count;
+	unsigned int CopiedPages;
+	unsigned int Version;
+	unsigned int StructureVersion;
+	unsigned int Generation;          // bumped by Snapshot
+};
+
+// Immutable view of a NodeStore at the time it was taken
+class SceneSnapshot
+{
+public:
+	SceneSnapshot(const NodeStore::DirectoryList& directories, unsigned int slots, unsigned int count, unsigned int version);
+
+	unsigned int GetVersion() const { return Version;}
+	unsigned int GetNodeCount() const { return Count;}
+	// Slots are numbered 0 .. GetSlotCount() - 1; freed slots are not alive
+	unsigned int GetSlotCount() const { return Slots;}
+
+	bool IsAlive(unsigned int slot) const { return GetPage(slot).Alive[slot & (NodeStore::PageSize - 1)] != 0;}
+	ActorID GetId(unsigned int slot) const { return GetPage(slot).Id[slot & (NodeStore::PageSize - 1)];}
+	unsigned int GetParent(unsigned int slot) const { return GetPage(slot).Parent[slot & (NodeStore::PageSize - 1)];}
+	const FSmatrix4& GetLocal(unsigned int slot) const { return GetPage(slot).Local[slot & (NodeStore::PageSize - 1)];}
+	const FSmatrix4& GetWorld(unsigned int slot) const { return GetPage(slot).World[slot & (NodeStore::PageSize - 1)];}
+
+	// First live slot with the id, or NodeStore::NoSlot
+	unsigned int FindSlot(ActorID id) const;
+
+protected:
+	const NodeStore::Page& GetPage(unsigned int slot) const
+	{
+		return *Directories[slot >> (NodeStore::PageBits + NodeStore::DirectoryBits)]->Pages[(slot >> NodeStore::PageBits) & (NodeStore::DirectorySize - 1)];
+	}
+
+	TrackedVector<shared_ptr<const NodeStore::Directory>, Mem_Transforms> Directories;
+	unsigned int Slots;
+	unsigned int Count;
+	unsigned int Version;
+};
@@ -0,0 +1,356 @@
+#include "OcclusionCuller.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+#include <thread>
+
+static const unsigned int TileSize = 8;
+
+// corner i of a box has x from bit 0, y from bit 1 and z from bit 2;
+// two triangles per face
+static const int BoxTriangles[12][3] =
+{
+	{0, 2, 6}, {0, 6, 4},   // -x
+	{1, 5, 7}, {1, 7, 3},   // +x
+	{0, 4, 5}, {0, 5, 1},   // -y
+	{2, 3, 7}, {2, 7, 6},   // +y
+	{0, 1, 3}, {0, 3, 2},   // -z
+	{4, 6, 7}, {4, 7, 5}    // +z
+};
+
+// Clip-space corners of a node's world bounding box. Returns false if any
+// corner is at or behind the eye, where the projection is not usable.
+static bool ProjectBox(const SceneNode* node, const FSmatrix4& viewProjection, float clip[8][4])
+{
+	Fvector bmin, bmax;
+	node->GetBoundingBox(bmin, bmax);
+	FSmatrix4 m = viewProjection * node->GetWorldTransformation();
+	const float* d = m.getData();
+
+	bool inFront = true;
+	for(int i = 0; i < 8; i++)
+	{
+		float x = (i & 1) ? bmax.x : bmin.x;
+		float y = (i & 2) ? bmax.y : bmin.y;
+		float z = (i & 4) ? bmax.z : bmin.z;
+		for(int r = 0; r < 4; r++)
+		{
+			clip[i][r] = d[r]*x + d[r + 4]*y + d[r + 8]*z + d[r + 12];
+		}
+		if(clip[i][3] <= 1.0e-4f)
+			inFront = false;
+	}
+	return inFront;
+}
+
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+{
+	TilesX = std::max(1u, (width + TileSize - 1) / TileSize);
+	TilesY = std::max(1u, (height + TileSize - 1) / TileSize);
+	Width = TilesX * TileSize;
+	Height = TilesY * TileSize;
+	Threads = 0;
+	ViewProjection = FSmatrix4::identity();
+	Depth.assign(Width * Height, 1.0f);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+}
+
+unsigned int OcclusionCuller::ResolveThreads(unsigned int work) const
+{
+	unsigned int threads = Threads ? Threads : std::max(1u, std::thread::hardware_concurrency());
+	return std::max(1u, std::min(threads, work));
+}
+
+void OcclusionCuller::Begin(const FSmatrix4& viewProjection)
+{
+	ViewProjection = viewProjection;
+	Occluders.clear();
+	Triangles.clear();
+}
+
+void OcclusionCuller::AddOccluder(const SceneNode* node)
+{
+	float clip[8][4];
+	if(!ProjectBox(node, ViewProjection, clip))
+		return;    // crosses the near plane; skipping it only loses occlusion
+
+	ScreenTriangle corners;
+	float sx[8], sy[8], sz[8];
+	for(int i = 0; i < 8; i++)
+	{
+		float invW = 1.0f / clip[i][3];
+		sx[i] = (clip[i][0]*invW*0.5f + 0.5f) * Width;
+		sy[i] = (0.5f - clip[i][1]*invW*0.5f) * Height;
+		sz[i] = clip[i][2]*invW*0.5f + 0.5f;
+	}
+
+	for(int t = 0; t < 12; t++)
+	{
+		for(int v = 0; v < 3; v++)
+		{
+			int c = BoxTriangles[t][v];
+			corners.X[v] = sx[c];
+			corners.Y[v] = sy[c];
+			corners.Z[v] = sz[c];
+		}
+		Triangles.push_back(corners);
+	}
+	Occluders.push_back(node);
+}
+
+void OcclusionCuller::RenderOccluders()
+{
+	std::fill(Depth.begin(), Depth.end(), 1.0f);
+
+	// each worker owns a band of tile rows, so no two threads write the same pixel
+	unsigned int threads = Triangles.empty() ? 1 : ResolveThreads(TilesY);
+	if(threads <= 1)
+	{
+		RasterizeRows(0, Height);
+	}
+	else
+	{
+		Workers.Reserve(threads);
+		Workers.Run(threads, [this, threads](unsigned int t)
+		{
+			RasterizeRows((TilesY * t / threads) * TileSize, (TilesY * (t + 1) / threads) * TileSize);
+		});
+	}
+
+	BuildPyramid();
+}
+
+void OcclusionCuller::RasterizeRows(unsigned int firstRow, unsigned int endRow)
+{
+	for(const ScreenTriangle& tri : Triangles)
+	{
+		RasterizeTriangle(tri, firstRow, endRow);
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& tri, unsigned int firstRow, unsigned int endRow)
+{
+	float x0 = tri.X[0], y0 = tri.Y[0], z0 = tri.Z[0];
+	float x1 = tri.X[1], y1 = tri.Y[1], z1 = tri.Z[1];
+	float x2 = tri.X[2], y2 = tri.Y[2], z2 = tri.Z[2];
+
+	float area = (x1 - x0)*(y2 - y0) - (x2 - x0)*(y1 - y0);
+	if(fabs(area) < 1.0e-6f)
+		return;
+	if(area < 0.0f)
+	{
+		// make the winding consistent so inside is where all edges are positive
+		std::swap(x1, x2); std::swap(y1, y2); std::swap(z1, z2);
+		area = -area;
+	}
+
+	float minX = std::min(x0, std::min(x1, x2)), maxX = std::max(x0, std::max(x1, x2));
+	float minY = std::min(y0, std::min(y1, y2)), maxY = std::max(y0, std::max(y1, y2));
+	if(maxX < 0.0f || maxY < (float)firstRow || minX >= (float)Width || minY >= (float)endRow)
+		return;
+
+	int startX = std::max(0, (int)floor(minX)) & ~3;
+	int lastX = std::min((int)Width - 1, (int)ceil(maxX));
+	int startY = std::max((int)firstRow, (int)floor(minY));
+	int lastY = std::min((int)endRow - 1, (int)ceil(maxY));
+
+	// edge functions E(x, y) = A*x + B*y + C for edges 0->1, 1->2 and 2->0
+	float A[3] = { -(y1 - y0), -(y2 - y1), -(y0 - y2) };
+	float B[3] = { x1 - x0, x2 - x1, x0 - x2 };
+	float C[3] = { -B[0]*y0 - A[0]*x0, -B[1]*y1 - A[1]*x1, -B[2]*y2 - A[2]*x2 };
+
+	// depth plane from the barycentrics: z = z0 + (E20*(z1 - z0) + E01*(z2 - z0)) / area
+	float invArea = 1.0f / area;
+	float Az = (A[2]*(z1 - z0) + A[0]*(z2 - z0)) * invArea;
+	float Bz = (B[2]*(z1 - z0) + B[0]*(z2 - z0)) * invArea;
+	float Cz = z0 + (C[2]*(z1 - z0) + C[0]*(z2 - z0)) * invArea;
+
+#ifdef MATH3D_SSE
+	const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]), az = _mm_set1_ps(Az);
+#endif
+
+	for(int y = startY; y <= lastY; y++)
+	{
+		float py = y + 0.5f;
+		float* row = &Depth[((y / TileSize) * TilesX) * TileSize * TileSize + (y % TileSize) * TileSize];
+
+#ifdef MATH3D_SSE
+		__m128 e0Row = _mm_set1_ps(B[0]*py + C[0]);
+		__m128 e1Row = _mm_set1_ps(B[1]*py + C[1]);
+		__m128 e2Row = _mm_set1_ps(B[2]*py + C[2]);
+		__m128 zRow = _mm_set1_ps(Bz*py + Cz);
+
+		for(int x = startX; x <= lastX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0Row);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1Row);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2Row);
+			__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+			if(_mm_movemask_ps(inside) == 0)
+				continue;
+
+			float* dst = row + (x / TileSize) * TileSize * TileSize + (x % TileSize);
+			__m128 z = _mm_add_ps(_mm_mul_ps(az, px), zRow);
+			__m128 old = _mm_loadu_ps(dst);
+			__m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(dst, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+#else
+		for(int x = startX; x <= lastX; x++)
+		{
+			float px = x + 0.5f;
+			if(A[0]*px + B[0]*py + C[0] < 0.0f || A[1]*px + B[1]*py + C[1] < 0.0f || A[2]*px + B[2]*py + C[2] < 0.0f)
+				continue;
+
+			float* dst = row + (x / TileSize) * TileSize * TileSize + (x % TileSize);
+			*dst = std::min(*dst, Az*px + Bz*py + Cz);
+		}
+#endif
+	}
+}
+
+// Level 0 is the depth buffer in row-major order; every further level keeps
+// the farthest depth of the 2x2 texels below it
+void OcclusionCuller::BuildPyramid()
+{
+	Pyramid.clear();
+	LevelWidth.clear();
+	LevelHeight.clear();
+
+	DepthLevel level(Width * Height);
+	for(unsigned int y = 0; y < Height; y++)
+	{
+		for(unsigned int x = 0; x < Width; x++)
+		{
+			level[y * Width + x] = GetDepth(x, y);
+		}
+	}
+	Pyramid.push_back(level);
+	LevelWidth.push_back(Width);
+	LevelHeight.push_back(Height);
+
+	while(LevelWidth.back() > 1 || LevelHeight.back() > 1)
+	{
+		const DepthLevel& below = Pyramid.back();
+		unsigned int bw = LevelWidth.back(), bh = LevelHeight.back();
+		unsigned int w = std::max(1u, (bw + 1) / 2), h = std::max(1u, (bh + 1) / 2);
+
+		DepthLevel next(w * h);
+		for(unsigned int y = 0; y < h; y++)
+		{
+			unsigned int y0 = std::min(y*2, bh - 1), y1 = std::min(y*2 + 1, bh - 1);
+			for(unsigned int x = 0; x < w; x++)
+			{
+				unsigned int x0 = std::min(x*2, bw - 1), x1 = std::min(x*2 + 1, bw - 1);
+				next[y * w + x] = std::max(std::max(below[y0*bw + x0], below[y0*bw + x1]),
+										   std::max(below[y1*bw + x0], below[y1*bw + x1]));
+			}
+		}
+
+		Pyramid.push_back(next);
+		LevelWidth.push_back(w);
+		LevelHeight.push_back(h);
+	}
+}
+
+float OcclusionCuller::GetDepth(unsigned int x, unsigned int y) const
+{
+	unsigned int tile = (y / TileSize) * TilesX + (x / TileSize);
+	return Depth[tile * TileSize * TileSize + (y % TileSize) * TileSize + (x % TileSize)];
+}
+
+bool OcclusionCuller::IsVisible(const SceneNode* node) const
+{
+	if(Pyramid.empty() || Triangles.empty())
+		return true;
+
+	float clip[8][4];
+	if(!ProjectBox(node, ViewProjection, clip))
+		return true;
+
+	float minX = 1.0e30f, minY = 1.0e30f, maxX = -1.0e30f, maxY = -1.0e30f, minZ = 1.0e30f;
+	for(int i = 0; i < 8; i++)
+	{
+		float invW = 1.0f / clip[i][3];
+		float sx = (clip[i][0]*invW*0.5f + 0.5f) * Width;
+		float sy = (0.5f - clip[i][1]*invW*0.5f) * Height;
+		minX = std::min(minX, sx); maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy); maxY = std::max(maxY, sy);
+		minZ = std::min(minZ, clip[i][2]*invW*0.5f + 0.5f);
+	}
+
+	// off screen is for frustum culling to decide
+	if(maxX < 0.0f || maxY < 0.0f || minX >= Width || minY >= Height)
+		return true;
+
+	minX = std::max(minX, 0.0f);
+	minY = std::max(minY, 0.0f);
+	maxX = std::min(maxX, (float)Width - 1.0f);
+	maxY = std::min(maxY, (float)Height - 1.0f);
+
+	// coarsest level where the rectangle still spans no more than a few texels
+	unsigned int level = 0;
+	float extent = std::max(maxX - minX, maxY - minY);
+	while(level + 1 < Pyramid.size() && extent > 2.0f * (1u << level))
+		level++;
+
+	const DepthLevel& texels = Pyramid[level];
+	unsigned int w = LevelWidth[level], h = LevelHeight[level];
+	unsigned int x0 = std::min(w - 1, (unsigned int)minX >> level), x1 = std::min(w - 1, (unsigned int)maxX >> level);
+	unsigned int y0 = std::min(h - 1, (unsigned int)minY >> level), y1 = std::min(h - 1, (unsigned int)maxY >> level);
+
+	for(unsigned int y = y0; y <= y1; y++)
+	{
+		for(unsigned int x = x0; x <= x1; x++)
+		{
+			if(minZ <= texels[y * w + x])
+				return true;
+		}
+	}
+	return false;
+}
+
+unsigned int OcclusionCuller::TestVisibility(const MeshNodeList& nodes, TrackedVector<unsigned char, Mem_Render>& visible) const
+{
+	visible.assign(nodes.size(), 1);
+	if(nodes.empty() || Triangles.empty())
+		return 0;
+
+	auto test = [&](size_t first, size_t end)
+	{
+		for(size_t i = first; i < end; i++)
+		{
+			// an occluder never hides itself
+			visible[i] = nodes[i]->IsOccluder() || IsVisible(nodes[i]) ? 1 : 0;
+		}
+	};
+
+	// keep at least a few hundred candidates per worker, threads are not free
+	unsigned int threads = ResolveThreads((unsigned int)(nodes.size() / 256 + 1));
+	if(threads <= 1)
+	{
+		test(0, nodes.size());
+	}
+	else
+	{
+		Workers.Reserve(threads);
+		Workers.Run(threads, [&](unsigned int t)
+		{
+			test(nodes.size() * t / threads, nodes.size() * (t + 1) / threads);
+		});
+	}
+
+	unsigned int occluded = 0;
+	for(unsigned char v : visible)
+	{
+		if(!v)
+			occluded++;
+	}
+	return occluded;
+}
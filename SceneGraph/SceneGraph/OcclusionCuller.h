@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+#include "WorkerPool.h"
+
+// CPU software occlusion culling. The bounding boxes of occluder nodes are
+// rasterized into a small tiled depth buffer, a hierarchical-Z pyramid
+// (farthest depth per texel) is built on top of it, and candidate nodes are
+// occluded when their nearest depth is behind every texel their screen
+// rectangle covers. Needs no GPU; rasterization and testing are split
+// across worker threads that persist between frames.
+class OcclusionCuller
+{
+public:
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+	~OcclusionCuller();
+
+	// 0 = one per hardware thread, 1 = run on the calling thread
+	void SetThreads(unsigned int threads) { Threads = threads;}
+	unsigned int GetWidth() const { return Width;}
+	unsigned int GetHeight() const { return Height;}
+
+	// Start a new frame with the camera's view-projection matrix
+	void Begin(const FSmatrix4& viewProjection);
+	void AddOccluder(const SceneNode* node);
+	unsigned int GetOccluderCount() const { return (unsigned int)Occluders.size();}
+	// Rasterize the occluders and build the HiZ pyramid
+	void RenderOccluders();
+
+	// World-space box test against the pyramid
+	bool IsVisible(const SceneNode* node) const;
+	// visible[i] = IsVisible(nodes[i]); returns the number of occluded nodes
+	unsigned int TestVisibility(const MeshNodeList& nodes, TrackedVector<unsigned char, Mem_Render>& visible) const;
+
+	// Depth in [0, 1] (1 = far plane) at pixel (x, y), y going down
+	float GetDepth(unsigned int x, unsigned int y) const;
+
+protected:
+	struct ScreenTriangle
+	{
+		float X[3], Y[3], Z[3];
+	};
+
+	void RasterizeRows(unsigned int firstRow, unsigned int endRow);
+	void RasterizeTriangle(const ScreenTriangle& tri, unsigned int firstRow, unsigned int endRow);
+	void BuildPyramid();
+	unsigned int ResolveThreads(unsigned int work) const;
+
+	unsigned int Width, Height;          // multiples of the tile size
+	unsigned int TilesX, TilesY;
+	unsigned int Threads;
+	FSmatrix4 ViewProjection;
+
+	typedef TrackedVector<float, Mem_Render> DepthLevel;
+
+	TrackedVector<const SceneNode*, Mem_Render> Occluders;
+	TrackedVector<ScreenTriangle, Mem_Render> Triangles;
+	DepthLevel Depth;                           // tile-major, 8x8 pixels per tile
+	TrackedVector<DepthLevel, Mem_Render> Pyramid;   // row-major levels, level 0 = full resolution
+	TrackedVector<unsigned int, Mem_Render> LevelWidth, LevelHeight;
+	mutable WorkerPool Workers;          // also used by the const visibility test
+};
@@ -0,0 +1,136 @@
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+static int OpenCounter(unsigned int type, unsigned long long config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters()
+{
+	const unsigned long long l1dMiss = PERF_COUNT_HW_CACHE_L1D |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+	fds[PE_Cycles]       = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[PE_Instructions] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	fds[PE_L1DMisses]    = OpenCounter(PERF_TYPE_HW_CACHE, l1dMiss);
+	fds[PE_LLCMisses]    = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	fds[PE_BranchMisses] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+PerfCounters::~PerfCounters()
+{
+	for(int i = 0; i < PE_Count; i++)
+	{
+		if(fds[i] >= 0)
+			close(fds[i]);
+	}
+}
+
+void PerfCounters::Start()
+{
+	for(int i = 0; i < PE_Count; i++)
+	{
+		if(fds[i] >= 0)
+		{
+			ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+void PerfCounters::Stop()
+{
+	for(int i = 0; i < PE_Count; i++)
+	{
+		if(fds[i] >= 0)
+			ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+	}
+}
+
+void PerfCounters::Read(unsigned long long values[PE_Count]) const
+{
+	for(int i = 0; i < PE_Count; i++)
+	{
+		values[i] = 0;
+		if(fds[i] < 0)
+			continue;
+
+		// value, time enabled, time running
+		unsigned long long data[3] = { 0, 0, 0 };
+		if(read(fds[i], data, sizeof(data)) != (ssize_t)sizeof(data))
+			continue;
+
+		if(data[2] > 0 && data[2] < data[1])
+			values[i] = (unsigned long long)((double)data[0] * data[1] / data[2]);
+		else
+			values[i] = data[0];
+	}
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+	for(int i = 0; i < PE_Count; i++)
+		fds[i] = -1;
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+void PerfCounters::Start()
+{
+}
+
+void PerfCounters::Stop()
+{
+}
+
+void PerfCounters::Read(unsigned long long values[PE_Count]) const
+{
+	for(int i = 0; i < PE_Count; i++)
+		values[i] = 0;
+}
+
+#endif
+
+bool PerfCounters::IsAvailable() const
+{
+	for(int i = 0; i < PE_Count; i++)
+	{
+		if(fds[i] >= 0)
+			return true;
+	}
+	return false;
+}
+
+const char* PerfCounters::GetEventName(PerfEvent e)
+{
+	switch(e)
+	{
+	case PE_Cycles:       return "cycles";
+	case PE_Instructions: return "instructions";
+	case PE_L1DMisses:    return "L1D misses";
+	case PE_LLCMisses:    return "LLC misses";
+	case PE_BranchMisses: return "branch misses";
+	default:              return "?";
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// Hardware performance counters for benchmark runs.
+// On Linux the counters are read through perf_event_open; each event is
+// opened on its own so a missing or restricted counter only disables that
+// event. Everywhere else IsAvailable() is false and the counters read zero.
+
+enum PerfEvent
+{
+	PE_Cycles,
+	PE_Instructions,
+	PE_L1DMisses,
+	PE_LLCMisses,
+	PE_BranchMisses,
+	PE_Count
+};
+
+class PerfCounters
+{
+public:
+	PerfCounters();
+	~PerfCounters();
+
+	bool IsAvailable() const;
+	bool IsAvailable(PerfEvent e) const { return fds[e] >= 0;}
+
+	void Start();
+	void Stop();
+	// Counts between the last Start/Stop pair, scaled if the kernel multiplexed the counters
+	void Read(unsigned long long values[PE_Count]) const;
+
+	static const char* GetEventName(PerfEvent e);
+
+private:
+	PerfCounters(const PerfCounters&);
+	PerfCounters& operator=(const PerfCounters&);
+
+	int fds[PE_Count];
+};
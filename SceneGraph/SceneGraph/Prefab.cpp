@@ -0,0 +1,331 @@
+#include "Prefab.h"
+#include "Scene.h"
+#include "../Math3D/matrixops.h"
+#include <algorithm>
+
+
+Prefab::Prefab(shared_ptr<SceneNode> templateRoot)
+{
+	BoundsCenter = Fvector(0.0f, 0.0f, 0.0f);
+	BoundsRadius = 0.0f;
+	if(!templateRoot)
+		return;
+
+	Flatten(templateRoot.get(), -1);
+
+	// bound the nodes' spheres in template space
+	for(unsigned int i = 0; i < Parent.size(); i++)
+	{
+		const float* m = ModelSpace[i].getData();
+		BoundsCenter += Fvector(m[12], m[13], m[14]);
+	}
+	BoundsCenter /= (float)Parent.size();
+
+	for(unsigned int i = 0; i < Parent.size(); i++)
+	{
+		const float* m = ModelSpace[i].getData();
+		float axis = std::max(m[0]*m[0] + m[1]*m[1] + m[2]*m[2], std::max(m[4]*m[4] + m[5]*m[5] + m[6]*m[6], m[8]*m[8] + m[9]*m[9] + m[10]*m[10]));
+		Fvector d(m[12] - BoundsCenter.x, m[13] - BoundsCenter.y, m[14] - BoundsCenter.z);
+		BoundsRadius = std::max(BoundsRadius, d.length() + Radii[i] * sqrt(axis));
+	}
+}
+
+Prefab::~Prefab()
+{
+}
+
+void Prefab::Flatten(SceneNode* node, int parent)
+{
+	int index = (int)Parent.size();
+	Parent.push_back(parent);
+	Names.push_back(node->GetNameID());
+
+	if(parent < 0)
+	{
+		Local.push_back(FSmatrix4::identity());
+		ModelSpace.push_back(FSmatrix4::identity());
+	}
+	else
+	{
+		Local.push_back(node->GetTransform());
+		ModelSpace.push_back(ModelSpace[parent] * node->GetTransform());
+	}
+
+	Fvector s = node->GetModelScale();
+	Radii.push_back(node->Radius() * std::max(fabs(s.x), std::max(fabs(s.y), fabs(s.z))));
+
+	MeshNode* mesh = dynamic_cast<MeshNode*>(node);
+	MeshNodes.push_back(mesh ? 1 : 0);
+	Meshes.push_back(mesh && mesh->GetLODCount() ? mesh->GetLOD(0).Mesh : node->GetNodeName());
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		Flatten(it->get(), index);
+	}
+}
+
+unsigned int Prefab::FindNode(const string& name) const
+{
+	NameID id = NameTable::Find(name);
+	for(unsigned int i = 0; id != InvalidName && i < Names.size(); i++)
+	{
+		if(Names[i] == id)
+			return i;
+	}
+	return ~0u;
+}
+
+
+PrefabNode::PrefabNode(const string& name, ActorID id, shared_ptr<const Prefab> prefab): SceneNode(name, id)
+{
+	IsLeaf = true;
+	Kind = Node_Prefab;
+	SetNodeSize(sizeof(PrefabNode));
+	Template = prefab;
+	Compressed = false;
+}
+
+PrefabNode::~PrefabNode()
+{
+}
+
+unsigned int PrefabNode::AddInstance(const FSmatrix4& root)
+{
+	if(Compressed)
+		PackedRoots.Add(root);
+	else
+		Roots.push_back(root);
+	Overrides.push_back(OverrideList());
+	return (unsigned int)Overrides.size() - 1;
+}
+
+void PrefabNode::RemoveInstance(unsigned int instance)
+{
+	if(Compressed)
+	{
+		PackedRoots.Remove(instance);
+	}
+	else
+	{
+		Roots[instance] = Roots.back();
+		Roots.pop_back();
+	}
+	Overrides[instance].swap(Overrides.back());
+	Overrides.pop_back();
+}
+
+void PrefabNode::SetInstanceTransform(unsigned int instance, const FSmatrix4& root)
+{
+	if(Compressed)
+		PackedRoots.Set(instance, root);
+	else
+		Roots[instance] = root;
+}
+
+FSmatrix4 PrefabNode::GetInstanceTransform(unsigned int instance) const
+{
+	return Compressed ? PackedRoots.Get(instance) : Roots[instance];
+}
+
+bool PrefabNode::SetCompressedRoots(bool compressed, const TransformPrecision& precision)
+{
+	if(compressed)
+	{
+		std::vector<FSmatrix4> roots;
+		for(unsigned int i = 0; i < GetInstanceCount(); i++)
+		{
+			roots.push_back(GetInstanceTransform(i));
+		}
+
+		CompressedTransforms packed;
+		if(!packed.SetPrecision(precision))
+			return false;
+		packed.Reserve((unsigned int)roots.size());
+		for(const FSmatrix4& root : roots)
+		{
+			packed.Add(root);
+		}
+		if(!roots.empty() && !packed.Verify(&roots[0], (unsigned int)roots.size()))
+			return false;
+
+		PackedRoots = packed;
+		Roots.clear();
+		Roots.shrink_to_fit();
+	}
+	else if(Compressed)
+	{
+		Roots.resize(PackedRoots.GetCount());
+		for(unsigned int i = 0; i < PackedRoots.GetCount(); i++)
+		{
+			Roots[i] = PackedRoots.Get(i);
+		}
+		PackedRoots.Clear();
+	}
+	Compressed = compressed;
+	return true;
+}
+
+PrefabNode::Override& PrefabNode::FindOverride(unsigned int instance, unsigned int node)
+{
+	OverrideList& list = Overrides[instance];
+	OverrideList::iterator it = list.begin();
+	while(it != list.end() && it->Node < node)
+		++it;
+
+	if(it == list.end() || it->Node != node)
+	{
+		Override o;
+		o.Node = node;
+		o.HasTransform = false;
+		o.Local = FSmatrix4::identity();
+		it = list.insert(it, o);
+	}
+	return *it;
+}
+
+void PrefabNode::SetOverrideTransform(unsigned int instance, unsigned int node, const FSmatrix4& local)
+{
+	Override& o = FindOverride(instance, node);
+	o.HasTransform = true;
+	o.Local = local;
+}
+
+void PrefabNode::SetOverrideMesh(unsigned int instance, unsigned int node, const string& mesh)
+{
+	FindOverride(instance, node).Mesh = mesh;
+}
+
+const string& PrefabNode::GetInstanceMesh(unsigned int instance, unsigned int node) const
+{
+	for(const Override& o : Overrides[instance])
+	{
+		if(o.Node == node && !o.Mesh.empty())
+			return o.Mesh;
+	}
+	return Template->GetMesh(node);
+}
+
+// World matrices of one instance; base is this node's world times the instance root
+void PrefabNode::UpdateInstance(unsigned int instance, const float* base, float* out) const
+{
+	unsigned int count = Template->GetNodeCount();
+	const OverrideList& overrides = Overrides[instance];
+
+	bool moved = false;
+	for(const Override& o : overrides)
+	{
+		moved |= o.HasTransform;
+	}
+
+	if(!moved)
+	{
+		// rigid copy of the template: one product per node
+		for(unsigned int n = 0; n < count; n++)
+		{
+			Math3d::multiplyMatrix4(base, Template->GetModelSpace(n).getData(), out + n*16);
+		}
+		return;
+	}
+
+	// overridden locals change their whole subtree, so walk the chain
+	size_t next = 0;
+	for(unsigned int n = 0; n < count; n++)
+	{
+		const FSmatrix4* local = &Template->GetLocal(n);
+		while(next < overrides.size() && overrides[next].Node < n)
+			next++;
+		if(next < overrides.size() && overrides[next].Node == n && overrides[next].HasTransform)
+			local = &overrides[next].Local;
+
+		int parent = Template->GetParent(n);
+		const float* parentWorld = parent < 0 ? base : out + parent*16;
+		Math3d::multiplyMatrix4(parentWorld, local->getData(), out + n*16);
+	}
+}
+
+bool PrefabNode::Update(float dt)
+{
+	SceneNode::Update(dt);
+	if(Baked || !Template || Template->GetNodeCount() == 0)
+		return true;
+
+	unsigned int count = Template->GetNodeCount();
+	unsigned int instances = GetInstanceCount();
+	World.resize(instances * count * 16);
+	if(instances == 0)
+		return true;
+
+	// one sphere around all instances, so culling sees the whole set
+	float modelScale = std::max(fabs(ModelScale.x), std::max(fabs(ModelScale.y), fabs(ModelScale.z)));
+	Fvector lo(1.0e30f, 1.0e30f, 1.0e30f), hi(-1.0e30f, -1.0e30f, -1.0e30f);
+	Spheres.resize(instances * 4);
+
+	// compressed roots are decoded a batch at a time
+	const unsigned int batch = 64;
+	float decoded[batch * 16];
+	float m[16];
+
+	for(unsigned int i = 0; i < instances; i++)
+	{
+		const float* root;
+		if(Compressed)
+		{
+			if(i % batch == 0)
+				PackedRoots.Decode(i, std::min(batch, instances - i), decoded);
+			root = decoded + (i % batch) * 16;
+		}
+		else
+		{
+			root = Roots[i].getData();
+		}
+
+		Math3d::multiplyMatrix4(WorldTransformation.getData(), root, m);
+		UpdateInstance(i, m, &World[i * count * 16]);
+
+		const Fvector& c = Template->GetBoundsCenter();
+		float axis = std::max(m[0]*m[0] + m[1]*m[1] + m[2]*m[2], std::max(m[4]*m[4] + m[5]*m[5] + m[6]*m[6], m[8]*m[8] + m[9]*m[9] + m[10]*m[10]));
+		float* s = &Spheres[i * 4];
+		s[0] = m[0]*c.x + m[4]*c.y + m[8]*c.z + m[12];
+		s[1] = m[1]*c.x + m[5]*c.y + m[9]*c.z + m[13];
+		s[2] = m[2]*c.x + m[6]*c.y + m[10]*c.z + m[14];
+		s[3] = Template->GetBoundsRadius() * modelScale * sqrt(axis);
+
+		lo = Fvector(std::min(lo.x, s[0]), std::min(lo.y, s[1]), std::min(lo.z, s[2]));
+		hi = Fvector(std::max(hi.x, s[0]), std::max(hi.y, s[1]), std::max(hi.z, s[2]));
+	}
+
+	SubtreeCenter = (lo + hi) * 0.5f;
+	SubtreeRadius = 0.0f;
+	for(unsigned int i = 0; i < instances; i++)
+	{
+		const float* s = &Spheres[i * 4];
+		Fvector d(s[0] - SubtreeCenter.x, s[1] - SubtreeCenter.y, s[2] - SubtreeCenter.z);
+		SubtreeRadius = std::max(SubtreeRadius, d.length() + s[3]);
+	}
+
+	return true;
+}
+
+void PrefabNode::Draw()
+{
+	if(!Template)
+		return;
+
+	for(unsigned int i = 0; i < GetInstanceCount(); i++)
+	{
+		for(unsigned int n = 0; n < Template->GetNodeCount(); n++)
+		{
+			if(!Template->IsMesh(n))
+				continue;
+
+			if(OwnerScene)
+			{
+				OwnerScene->GetProfiler().Count(PC_DrawsEmitted);
+			}
+			if(Verbose)
+			{
+				std::cout<<"Draw "<<NameText->data()<<"["<<i<<"] "<<Template->GetName(n)<<" ("<<GetInstanceMesh(i, n)<<")"<<std::endl;
+			}
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+#include "CompressedTransforms.h"
+
+// Immutable template of a subtree, flattened once in depth-first order
+// (parents before children). Local transforms, radii, scales and mesh
+// references are shared by every instance; the transform of each node
+// relative to the template root is precomputed, so instances without
+// overrides need a single matrix product per node.
+class Prefab
+{
+public:
+	// The template root's own transform is replaced by each instance's root transform
+	Prefab(shared_ptr<SceneNode> templateRoot);
+	~Prefab();
+
+	unsigned int GetNodeCount() const { return (unsigned int)Parent.size();}
+	// Index of the first node with this name, or ~0u
+	unsigned int FindNode(const string& name) const;
+
+	int GetParent(unsigned int node) const { return Parent[node];}
+	const string& GetName(unsigned int node) const { return NameTable::GetString(Names[node]);}
+	const FSmatrix4& GetLocal(unsigned int node) const { return Local[node];}
+	const FSmatrix4& GetModelSpace(unsigned int node) const { return ModelSpace[node];}
+	bool IsMesh(unsigned int node) const { return MeshNodes[node] != 0;}
+	const string& GetMesh(unsigned int node) const { return Meshes[node];}
+
+	// Sphere around the whole template, relative to its root
+	const Fvector& GetBoundsCenter() const { return BoundsCenter;}
+	float GetBoundsRadius() const { return BoundsRadius;}
+
+protected:
+	void Flatten(SceneNode* node, int parent);
+
+	TrackedVector<int, Mem_Meshes> Parent;
+	TrackedVector<NameID, Mem_Meshes> Names;
+	TrackedVector<FSmatrix4, Mem_Meshes> Local;
+	TrackedVector<FSmatrix4, Mem_Meshes> ModelSpace;
+	TrackedVector<unsigned char, Mem_Meshes> MeshNodes;
+	TrackedVector<string, Mem_Meshes> Meshes;
+	TrackedVector<float, Mem_Meshes> Radii;       // radius times model scale
+	Fvector BoundsCenter;
+	float BoundsRadius;
+};
+
+// Many instances of one prefab as a single leaf of the graph. An instance
+// is only its root transform plus optional per-node overrides; Update
+// computes the world matrices of all instances in one batched pass over
+// the shared template and Draw emits their meshes.
+class PrefabNode: public SceneNode
+{
+public:
+	PrefabNode(const string& name, ActorID id, shared_ptr<const Prefab> prefab);
+	~PrefabNode();
+
+	shared_ptr<const Prefab> GetPrefab() const { return Template;}
+
+	// Instance root transforms are relative to this node
+	unsigned int AddInstance(const FSmatrix4& root);
+	// Swaps the last instance into the freed slot
+	void RemoveInstance(unsigned int instance);
+	unsigned int GetInstanceCount() const { return (unsigned int)Overrides.size();}
+	void SetInstanceTransform(unsigned int instance, const FSmatrix4& root);
+	FSmatrix4 GetInstanceTransform(unsigned int instance) const;
+
+	// Keep the instance roots quantized (24 bytes instead of 64 per instance);
+	// existing roots are converted, and read back with the precision's error.
+	// The conversion is checked against those bounds; if a root exceeds them
+	// (or the precision is invalid) nothing changes and false is returned.
+	bool SetCompressedRoots(bool compressed, const TransformPrecision& precision = TransformPrecision());
+	bool HasCompressedRoots() const { return Compressed;}
+	const CompressedTransforms& GetCompressedRoots() const { return PackedRoots;}
+
+	// Per-instance replacements of a template node's local transform or mesh
+	void SetOverrideTransform(unsigned int instance, unsigned int node, const FSmatrix4& local);
+	void SetOverrideMesh(unsigned int instance, unsigned int node, const string& mesh);
+	void ClearOverrides(unsigned int instance) { Overrides[instance].clear();}
+
+	// Column-major world matrix of a template node in an instance, valid after Update
+	const float* GetInstanceWorld(unsigned int instance, unsigned int node) const { return &World[(instance * Template->GetNodeCount() + node) * 16];}
+	const string& GetInstanceMesh(unsigned int instance, unsigned int node) const;
+
+	virtual bool Update(float dt);
+	virtual void Draw();
+
+protected:
+	struct Override
+	{
+		unsigned int Node;
+		bool HasTransform;
+		FSmatrix4 Local;
+		string Mesh;
+	};
+	typedef TrackedVector<Override, Mem_Meshes> OverrideList;
+
+	Override& FindOverride(unsigned int instance, unsigned int node);
+	void UpdateInstance(unsigned int instance, const float* base, float* out) const;
+
+	shared_ptr<const Prefab> Template;
+	TrackedVector<FSmatrix4, Mem_Transforms> Roots;
+	bool Compressed;
+	CompressedTransforms PackedRoots;                  // used instead of Roots when Compressed
+	TrackedVector<OverrideList, Mem_Meshes> Overrides; // sorted by node, empty for most instances
+	TrackedVector<float, Mem_Transforms> World;        // node count matrices per instance
+	TrackedVector<float, Mem_Transforms> Spheres;      // world sphere per instance, rebuilt by Update
+};
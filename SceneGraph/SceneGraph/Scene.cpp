@@ -1,32 +1,352 @@
 #include "Scene.h"
+#include <algorithm>
 
 
 Scene::Scene()
 {
-	Root = make_shared<SceneNode>("Root", 1);
+	QueryIndexValid = false;
+	CompactionBudget = 0;
+	Components.SetScene(this);
+	Root = MakeNode<SceneNode>("Root", 1);
+	Root->SetScene(this);
+	Root->SetMobility(Mobility_Static);
 
+	RenderOrigin = Dvector(0.0, 0.0, 0.0);
+	RebaseDistance = 0.0f;
+	SetViewer(Fvector(0.0f, 0.0f, 0.0f), 60.0f, 1080.0f);
+	OcclusionEnabled = false;
+	ViewProjection = FSmatrix4::identity();
 	// ...
 }
 
 
 Scene::~Scene(void)
 {
+	// nodes may outlive the scene; detach them
+	if(Root)
+		Root->SetScene(nullptr);
 }
 
 void Scene::OnRender()
 {
-  // Do somthing here
-  // ...
+  ScopedTimer timer(&Profiler, PT_Render);
+
+  if(!Root)
+	  return;
+
+  RenderList.clear();
+  PrefabList.clear();
+  if(Camera)
+  {
+	  CullViews();
+	  RenderList = Views.GetViewNodes(0);
+	  for(size_t i = 0; i < Views.GetVisiblePrefabs().size(); i++)
+	  {
+		  if(Views.GetPrefabMasks()[i] & 1)
+			  PrefabList.push_back(Views.GetVisiblePrefabs()[i]);
+	  }
+  }
+  else
+  {
+	  CollectRenderables(Root.get());
+  }
+
+  if(OcclusionEnabled)
+  {
+	  ScopedTimer occlusionTimer(&Profiler, PT_Occlusion);
+	  Occlusion.Begin(ViewProjection);
+	  for(SceneNode* node : Occluders)
+	  {
+		  Occlusion.AddOccluder(node);
+	  }
+	  Occlusion.RenderOccluders();
+
+	  unsigned int occluded = Occlusion.TestVisibility(RenderList, Visible);
+	  if(occluded)
+	  {
+		  size_t kept = 0;
+		  for(size_t i = 0; i < RenderList.size(); i++)
+		  {
+			  if(Visible[i])
+				  RenderList[kept++] = RenderList[i];
+		  }
+		  RenderList.resize(kept);
+		  Profiler.Count(PC_NodesCulled, occluded);
+	  }
+  }
+
+  {
+	  ScopedTimer lodTimer(&Profiler, PT_LOD);
+	  LODs.Select(RenderList, ViewerPosition, ViewerProjectionScale);
+  }
+
+  for(MeshNode* node : RenderList)
+  {
+	  node->Draw();
+  }
+  for(PrefabNode* prefab : PrefabList)
+  {
+	  prefab->Draw();
+  }
+}
+
+// Gather the drawable leaf nodes of the graph into the render list
+void Scene::CollectRenderables(SceneNode* node)
+{
+	if(node->IsLeafNode())
+	{
+		MeshNode* mesh = dynamic_cast<MeshNode*>(node);
+		if(mesh)
+		{
+			RenderList.push_back(mesh);
+		}
+		else if(PrefabNode* prefab = dynamic_cast<PrefabNode*>(node))
+		{
+			PrefabList.push_back(prefab);
+		}
+		return;
+	}
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		CollectRenderables(it->get());
+	}
+}
+
+// Take the viewer from the camera and cull the camera and every shadow view
+// in a single traversal
+void Scene::CullViews()
+{
+	SetViewer(Camera->GetPosition(), Camera->GetFovY(), ViewportHeight);
+	ViewProjection = Camera->GetViewProjection();
+
+	Views.ClearViews();
+	ViewLights.clear();
+	Views.AddView(Camera->GetFrustum());
+	ViewLights.push_back(nullptr);
+
+	for(auto& light : Lights)
+	{
+		ShadowFrusta.clear();
+		light->GetShadowFrusta(Camera.get(), ShadowFrusta);
+		for(const Frustum& frustum : ShadowFrusta)
+		{
+			if(Views.AddView(frustum) < ViewCuller::MaxViews)
+				ViewLights.push_back(light.get());
+		}
+	}
+
+	ScopedTimer cullingTimer(&Profiler, PT_Culling);
+	Views.Cull(Root.get());
+}
+
+void Scene::SetUpdateTier(ActorID id, UpdateTier tier, unsigned int interval)
+{
+	shared_ptr<SceneNode> node = FindActor(id);
+	if(!node)
+		return;
+
+	if(tier == Tier_EveryFrame)
+		Scheduler.RemoveNode(node.get());
+	else
+		Scheduler.AddNode(node, tier, interval);
+}
+
+BehaviourHandle Scene::StartBehaviour(ActorID id, Behaviour* behaviour)
+{
+	shared_ptr<SceneNode> node = FindActor(id);
+	if(!node)
+	{
+		delete behaviour;
+		return InvalidBehaviour;
+	}
+	return Behaviours.Start(node, behaviour);
+}
+
+void Scene::RequestUpdate(ActorID id)
+{
+	shared_ptr<SceneNode> node = FindActor(id);
+	if(node)
+		Scheduler.Request(node.get());
+}
+
+unsigned int Scene::BakeStatic()
+{
+	if(!Root)
+		return 0;
+
+	// bake with up to date world matrices and bounds
+	Root->Update(0.0f);
+
+	std::vector<SceneNode*> roots;
+	FindStaticRoots(Root.get(), true, roots);
+
+	unsigned int baked = 0;
+	for(SceneNode* node : roots)
+	{
+		baked += Baked.Bake(node);
+	}
+	return baked;
+}
+
+// Returns whether the whole subtree is static. Children that are fully static
+// under static ancestors become bake roots unless this node is baked with them.
+bool Scene::FindStaticRoots(SceneNode* node, bool ancestorsStatic, std::vector<SceneNode*>& roots)
+{
+	if(node->IsBaked())
+		return true;
+
+	bool isStatic = node->GetMobility() == Mobility_Static;
+	bool allStatic = isStatic;
+	std::vector<SceneNode*> candidates;
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		SceneNode* child = it->get();
+		if(FindStaticRoots(child, ancestorsStatic && isStatic, roots))
+			candidates.push_back(child);
+		else
+			allStatic = false;
+	}
+
+	// the scene root itself is never baked, it is where actors get added
+	bool bakedWithParent = allStatic && ancestorsStatic && node != Root.get();
+	if(!bakedWithParent && ancestorsStatic && isStatic)
+	{
+		roots.insert(roots.end(), candidates.begin(), candidates.end());
+	}
+	return allStatic;
+}
+
+void Scene::Unbake(SceneNode* node)
+{
+	// the baked root is the topmost baked ancestor
+	SceneNode* root = nullptr;
+	for(SceneNode* n = node; n && n->IsBaked(); n = n->GetParent())
+	{
+		root = n;
+	}
+
+	if(root)
+		Baked.Unbake(root);
+}
+
+void Scene::AddLight(shared_ptr<LightNode> light)
+{
+	if(light && std::find(Lights.begin(), Lights.end(), light) == Lights.end())
+		Lights.push_back(light);
+}
+
+void Scene::RemoveLight(shared_ptr<LightNode> light)
+{
+	Lights.erase(std::remove(Lights.begin(), Lights.end(), light), Lights.end());
+}
+
+void Scene::AddOccluder(SceneNode* node)
+{
+	if(node && std::find(Occluders.begin(), Occluders.end(), node) == Occluders.end())
+		Occluders.push_back(node);
+}
+
+void Scene::RemoveOccluder(SceneNode* node)
+{
+	Occluders.erase(std::remove(Occluders.begin(), Occluders.end(), node), Occluders.end());
+}
+
+void Scene::SetViewer(const Fvector& eye, float fovY, float viewportHeight)
+{
+	ViewerPosition = eye;
+	ViewportHeight = viewportHeight;
+	ViewerProjectionScale = viewportHeight / (2.0f * tan(fovY * 3.141592f / 360.0f));
+}
+
+void Scene::SetRenderOrigin(const Dvector& origin)
+{
+	RenderOrigin = origin;
+	if(!Root)
+		return;
+
+	// every world matrix, frozen or tiered, was relative to the old origin
+	bool rebake = Baked.GetNodeCount() > 0;
+	Baked.Clear();
+	Root->Update(0.0f);
+	Scheduler.Refresh();
+	if(rebake)
+		BakeStatic();
+}
+
+// Only nodes below an OriginNode move with the render origin
+bool Scene::IsUnderOrigin(const SceneNode* node) const
+{
+	for(const SceneNode* n = node->GetParent(); n; n = n->GetParent())
+	{
+		if(n->GetNodeType() == Node_Origin)
+			return true;
+	}
+	return false;
 }
 
 void Scene::OnUpdate(const float dt)
 {
+	Profiler.BeginFrame();
+	SceneMemory::BeginFrame();
+	ScopedTimer timer(&Profiler, PT_Update);
+
 	if(!Root)  
 	{
 		cout<<" Nothing to update !"<<endl;
+		return;
+	}
+
+	Events.Dispatch(Phase_PreUpdate);
+
+	{
+		ScopedTimer animationTimer(&Profiler, PT_Animation);
+		Animations.Update(dt);
+	}
+
+	Behaviours.Update(dt);
+
+	if(Camera && RebaseDistance > 0.0f && IsUnderOrigin(Camera.get()))
+	{
+		Fvector eye = Camera->GetPosition();
+		if(eye.length() > RebaseDistance)
+		{
+			Dvector origin = RenderOrigin + Dvector(eye.x, eye.y, eye.z);
+			SetRenderOrigin(Dvector(floor(origin.x + 0.5), floor(origin.y + 0.5), floor(origin.z + 0.5)));
+		}
 	}
 
 	Root->Update(dt);
+	Scheduler.Update(dt);
+
+	{
+		ScopedTimer broadphaseTimer(&Profiler, PT_Broadphase);
+		Broadphase.Update();
+	}
+
+	Components.SyncTransforms();
+
+	// bounds and tags may have changed
+	QueryIndexValid = false;
+
+	Events.Dispatch(Phase_PostUpdate);
+	Events.Clear();
+
+	// after the events, whose slots refer to this frame's layout
+	if(CompactionBudget)
+	{
+		unsigned int moved = Compactor.GetMoved();
+		Compactor.Step(Root.get(), Store, CompactionBudget);
+		if(Compactor.GetMoved() != moved)
+			QueryIndexValid = false;
+	}
+}
+
+void Scene::Compact()
+{
+	Compactor.Run(Root.get(), Store);
+	QueryIndexValid = false;
 }
 
 void Scene::AddChild(ActorID id, shared_ptr<SceneNode> child)
@@ -34,9 +354,14 @@ void Scene::AddChild(ActorID id, shared_ptr<SceneNode> child)
 	if(id)
 	{
 		ActorMap[id] = child;
+		Profiler.Count(PC_Allocations);
+		Tracker.OnAdded(id);
 	}
 
 	// add light to this node ...
+	shared_ptr<LightNode> light = dynamic_pointer_cast<LightNode>(child);
+	if(light)
+		AddLight(light);
 	
 	// add child scene node
 	Root->AddChild(child);
@@ -49,11 +374,154 @@ void Scene::RemoveChild(ActorID id)
 	shared_ptr<SceneNode> child = FindActor(id);
 	// remove light... remove other associated node
 	//...
+	shared_ptr<LightNode> light = dynamic_pointer_cast<LightNode>(child);
+	if(light)
+		RemoveLight(light);
+	Broadphase.RemoveNode(id);
+	Scheduler.RemoveNode(child.get());
+	Components.RemoveActor(id);
+	if(child)
+	{
+		Behaviours.StopNode(child.get());
+		Animations.UnbindNode(child.get());
+	}
+	if(child && child->IsBaked())
+		Unbake(child.get());
 	// remove the child node
-	ActorMap.erase(id);
-	Root->RemoveChild(id);
+	if(ActorMap.erase(id))
+		Tracker.OnRemoved(id);
+	if(child && child->GetParent())
+		child->GetParent()->RemoveChild(id);
+
+}
+
+void Scene::Reparent(ActorID id, ActorID parentId)
+{
+	shared_ptr<SceneNode> node = FindActor(id);
+	shared_ptr<SceneNode> parent = parentId ? FindActor(parentId) : Root;
+	if(!node || !parent)
+		return;
+
+	// a node cannot move below itself
+	for(SceneNode* p = parent.get(); p; p = p->GetParent())
+	{
+		if(p == node.get())
+			return;
+	}
+	if(node->GetParent() == parent.get())
+		return;
+
+	if(node->IsBaked())
+		Unbake(node.get());
+	if(parent->IsBaked())
+		Unbake(parent.get());
 
+	if(node->GetParent())
+		node->GetParent()->RemoveChild(id);
+	parent->AddChild(node);
+	Tracker.OnReparented(id);
+	Events.Push(Event_NodeReparented, node.get(), node->GetStoreSlot());
 }
+void Scene::AddCollider(ActorID id)
+{
+	shared_ptr<SceneNode> node = FindActor(id);
+	if(node)
+	{
+		Broadphase.AddNode(node);
+	}
+}
+
+void Scene::RemoveCollider(ActorID id)
+{
+	Broadphase.RemoveNode(id);
+}
+
+AnimationHandle Scene::PlayAnimation(shared_ptr<AnimationClip> clip, const std::vector<ActorID>& targets, float speed, bool loop)
+{
+	std::vector<shared_ptr<SceneNode>> nodes;
+	nodes.reserve(targets.size());
+	for(ActorID id : targets)
+	{
+		nodes.push_back(FindActor(id));
+	}
+
+	return Animations.Play(clip, nodes, speed, loop);
+}
+
+const QueryIndex& Scene::GetQueryIndex()
+{
+	if(!QueryIndexValid)
+	{
+		Queries.Build(Root.get());
+		QueryIndexValid = true;
+	}
+	return Queries;
+}
+
+SceneNode* Scene::FindByName(const string& path) const
+{
+	return MatchPath(path, nullptr);
+}
+
+unsigned int Scene::FindAllByName(const string& path, std::vector<SceneNode*>& nodes) const
+{
+	size_t before = nodes.size();
+	MatchPath(path, &nodes);
+	return (unsigned int)(nodes.size() - before);
+}
+
+// Candidates come from the index entry of the last name; each one is checked
+// by walking up its parents. Returns the first match, or collects all of them.
+SceneNode* Scene::MatchPath(const string& path, std::vector<SceneNode*>* all) const
+{
+	const unsigned int maxNames = 32;
+	NameID names[maxNames];
+	unsigned int count = 0;
+
+	bool anchored = !path.empty() && path[0] == '/';
+	size_t start = anchored ? 1 : 0;
+	while(start <= path.size())
+	{
+		size_t end = path.find('/', start);
+		if(end == string::npos)
+			end = path.size();
+		if(count == maxNames)
+			return nullptr;
+
+		// names nobody interned cannot match
+		names[count] = NameTable::Find(path.data() + start, end - start);
+		if(names[count] == InvalidName)
+			return nullptr;
+		count++;
+		start = end + 1;
+	}
+
+	const NameIndex::NodeList* candidates = Names.Find(names[count - 1]);
+	if(!candidates)
+		return nullptr;
+
+	SceneNode* first = nullptr;
+	for(SceneNode* node : *candidates)
+	{
+		SceneNode* n = node->GetParent();
+		unsigned int i = count - 1;
+		while(i > 0 && n && n->GetNameID() == names[i - 1])
+		{
+			n = n->GetParent();
+			i--;
+		}
+		if(i > 0 || (anchored && n != Root.get()))
+			continue;
+
+		if(!all)
+			return node;
+		if(!first)
+			first = node;
+		all->push_back(node);
+	}
+	return first;
+}
+
 shared_ptr<SceneNode> Scene::FindActor(ActorID id)
 {
 	SceneActorMap::iterator it = ActorMap.find(id);
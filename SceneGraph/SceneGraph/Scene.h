@@ -2,15 +2,31 @@
 #include<memory>
 #include <map>
 #include "SceneNode.h"
+#include "SceneProfiler.h"
+#include "Broadphase.h"
+#include "Animation.h"
+#include "LODSelector.h"
+#include "OcclusionCuller.h"
+#include "ViewCuller.h"
+#include "StaticBlock.h"
+#include "UpdateScheduler.h"
+#include "Prefab.h"
+#include "NodeStore.h"
+#include "SceneDelta.h"
+#include "SceneQuery.h"
+#include "ComponentStore.h"
+#include "Behaviour.h"
+#include "SceneEvents.h"
+#include "NodeCompactor.h"
 
 // map actor id with its node
-typedef std::map<ActorID, shared_ptr<SceneNode> > SceneActorMap;
+typedef TrackedMap<ActorID, shared_ptr<SceneNode>, Mem_Indices> SceneActorMap;
 // Only implemented the MeshNode class for demonstration 
 class MeshNode;
 
 // You can implement more node classes, such as list here
-//class CameraNode;
-//class LightNode;
+class CameraNode;
+class LightNode;
 // ...
 
 class Scene
@@ -25,15 +41,170 @@ public:
 	shared_ptr<SceneNode> FindActor(ActorID id);
 	void AddChild(ActorID id, shared_ptr<SceneNode> child);
 	void RemoveChild(ActorID id);
+	// Move an actor (with its subtree) below another actor, or below the root for 0
+	void Reparent(ActorID id, ActorID parentId);
+	const SceneActorMap& GetActors() const { return ActorMap;}
+
+	// Node by name or by a path of names such as "robot/body/head", where each
+	// name is the parent of the next; a leading '/' anchors the path at the
+	// root. Paths may have up to 32 names. Returns the first match, or nullptr.
+	SceneNode* FindByName(const string& path) const;
+	// All nodes matching the name or path; returns how many were added
+	unsigned int FindAllByName(const string& path, std::vector<SceneNode*>& nodes) const;
+	NameIndex& GetNameIndex() { return Names;}
+
+	// Plain-data components of actors; rows carry the actors' world matrices
+	ComponentStore& GetComponents() { return Components;}
+
+	// Run a query over the nodes as of the last update (tags included)
+	unsigned int Query(SceneQuery& query, QueryResult& result) { return query.Run(GetQueryIndex(), result);}
+	const QueryIndex& GetQueryIndex();
+	// Called when nodes join, leave or move within the scene
+	void InvalidateQueries() { QueryIndexValid = false;}
+
+	// Node lifecycle and transform-change queues, handed to subscribers at the
+	// start and end of OnUpdate
+	SceneEvents& GetEvents() { return Events;}
+
+	// Records structural changes and encodes/applies per-frame deltas
+	DeltaTracker& GetDeltaTracker() { return Tracker;}
+
+	SceneProfiler& GetProfiler() { return Profiler;}
+
+	// Immutable copy of the hierarchy and transforms as of the last update.
+	// Take it on the update thread, between updates; the snapshot itself is
+	// cheap and safe to read from other threads while the scene runs on.
+	shared_ptr<const SceneSnapshot> TakeSnapshot() { return Store.Snapshot();}
+	NodeStore& GetNodeStore() { return Store;}
+
+	// Reorder the NodeStore into traversal order a few nodes at a time at the
+	// end of every OnUpdate (0 = off), or all at once with Compact. Only the
+	// store moves (see NodeCompactor); the node objects stay where they are.
+	void SetCompaction(CompactionOrder order, unsigned int nodesPerFrame) { Compactor.SetOrder(order); CompactionBudget = nodesPerFrame;}
+	void Compact();
+	NodeCompactor& GetCompactor() { return Compactor;}
+
+	// Opt an actor into the broadphase; overlapping pairs are refreshed every OnUpdate
+	void AddCollider(ActorID id);
+	void RemoveCollider(ActorID id);
+	const TrackedVector<ActorPair, Mem_Indices>& GetOverlaps() const { return Broadphase.GetOverlaps();}
+	SweepAndPrune& GetBroadphase() { return Broadphase;}
+
+	// Track i of the clip drives actor targets[i]; sampled at the start of every OnUpdate
+	AnimationHandle PlayAnimation(shared_ptr<AnimationClip> clip, const std::vector<ActorID>& targets, float speed = 1.0f, bool loop = true);
+	Animator& GetAnimator() { return Animations;}
+
+	// With an active camera, OnRender culls against the camera and the shadow
+	// views of all lights in one pass and takes the viewer from the camera
+	void SetActiveCamera(shared_ptr<CameraNode> camera) { Camera = camera;}
+	shared_ptr<CameraNode> GetActiveCamera() const { return Camera;}
+	// Lights added with AddChild are registered automatically
+	void AddLight(shared_ptr<LightNode> light);
+	void RemoveLight(shared_ptr<LightNode> light);
+	const TrackedVector<shared_ptr<LightNode>, Mem_Render>& GetLights() const { return Lights;}
+	// View 0 is the camera; the others are shadow views of GetViewLight(view)
+	ViewCuller& GetViewCuller() { return Views;}
+	LightNode* GetViewLight(unsigned int view) const { return ViewLights[view];}
+
+	// Attach a behaviour to an actor; behaviours run at the start of OnUpdate,
+	// before the transform update
+	BehaviourHandle StartBehaviour(ActorID id, Behaviour* behaviour);
+	void SignalEvent(const string& name) { Behaviours.Signal(NameTable::Intern(name));}
+	BehaviourScheduler& GetBehaviours() { return Behaviours;}
+
+	// Update an actor's subtree every frame, every interval frames or only on request
+	void SetUpdateTier(ActorID id, UpdateTier tier, unsigned int interval = 1);
+	void RequestUpdate(ActorID id);
+	UpdateScheduler& GetScheduler() { return Scheduler;}
+
+	// Freeze every subtree that is static together with all its ancestors;
+	// returns the number of nodes baked by this call
+	unsigned int BakeStatic();
+	// Unfreeze the baked subtree containing node
+	void Unbake(SceneNode* node);
+	const StaticBlock& GetStaticBlock() const { return Baked;}
+
+	// World matrices are relative to the render origin, an absolute
+	// double-precision position (see OriginNode). Moving it shifts every world
+	// matrix, rebakes static geometry and refreshes tiered nodes.
+	void SetRenderOrigin(const Dvector& origin);
+	const Dvector& GetRenderOrigin() const { return RenderOrigin;}
+	// Recenter the render origin on the active camera whenever the camera gets
+	// further than distance from it, checked at the start of OnUpdate (0 = never).
+	// Only a camera below an OriginNode follows the origin, so a camera
+	// anywhere else never triggers a rebase.
+	void SetRebaseDistance(float distance) { RebaseDistance = distance;}
+	float GetRebaseDistance() const { return RebaseDistance;}
+
+	// Viewer used by the render path for LOD selection (fovY in degrees)
+	void SetViewer(const Fvector& eye, float fovY, float viewportHeight);
+	const Fvector& GetViewerPosition() const { return ViewerPosition;}
+	LODSelector& GetLODSelector() { return LODs;}
+
+	// Meshes hidden behind occluder nodes (SceneNode::SetOccluder) are dropped
+	// from the render list; the view-projection is taken from the active camera
+	// when there is one. Occluders need not be meshes or visible themselves.
+	void SetOcclusionCulling(bool enable) { OcclusionEnabled = enable;}
+	bool IsOcclusionCulling() const { return OcclusionEnabled;}
+	void SetViewProjection(const FSmatrix4& viewProjection) { ViewProjection = viewProjection;}
+	const FSmatrix4& GetViewProjection() const { return ViewProjection;}
+	OcclusionCuller& GetOcclusionCuller() { return Occlusion;}
+	// Kept up to date by SceneNode::SetOccluder and by occluders joining or leaving
+	void AddOccluder(SceneNode* node);
+	void RemoveOccluder(SceneNode* node);
+	const TrackedVector<SceneNode*, Mem_Render>& GetOccluders() const { return Occluders;}
 
 protected:
 	shared_ptr<SceneNode> Root;
 	// Implement more scene nodes
-	//shared_ptr<CameraNode> camera_node;
-	//shared_ptr<LightNode> light_node;
+	shared_ptr<CameraNode> Camera;
+	TrackedVector<shared_ptr<LightNode>, Mem_Render> Lights;
 	//...
 	
+	SceneEvents Events;
+	NameIndex Names;
+	QueryIndex Queries;
+	ComponentStore Components;
+	bool QueryIndexValid;
 	SceneActorMap ActorMap;
+	NodeStore Store;
+	NodeCompactor Compactor;
+	unsigned int CompactionBudget;
+	DeltaTracker Tracker;
+	SceneProfiler Profiler;
+	SweepAndPrune Broadphase;
+	Animator Animations;
+
+	void CollectRenderables(SceneNode* node);
+	SceneNode* MatchPath(const string& path, std::vector<SceneNode*>* all) const;
+	bool FindStaticRoots(SceneNode* node, bool ancestorsStatic, std::vector<SceneNode*>& roots);
+	bool IsUnderOrigin(const SceneNode* node) const;
+
+	StaticBlock Baked;
+	UpdateScheduler Scheduler;
+	BehaviourScheduler Behaviours;
+
+	void CullViews();
+
+	Dvector RenderOrigin;
+	float RebaseDistance;
+
+	Fvector ViewerPosition;
+	float ViewerProjectionScale;
+	float ViewportHeight;
+	LODSelector LODs;
+	MeshNodeList RenderList;
+	TrackedVector<PrefabNode*, Mem_Render> PrefabList;
+
+	bool OcclusionEnabled;
+	FSmatrix4 ViewProjection;
+	OcclusionCuller Occlusion;
+	TrackedVector<SceneNode*, Mem_Render> Occluders;
+	TrackedVector<unsigned char, Mem_Render> Visible;
+
+	ViewCuller Views;
+	TrackedVector<LightNode*, Mem_Render> ViewLights;
+	TrackedVector<Frustum, Mem_Render> ShadowFrusta;
 
 };
 
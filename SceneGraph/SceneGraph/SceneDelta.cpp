@@ -0,0 +1,537 @@
+#include "SceneDelta.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cstring>
+
+static const unsigned int DeltaMagic = 0x5344;   // "SD"
+static const float PositionScale = 1024.0f;
+static const unsigned int RotationBits = 15;
+
+enum DeltaNodeKind
+{
+	DK_SceneNode,
+	DK_MeshNode
+};
+
+// Baseline of actors the receiver has not seen yet
+static const QuantizedTransform NoTransform = { {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, 0 };
+
+
+BitWriter::BitWriter(std::vector<unsigned char>& out): Out(out)
+{
+	Pending = 0;
+	PendingBits = 0;
+}
+
+BitWriter::~BitWriter()
+{
+	Flush();
+}
+
+void BitWriter::Write(unsigned int value, unsigned int bits)
+{
+	if(bits < 32)
+		value &= (1u << bits) - 1;
+	Pending |= (unsigned long long)value << PendingBits;
+	PendingBits += bits;
+	while(PendingBits >= 8)
+	{
+		Out.push_back((unsigned char)Pending);
+		Pending >>= 8;
+		PendingBits -= 8;
+	}
+}
+
+void BitWriter::WriteVarint(unsigned int value)
+{
+	while(value >= 0x80)
+	{
+		Write((value & 0x7f) | 0x80, 8);
+		value >>= 7;
+	}
+	Write(value, 8);
+}
+
+void BitWriter::WriteSigned(int value)
+{
+	WriteVarint(((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+}
+
+void BitWriter::WriteFloat(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	Write(bits, 32);
+}
+
+void BitWriter::Flush()
+{
+	if(PendingBits)
+	{
+		Out.push_back((unsigned char)Pending);
+		Pending = 0;
+		PendingBits = 0;
+	}
+}
+
+
+BitReader::BitReader(const std::vector<unsigned char>& in): In(in)
+{
+	Position = 0;
+	Failed = false;
+}
+
+unsigned int BitReader::Read(unsigned int bits)
+{
+	if(Position + bits > In.size() * 8)
+	{
+		Failed = true;
+		return 0;
+	}
+
+	unsigned int value = 0;
+	for(unsigned int done = 0; done < bits; )
+	{
+		unsigned int byte = In[Position >> 3];
+		unsigned int offset = Position & 7;
+		unsigned int take = std::min(8 - offset, bits - done);
+		value |= ((byte >> offset) & ((1u << take) - 1)) << done;
+		done += take;
+		Position += take;
+	}
+	return value;
+}
+
+unsigned int BitReader::ReadVarint()
+{
+	unsigned int value = 0;
+	for(unsigned int shift = 0; shift < 35 && !Failed; shift += 7)
+	{
+		unsigned int group = Read(8);
+		value |= (group & 0x7f) << shift;
+		if(!(group & 0x80))
+			break;
+	}
+	return value;
+}
+
+int BitReader::ReadSigned()
+{
+	unsigned int v = ReadVarint();
+	return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+float BitReader::ReadFloat()
+{
+	unsigned int bits = Read(32);
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+DeltaTracker::DeltaTracker()
+{
+	Recording = false;
+	Frame = 0;
+}
+
+DeltaTracker::~DeltaTracker()
+{
+}
+
+void DeltaTracker::Reset()
+{
+	Frame = 0;
+	Added.clear();
+	Removed.clear();
+	Reparented.clear();
+	Baseline.clear();
+}
+
+void DeltaTracker::OnAdded(ActorID id)
+{
+	if(Recording)
+		Added.push_back(id);
+}
+
+void DeltaTracker::OnRemoved(ActorID id)
+{
+	if(Recording)
+		Removed.push_back(id);
+}
+
+void DeltaTracker::OnReparented(ActorID id)
+{
+	if(Recording)
+		Reparented.push_back(id);
+}
+
+static int QuantizeUnits(float v)
+{
+	float scaled = v * PositionScale;
+	scaled = std::max(-2.0e9f, std::min(2.0e9f, scaled));
+	return (int)floor(scaled + 0.5f);
+}
+
+// Assumes the local transform is translation * rotation * scale without shear
+void DeltaTracker::Quantize(const FSmatrix4& local, QuantizedTransform& q)
+{
+	Fvector t, scale;
+	Fquaternion quat;
+	Math3d::decomposeTRS(local, t, quat, scale);
+	q.T[0] = QuantizeUnits(t.x); q.T[1] = QuantizeUnits(t.y); q.T[2] = QuantizeUnits(t.z);
+	q.S[0] = QuantizeUnits(scale.x); q.S[1] = QuantizeUnits(scale.y); q.S[2] = QuantizeUnits(scale.z);
+
+	// smallest three: drop the largest component, whose sign is made positive
+	float v[4] = { quat.x, quat.y, quat.z, quat.w };
+	unsigned int largest = 0;
+	for(unsigned int i = 1; i < 4; i++)
+	{
+		if(fabs(v[i]) > fabs(v[largest]))
+			largest = i;
+	}
+	float sign = v[largest] < 0.0f ? -1.0f : 1.0f;
+
+	const float range = 0.70710678f;     // the other components lie in [-1/sqrt2, 1/sqrt2]
+	const float steps = (float)((1 << RotationBits) - 1);
+	q.RIndex = largest;
+	for(unsigned int i = 0, j = 0; i < 4; i++)
+	{
+		if(i == largest)
+			continue;
+		float n = (v[i] * sign / range) * 0.5f + 0.5f;
+		n = std::max(0.0f, std::min(1.0f, n));
+		q.R[j++] = (unsigned int)floor(n * steps + 0.5f);
+	}
+}
+
+FSmatrix4 DeltaTracker::Dequantize(const QuantizedTransform& q)
+{
+	const float range = 0.70710678f;
+	const float steps = (float)((1 << RotationBits) - 1);
+
+	float v[4];
+	float sum = 0.0f;
+	for(unsigned int i = 0, j = 0; i < 4; i++)
+	{
+		if(i == q.RIndex)
+			continue;
+		v[i] = ((q.R[j++] / steps) * 2.0f - 1.0f) * range;
+		sum += v[i]*v[i];
+	}
+	v[q.RIndex] = sqrt(std::max(0.0f, 1.0f - sum));
+
+	Fvector t(q.T[0] / PositionScale, q.T[1] / PositionScale, q.T[2] / PositionScale);
+	Fvector s(q.S[0] / PositionScale, q.S[1] / PositionScale, q.S[2] / PositionScale);
+	return Math3d::composeTRS(t, Fquaternion(v[0], v[1], v[2], v[3]), s);
+}
+
+// Parent actor of a node, 0 for the scene root (or a non-actor node)
+static ActorID ParentActor(Scene& scene, SceneNode* node)
+{
+	SceneNode* parent = node->GetParent();
+	if(!parent || !parent->GetNodeID())
+		return 0;
+	return scene.FindActor(parent->GetNodeID()).get() == parent ? parent->GetNodeID() : 0;
+}
+
+template<class A> static void Unique(std::vector<ActorID, A>& ids)
+{
+	std::sort(ids.begin(), ids.end());
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+void DeltaTracker::Encode(Scene& scene, std::vector<unsigned char>& delta)
+{
+	const SceneActorMap& actors = scene.GetActors();
+	delta.clear();
+	BitWriter out(delta);
+	out.Write(DeltaMagic, 16);
+	out.WriteVarint(Frame);
+
+	// fold the recorded events into their net effect for the receiver
+	std::vector<ActorID> removed, added, reparented;
+	Unique(Removed);
+	for(ActorID id : Removed)
+	{
+		if(Baseline.count(id))
+			removed.push_back(id);
+	}
+	if(Frame == 0)
+	{
+		// first delta: the whole scene
+		for(auto& actor : actors)
+		{
+			added.push_back(actor.first);
+		}
+	}
+	else
+	{
+		for(ActorID id : Added)
+		{
+			if(actors.count(id))
+				added.push_back(id);
+		}
+	}
+	Unique(added);
+	Unique(Reparented);
+	for(ActorID id : Reparented)
+	{
+		if(actors.count(id) && !std::binary_search(added.begin(), added.end(), id))
+			reparented.push_back(id);
+	}
+
+	out.WriteVarint((unsigned int)removed.size());
+	for(ActorID id : removed)
+	{
+		out.WriteVarint(id);
+		Baseline.erase(id);
+	}
+
+	out.WriteVarint((unsigned int)added.size());
+	for(ActorID id : added)
+	{
+		SceneNode* node = actors.find(id)->second.get();
+		const string& name = node->GetNodeName();
+		out.WriteVarint(id);
+		out.Write(dynamic_cast<MeshNode*>(node) ? DK_MeshNode : DK_SceneNode, 2);
+		out.WriteVarint((unsigned int)name.size());
+		for(char c : name)
+		{
+			out.Write((unsigned char)c, 8);
+		}
+		out.WriteFloat(node->Radius());
+		out.WriteVarint(ParentActor(scene, node));
+		Baseline.erase(id);   // re-added actors start from nothing
+	}
+
+	out.WriteVarint((unsigned int)reparented.size());
+	for(ActorID id : reparented)
+	{
+		out.WriteVarint(id);
+		out.WriteVarint(ParentActor(scene, actors.find(id)->second.get()));
+	}
+
+	// transforms: the number of changed actors, then for each its id as the
+	// difference from the previous one (ids ascend), 3 component bits and the
+	// changes. Ids rather than positions, so the receiver may hold actors the
+	// sender does not and the other way around.
+	std::vector<ActorID> ids;
+	std::vector<unsigned char> components;
+	std::vector<QuantizedTransform> current;
+	std::vector<const QuantizedTransform*> previous;
+	for(auto& actor : actors)
+	{
+		QuantizedTransform q;
+		Quantize(actor.second->GetTransform(), q);
+
+		auto base = Baseline.find(actor.first);
+		unsigned char mask = 7;
+		if(base != Baseline.end())
+		{
+			const QuantizedTransform& b = base->second;
+			mask = 0;
+			if(memcmp(q.T, b.T, sizeof(q.T)))
+				mask |= 1;
+			if(memcmp(q.R, b.R, sizeof(q.R)) || q.RIndex != b.RIndex)
+				mask |= 2;
+			if(memcmp(q.S, b.S, sizeof(q.S)))
+				mask |= 4;
+		}
+
+		if(mask)
+		{
+			ids.push_back(actor.first);
+			components.push_back(mask);
+			current.push_back(q);
+			previous.push_back(base != Baseline.end() ? &base->second : nullptr);
+		}
+	}
+
+	out.WriteVarint((unsigned int)ids.size());
+	for(size_t i = 0; i < components.size(); i++)
+	{
+		const QuantizedTransform& q = current[i];
+		const QuantizedTransform& b = previous[i] ? *previous[i] : NoTransform;
+		out.WriteVarint(i ? ids[i] - ids[i - 1] : ids[i]);
+		out.Write(components[i], 3);
+		if(components[i] & 1)
+		{
+			for(int c = 0; c < 3; c++)
+				out.WriteSigned(q.T[c] - b.T[c]);
+		}
+		if(components[i] & 2)
+		{
+			out.Write(q.RIndex, 2);
+			for(int c = 0; c < 3; c++)
+				out.Write(q.R[c], RotationBits);
+		}
+		if(components[i] & 4)
+		{
+			for(int c = 0; c < 3; c++)
+				out.WriteSigned(q.S[c] - b.S[c]);
+		}
+	}
+
+	// the receiver ends up with exactly these values
+	for(size_t i = 0; i < ids.size(); i++)
+	{
+		Baseline[ids[i]] = current[i];
+	}
+
+	out.Flush();
+	Added.clear();
+	Removed.clear();
+	Reparented.clear();
+	Frame++;
+}
+
+// One decoded entry of a delta, kept until the whole delta has been read
+struct DeltaAdd
+{
+	ActorID Id;
+	unsigned int Kind;
+	string Name;
+	float Radius;
+	ActorID Parent;
+};
+
+struct DeltaChange
+{
+	ActorID Id;
+	unsigned int Mask;
+	int T[3];
+	unsigned int RIndex;
+	unsigned int R[3];
+	int S[3];
+};
+
+bool DeltaTracker::Apply(Scene& scene, const std::vector<unsigned char>& delta)
+{
+	// decode everything first, so a malformed delta leaves the scene untouched;
+	// every entry takes at least a byte, which bounds the counts
+	BitReader in(delta);
+	if(in.Read(16) != DeltaMagic || in.ReadVarint() != Frame || in.Overrun())
+		return false;
+
+	unsigned int removedCount = in.ReadVarint();
+	if(removedCount > delta.size())
+		return false;
+	std::vector<ActorID> removed(removedCount);
+	for(size_t i = 0; i < removed.size() && !in.Overrun(); i++)
+	{
+		removed[i] = in.ReadVarint();
+	}
+
+	unsigned int addedCount = in.ReadVarint();
+	if(addedCount > delta.size())
+		return false;
+	std::vector<DeltaAdd> added(addedCount);
+	for(size_t i = 0; i < added.size() && !in.Overrun(); i++)
+	{
+		DeltaAdd& a = added[i];
+		a.Id = in.ReadVarint();
+		a.Kind = in.Read(2);
+		unsigned int length = in.ReadVarint();
+		if(in.Overrun() || length > delta.size())
+			return false;
+		a.Name.resize(length);
+		for(unsigned int c = 0; c < length; c++)
+		{
+			a.Name[c] = (char)in.Read(8);
+		}
+		a.Radius = in.ReadFloat();
+		a.Parent = in.ReadVarint();
+	}
+
+	unsigned int reparentedCount = in.ReadVarint();
+	if(reparentedCount > delta.size())
+		return false;
+	std::vector<std::pair<ActorID, ActorID>> reparented(reparentedCount);
+	for(size_t i = 0; i < reparented.size() && !in.Overrun(); i++)
+	{
+		reparented[i].first = in.ReadVarint();
+		reparented[i].second = in.ReadVarint();
+	}
+
+	unsigned int changedCount = in.ReadVarint();
+	if(changedCount > delta.size())
+		return false;
+	std::vector<DeltaChange> changed(changedCount);
+	ActorID id = 0;
+	for(size_t i = 0; i < changed.size() && !in.Overrun(); i++)
+	{
+		DeltaChange& d = changed[i];
+		id += in.ReadVarint();
+		d.Id = id;
+		d.Mask = in.Read(3);
+		for(int c = 0; c < 3; c++)
+			d.T[c] = (d.Mask & 1) ? in.ReadSigned() : 0;
+		d.RIndex = (d.Mask & 2) ? in.Read(2) : 0;
+		for(int c = 0; c < 3; c++)
+			d.R[c] = (d.Mask & 2) ? in.Read(RotationBits) : 0;
+		for(int c = 0; c < 3; c++)
+			d.S[c] = (d.Mask & 4) ? in.ReadSigned() : 0;
+	}
+	if(in.Overrun())
+		return false;
+
+	// apply
+	for(ActorID r : removed)
+	{
+		scene.RemoveChild(r);
+		Baseline.erase(r);
+	}
+
+	std::vector<std::pair<ActorID, ActorID>> parents;
+	for(const DeltaAdd& a : added)
+	{
+		if(scene.FindActor(a.Id))
+			scene.RemoveChild(a.Id);
+		shared_ptr<SceneNode> node = a.Kind == DK_MeshNode ? MakeNode<MeshNode>(a.Name, a.Id) : MakeNode<SceneNode>(a.Name, a.Id);
+		node->SetRadius(a.Radius);
+		scene.AddChild(a.Id, node);
+		Baseline.erase(a.Id);
+		if(a.Parent)
+			parents.push_back(std::make_pair(a.Id, a.Parent));
+	}
+	parents.insert(parents.end(), reparented.begin(), reparented.end());
+
+	// parents are set once every added actor exists
+	for(auto& p : parents)
+	{
+		scene.Reparent(p.first, p.second);
+	}
+
+	for(const DeltaChange& d : changed)
+	{
+		auto base = Baseline.find(d.Id);
+		if(base == Baseline.end())
+			base = Baseline.insert(std::make_pair(d.Id, NoTransform)).first;
+
+		QuantizedTransform& q = base->second;
+		for(int c = 0; c < 3; c++)
+		{
+			q.T[c] += d.T[c];
+			q.S[c] += d.S[c];
+		}
+		if(d.Mask & 2)
+		{
+			q.RIndex = d.RIndex;
+			for(int c = 0; c < 3; c++)
+				q.R[c] = d.R[c];
+		}
+
+		// the baseline is kept either way, so later deltas still decode
+		shared_ptr<SceneNode> actor = scene.FindActor(d.Id);
+		if(actor)
+		{
+			FSmatrix4 local = Dequantize(q);
+			actor->SetTransformation(local);
+		}
+	}
+
+	Frame++;
+	return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <vector>
+#include <map>
+#include "SceneNode.h"
+
+class Scene;
+
+// Bit-granular little-endian writer/reader for the delta format
+class BitWriter
+{
+public:
+	BitWriter(std::vector<unsigned char>& out);
+	~BitWriter();
+
+	void Write(unsigned int value, unsigned int bits);
+	// 7 bits per group, high bit set while more groups follow
+	void WriteVarint(unsigned int value);
+	// zigzag, so small negative values stay short
+	void WriteSigned(int value);
+	void WriteFloat(float value);
+	void Flush();
+
+protected:
+	std::vector<unsigned char>& Out;
+	unsigned long long Pending;
+	unsigned int PendingBits;
+};
+
+class BitReader
+{
+public:
+	BitReader(const std::vector<unsigned char>& in);
+
+	// All reads return 0 once past the end and set the overrun flag
+	unsigned int Read(unsigned int bits);
+	unsigned int ReadVarint();
+	int ReadSigned();
+	float ReadFloat();
+	bool Overrun() const { return Failed;}
+
+protected:
+	const std::vector<unsigned char>& In;
+	size_t Position;     // in bits
+	bool Failed;
+};
+
+// Transform as it is sent: translation and scale in 1/1024 units, rotation
+// as the three smallest quaternion components (15 bits each) plus the
+// index of the dropped largest one
+struct QuantizedTransform
+{
+	int T[3];
+	int S[3];
+	unsigned int R[3];
+	unsigned int RIndex;
+};
+
+// Records the structural changes of a scene (actors added, removed and
+// reparented) and encodes them together with every actor's local transform
+// change since the previous delta. Transforms are quantized and compared
+// with the last values sent, so unchanged actors cost nothing; changed ones
+// are listed by actor id and their changed components are sent as varint
+// differences. A tracker on the receiving scene applies the deltas in order
+// and keeps the same baseline.
+class DeltaTracker
+{
+public:
+	DeltaTracker();
+	~DeltaTracker();
+
+	// Structural changes are only recorded while recording is on
+	void SetRecording(bool r) { Recording = r;}
+	bool IsRecording() const { return Recording;}
+
+	void OnAdded(ActorID id);
+	void OnRemoved(ActorID id);
+	void OnReparented(ActorID id);
+
+	// Everything that changed since the previous Encode; the first delta after
+	// a Reset carries the full state of all actors
+	void Encode(Scene& scene, std::vector<unsigned char>& delta);
+	// Returns false, changing nothing, on a malformed or out-of-order delta
+	bool Apply(Scene& scene, const std::vector<unsigned char>& delta);
+
+	unsigned int GetFrame() const { return Frame;}
+	void Reset();
+
+	static void Quantize(const FSmatrix4& local, QuantizedTransform& q);
+	static FSmatrix4 Dequantize(const QuantizedTransform& q);
+
+protected:
+	bool Recording;
+	unsigned int Frame;
+	TrackedVector<ActorID, Mem_Indices> Added, Removed, Reparented;
+	TrackedMap<ActorID, QuantizedTransform, Mem_Indices> Baseline;
+};
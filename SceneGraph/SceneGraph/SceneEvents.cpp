@@ -0,0 +1,84 @@
+#include "SceneEvents.h"
+#include <algorithm>
+
+
+SceneEvents::SceneEvents()
+{
+	Recording = 0;
+	NextId = 1;
+}
+
+SceneEvents::~SceneEvents()
+{
+}
+
+SceneEvents::SubscriberID SceneEvents::Subscribe(EventPhase phase, unsigned int typeMask, Handler handler)
+{
+	Subscriber s;
+	s.Id = NextId++;
+	s.Phase = phase;
+	s.Types = typeMask;
+	s.Callback = handler;
+	Subscribers.push_back(s);
+
+	Recording |= typeMask;
+	return s.Id;
+}
+
+void SceneEvents::Unsubscribe(SubscriberID subscriber)
+{
+	Subscribers.erase(std::remove_if(Subscribers.begin(), Subscribers.end(), [subscriber](const Subscriber& s) { return s.Id == subscriber;}), Subscribers.end());
+
+	Recording = 0;
+	for(const Subscriber& s : Subscribers)
+	{
+		Recording |= s.Types;
+	}
+	for(int t = 0; t < Event_TypeCount; t++)
+	{
+		if(!IsRecording((SceneEventType)t))
+			Queues[t].clear();
+	}
+}
+
+void SceneEvents::Push(SceneEventType type, SceneNode* node, unsigned int slot)
+{
+	if(!IsRecording(type))
+		return;
+
+	SceneEvent e;
+	e.Node = type == Event_NodeRemoved ? nullptr : node;
+	e.Id = node->GetNodeID();
+	e.Slot = slot;
+	e.Name = node->GetNameID();
+	Queues[type].push_back(e);
+}
+
+void SceneEvents::Dispatch(EventPhase phase)
+{
+	// index loop: a handler may subscribe others
+	for(size_t i = 0; i < Subscribers.size(); i++)
+	{
+		if(Subscribers[i].Phase != phase)
+			continue;
+
+		bool pending = false;
+		for(int t = 0; t < Event_TypeCount; t++)
+		{
+			pending |= ((Subscribers[i].Types >> t) & 1) && !Queues[t].empty();
+		}
+		if(pending)
+		{
+			Handler callback = Subscribers[i].Callback;
+			callback(*this);
+		}
+	}
+}
+
+void SceneEvents::Clear()
+{
+	for(int t = 0; t < Event_TypeCount; t++)
+	{
+		Queues[t].clear();
+	}
+}
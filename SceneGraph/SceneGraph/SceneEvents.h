@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "SceneNode.h"
+
+enum SceneEventType
+{
+	Event_NodeAdded,          // node joined the scene (every node of an added subtree)
+	Event_NodeRemoved,        // node left the scene
+	Event_NodeReparented,     // actor moved by Scene::Reparent
+	Event_TransformChanged,   // world transformation differs from the previous update
+	Event_TypeCount
+};
+
+// Points in Scene::OnUpdate where subscribers get the queued events
+enum EventPhase
+{
+	Phase_PreUpdate,     // start of the frame: changes made since the last update
+	Phase_PostUpdate,    // end of the frame, after transforms and the broadphase; the queues are cleared after it
+	Phase_Count
+};
+
+struct SceneEvent
+{
+	SceneNode* Node;       // nullptr for removals, the node may be gone by the time they are read
+	ActorID Id;
+	unsigned int Slot;     // NodeStore slot; for removals the slot that was freed
+	NameID Name;
+};
+
+typedef TrackedVector<SceneEvent, Mem_Events> SceneEventQueue;
+
+// Node lifecycle and transform events, collected during the frame into one
+// contiguous queue per type and handed to subscribers in bulk at fixed
+// phases of the update. Only the types somebody subscribed to are
+// recorded, so an unobserved scene pays nothing.
+//
+// Scene::Reparent moves a subtree by removing and adding it, so its nodes
+// are reported as removed and added (with new store slots) before the
+// reparent event of the moved actor.
+class SceneEvents
+{
+public:
+	typedef std::function<void(const SceneEvents&)> Handler;
+	typedef unsigned int SubscriberID;
+
+	SceneEvents();
+	~SceneEvents();
+
+	// typeMask has bit (1 << SceneEventType) set for each type wanted
+	SubscriberID Subscribe(EventPhase phase, unsigned int typeMask, Handler handler);
+	void Unsubscribe(SubscriberID subscriber);
+
+	bool IsRecording(SceneEventType type) const { return (Recording >> type) & 1;}
+	void Push(SceneEventType type, SceneNode* node, unsigned int slot);
+
+	// Events of a type queued so far this frame
+	const SceneEventQueue& Get(SceneEventType type) const { return Queues[type];}
+
+	// Run by Scene::OnUpdate
+	void Dispatch(EventPhase phase);
+	void Clear();
+
+protected:
+	struct Subscriber
+	{
+		SubscriberID Id;
+		EventPhase Phase;
+		unsigned int Types;
+		Handler Callback;
+	};
+
+	TrackedVector<Subscriber, Mem_Events> Subscribers;
+	SceneEventQueue Queues[Event_TypeCount];
+	unsigned int Recording;
+	SubscriberID NextId;
+};
@@ -4,14 +4,23 @@
 
 #include "SceneNode.h"
 #include "Scene.h"
+#include "Benchmark.h"
+#include <cstring>
 
-int main()
+int main(int argc, char* argv[])
 {
+	// SceneGraph --bench [--no-counters]
+	if(argc > 1 && strcmp(argv[1], "--bench") == 0)
+	{
+		bool useCounters = !(argc > 2 && strcmp(argv[2], "--no-counters") == 0);
+		RunSceneBenchmarks(useCounters);
+		return 0;
+	}
 
-	// Build a robot
-	shared_ptr<SceneNode> root (new SceneNode("root", 1));
+	// Build a robot (actor 1 is the scene's own root)
+	shared_ptr<SceneNode> root = MakeNode<SceneNode>("robot", 6);
 
-    shared_ptr<SceneNode> body (new SceneNode ("body", 2));
+    shared_ptr<SceneNode> body = MakeNode<SceneNode>("body", 2);
 	body->SetModelScale(Fvector(1.0f, 1.0f, 1.0f));
 
 	float data[16] = {1, 0, 0, 0,
@@ -21,12 +30,12 @@ int main()
 
 	FSmatrix4 bodyTransform (data);
     body->SetTransformation(bodyTransform);
-	shared_ptr<MeshNode> bodyMesh(new MeshNode("body mesh",3/*,shared_ptr<Mesh> mesh */));
+	shared_ptr<MeshNode> bodyMesh = MakeNode<MeshNode>("body mesh", 3/*,shared_ptr<Mesh> mesh */);
 	body->AddChild(bodyMesh); // add body mesh to body operational node
 	root->AddChild(body); // add body node to root node 
 
-	shared_ptr<SceneNode> head (new SceneNode("head",4));
-	shared_ptr<MeshNode> headMesh(new MeshNode("head mesh",5/*,shared_ptr<Mesh> mesh */));
+	shared_ptr<SceneNode> head = MakeNode<SceneNode>("head", 4);
+	shared_ptr<MeshNode> headMesh = MakeNode<MeshNode>("head mesh", 5/*,shared_ptr<Mesh> mesh */);
 	head->SetModelScale(Fvector(1.0f, 1.0f, 1.0f));
 
 	float data2[16] = {1, 0, 0, 0,
@@ -40,11 +49,11 @@ int main()
 
 	 //... to build left arm, right arm, left leg, right leg 
 
-	bool success = root->Update(1.0);
-	if(!success)
-	{
-		cout<<"Failed to update Scene nodes"<<endl;
-	}
+	// Hand the robot to a scene: OnUpdate walks the graph, OnRender draws the meshes
+	Scene scene;
+	scene.AddChild(6, root);
+	scene.OnUpdate(1.0);
+	scene.OnRender();
 
 
 	//--------------- Test Scene class------------
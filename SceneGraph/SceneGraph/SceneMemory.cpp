@@ -0,0 +1,162 @@
+#include "SceneMemory.h"
+#include "../Math3D/allocation.h"
+#include <iostream>
+
+SceneMemory::Counter SceneMemory::Counters[Mem_Count];
+
+namespace
+{
+	void ReportMath3dAllocation(long long bytes)
+	{
+		if(bytes >= 0)
+			SceneMemory::Allocated(Mem_Transforms, (size_t)bytes);
+		else
+			SceneMemory::Freed(Mem_Transforms, (size_t)-bytes);
+	}
+
+	// Installed during static initialisation, so Math3D objects of other
+	// static initialisers may be constructed before it; keep matrices out
+	// of globals or their frees will not balance
+	struct Math3dHookInstaller
+	{
+		Math3dHookInstaller() { Math3d::setAllocationHook(&ReportMath3dAllocation);}
+	} InstallMath3dHook;
+}
+
+
+void SceneMemory::Add(Counter& counter, long long bytes)
+{
+	long long now = counter.Bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	long long peak = counter.Peak.load(std::memory_order_relaxed);
+	while(now > peak && !counter.Peak.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+	{
+	}
+
+	long long budget = counter.Budget.load(std::memory_order_relaxed);
+	if(budget > 0 && now > budget)
+		counter.Exceeded.store(true, std::memory_order_relaxed);
+}
+
+void SceneMemory::Allocated(MemoryCategory c, size_t bytes)
+{
+	Counter& counter = Counters[c];
+	counter.Allocations.fetch_add(1, std::memory_order_relaxed);
+	counter.FrameAllocations.fetch_add(1, std::memory_order_relaxed);
+	Add(counter, (long long)bytes);
+}
+
+void SceneMemory::Freed(MemoryCategory c, size_t bytes)
+{
+	Counters[c].Bytes.fetch_sub((long long)bytes, std::memory_order_relaxed);
+}
+
+void SceneMemory::Resized(MemoryCategory c, size_t oldBytes, size_t newBytes)
+{
+	Add(Counters[c], (long long)newBytes - (long long)oldBytes);
+}
+
+MemoryStats SceneMemory::GetStats(MemoryCategory c)
+{
+	const Counter& counter = Counters[c];
+	MemoryStats s;
+	s.Bytes = counter.Bytes.load(std::memory_order_relaxed);
+	s.Peak = counter.Peak.load(std::memory_order_relaxed);
+	s.Allocations = counter.Allocations.load(std::memory_order_relaxed);
+	s.FrameAllocations = counter.LastFrameAllocations;
+	s.Budget = counter.Budget.load(std::memory_order_relaxed);
+	return s;
+}
+
+long long SceneMemory::GetTotalBytes()
+{
+	long long total = 0;
+	for(int c = 0; c < Mem_Count; c++)
+	{
+		total += Counters[c].Bytes.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void SceneMemory::BeginFrame()
+{
+	for(int c = 0; c < Mem_Count; c++)
+	{
+		Counter& counter = Counters[c];
+		counter.LastFrameAllocations = counter.FrameAllocations.exchange(0, std::memory_order_relaxed);
+
+		if(counter.Action == Budget_Warn && counter.Exceeded.load(std::memory_order_relaxed) && !counter.Reported)
+		{
+			std::cout<<"Memory budget exceeded: "<<GetCategoryName((MemoryCategory)c)<<" peaked at "<<counter.Peak.load()<<" of "<<counter.Budget.load()<<" bytes"<<std::endl;
+			counter.Reported = true;
+		}
+	}
+}
+
+void SceneMemory::ResetPeaks()
+{
+	for(int c = 0; c < Mem_Count; c++)
+	{
+		Counters[c].Peak.store(Counters[c].Bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+void SceneMemory::SetBudget(MemoryCategory c, long long bytes, BudgetAction action)
+{
+	Counter& counter = Counters[c];
+	counter.Action = action;
+	counter.Budget.store(bytes, std::memory_order_relaxed);
+	counter.Reported = false;
+	counter.Exceeded.store(bytes > 0 && counter.Bytes.load(std::memory_order_relaxed) > bytes, std::memory_order_relaxed);
+}
+
+bool SceneMemory::CheckBudgets()
+{
+	bool ok = true;
+	for(int c = 0; c < Mem_Count; c++)
+	{
+		const Counter& counter = Counters[c];
+		if(counter.Action == Budget_Fail && counter.Exceeded.load(std::memory_order_relaxed))
+		{
+			std::cout<<"Memory budget failed: "<<GetCategoryName((MemoryCategory)c)<<" peaked at "<<counter.Peak.load()<<" of "<<counter.Budget.load()<<" bytes"<<std::endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool SceneMemory::IsOverBudget(MemoryCategory c)
+{
+	return Counters[c].Exceeded.load(std::memory_order_relaxed);
+}
+
+void SceneMemory::Print()
+{
+	std::cout<<"Scene memory: "<<GetTotalBytes()<<" bytes (current / peak / allocations / last frame)"<<std::endl;
+	for(int c = 0; c < Mem_Count; c++)
+	{
+		MemoryStats s = GetStats((MemoryCategory)c);
+		std::cout<<"  "<<GetCategoryName((MemoryCategory)c)<<": "<<s.Bytes<<" / "<<s.Peak<<" / "<<s.Allocations<<" / "<<s.FrameAllocations;
+		if(s.Budget > 0)
+			std::cout<<" (budget "<<s.Budget<<")";
+		std::cout<<std::endl;
+	}
+}
+
+const char* SceneMemory::GetCategoryName(MemoryCategory c)
+{
+	switch(c)
+	{
+	case Mem_Nodes: return "Nodes";
+	case Mem_Transforms: return "Transforms";
+	case Mem_Hierarchy: return "Hierarchy";
+	case Mem_Indices: return "Indices";
+	case Mem_Names: return "Names";
+	case Mem_Meshes: return "Meshes";
+	case Mem_Components: return "Components";
+	case Mem_Animation: return "Animation";
+	case Mem_Render: return "Render";
+	case Mem_Events: return "Events";
+	case Mem_SharedBlocks: return "Shared blocks";
+	default: return "?";
+	}
+}
@@ -0,0 +1,192 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Process-wide accounting of the memory held by the scene, by category.
+// Containers tag their allocations by using TrackedAllocator (or the
+// TrackedVector/TrackedMap aliases); objects that are not allocated through
+// a container report themselves with Allocated/Freed. Counters are atomic,
+// so worker threads may allocate freely.
+//
+// Math3D matrices and aligned buffers are reported under Mem_Transforms
+// through the Math3d allocation hook. Nodes created with MakeNode add their
+// shared_ptr control block to Mem_SharedBlocks.
+//
+// Not counted: control blocks of nodes made with make_shared or
+// shared_ptr(new ...), the heap storage of std::function handlers and
+// strings inside tracked elements, the profiler history and temporaries
+// local to a call. Leave headroom for these when sizing from the totals.
+
+enum MemoryCategory
+{
+	Mem_Nodes,        // node objects (sizeof of their class)
+	Mem_Transforms,   // NodeStore pages, baked, instance and packed matrices, palettes, Math3D heap
+	Mem_Hierarchy,    // children lists, update tiers, compaction order
+	Mem_Indices,      // actor map, name index, query index, broadphase, delta baseline
+	Mem_Names,        // interned strings and the name table
+	Mem_Meshes,       // LOD lists, prefab templates and mesh overrides
+	Mem_Components,   // component columns and behaviours
+	Mem_Animation,    // clips and animator channels
+	Mem_Render,       // lights, render lists, view and occlusion culling
+	Mem_Events,       // event queues and subscribers
+	Mem_SharedBlocks, // shared_ptr control blocks of nodes made with MakeNode
+	Mem_Count
+};
+
+// What happens when a category goes over its budget
+enum BudgetAction
+{
+	Budget_Warn,      // printed by the next BeginFrame
+	Budget_Fail       // CheckBudgets returns false
+};
+
+struct MemoryStats
+{
+	long long Bytes;
+	long long Peak;                     // high-water mark since the last ResetPeaks
+	unsigned long long Allocations;     // since start up
+	unsigned int FrameAllocations;      // during the last completed frame
+	long long Budget;                   // 0 when there is none
+};
+
+class SceneMemory
+{
+public:
+	static void Allocated(MemoryCategory c, size_t bytes);
+	static void Freed(MemoryCategory c, size_t bytes);
+	// A block already accounted for changed size; not counted as an allocation
+	static void Resized(MemoryCategory c, size_t oldBytes, size_t newBytes);
+
+	static MemoryStats GetStats(MemoryCategory c);
+	static long long GetTotalBytes();
+
+	// Closes the frame's allocation counts and prints newly exceeded
+	// Budget_Warn budgets; Scene::OnUpdate calls it once per frame
+	static void BeginFrame();
+	static void ResetPeaks();
+
+	// 0 bytes removes the budget; setting one clears its violation
+	static void SetBudget(MemoryCategory c, long long bytes, BudgetAction action = Budget_Warn);
+	// False if a Budget_Fail category went over since its budget was set
+	// (each offender is printed)
+	static bool CheckBudgets();
+	static bool IsOverBudget(MemoryCategory c);
+
+	static void Print();
+	static const char* GetCategoryName(MemoryCategory c);
+
+protected:
+	struct Counter
+	{
+		std::atomic<long long> Bytes;
+		std::atomic<long long> Peak;
+		std::atomic<unsigned long long> Allocations;
+		std::atomic<unsigned int> FrameAllocations;
+		unsigned int LastFrameAllocations;
+		std::atomic<long long> Budget;
+		BudgetAction Action;
+		std::atomic<bool> Exceeded;
+		bool Reported;
+	};
+
+	static void Add(Counter& counter, long long bytes);
+
+	static Counter Counters[Mem_Count];
+};
+
+
+// STL allocator that reports to SceneMemory under a fixed category
+template<class T, MemoryCategory Category>
+class TrackedAllocator
+{
+public:
+	typedef T value_type;
+
+	template<class U>
+	struct rebind { typedef TrackedAllocator<U, Category> other;};
+
+	TrackedAllocator() {}
+	template<class U>
+	TrackedAllocator(const TrackedAllocator<U, Category>&) {}
+
+	T* allocate(size_t n)
+	{
+		T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+		SceneMemory::Allocated(Category, n * sizeof(T));
+		return p;
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		SceneMemory::Freed(Category, n * sizeof(T));
+		::operator delete(p);
+	}
+
+	template<class U>
+	bool operator==(const TrackedAllocator<U, Category>&) const { return true;}
+	template<class U>
+	bool operator!=(const TrackedAllocator<U, Category>&) const { return false;}
+};
+
+template<class T, MemoryCategory Category>
+using TrackedVector = std::vector<T, TrackedAllocator<T, Category>>;
+
+template<class K, class V, MemoryCategory Category>
+using TrackedMap = std::map<K, V, std::less<K>, TrackedAllocator<std::pair<const K, V>, Category>>;
+
+// make_shared with the object and its control block tagged together
+template<class T, MemoryCategory Category, class... Args>
+std::shared_ptr<T> MakeTracked(Args&&... args)
+{
+	return std::allocate_shared<T>(TrackedAllocator<T, Category>(), std::forward<Args>(args)...);
+}
+
+// Allocator for allocate_shared when Object reports its own size: only the
+// bytes around it (the control block) go to Category. They share the
+// object's heap block, so they are not counted as a separate allocation.
+template<class T, class Object, MemoryCategory Category>
+class ControlBlockAllocator
+{
+public:
+	typedef T value_type;
+
+	template<class U>
+	struct rebind { typedef ControlBlockAllocator<U, Object, Category> other;};
+
+	ControlBlockAllocator() {}
+	template<class U>
+	ControlBlockAllocator(const ControlBlockAllocator<U, Object, Category>&) {}
+
+	T* allocate(size_t n)
+	{
+		T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+		SceneMemory::Resized(Category, 0, Overhead(n));
+		return p;
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		SceneMemory::Resized(Category, Overhead(n), 0);
+		::operator delete(p);
+	}
+
+	template<class U>
+	bool operator==(const ControlBlockAllocator<U, Object, Category>&) const { return true;}
+	template<class U>
+	bool operator!=(const ControlBlockAllocator<U, Object, Category>&) const { return false;}
+
+private:
+	static size_t Overhead(size_t n) { return n * sizeof(T) > sizeof(Object) ? n * sizeof(T) - sizeof(Object) : 0;}
+};
+
+// make_shared for scene nodes; the node counts itself under Mem_Nodes and
+// its control block lands in Mem_SharedBlocks
+template<class T, class... Args>
+std::shared_ptr<T> MakeNode(Args&&... args)
+{
+	return std::allocate_shared<T>(ControlBlockAllocator<T, T, Mem_SharedBlocks>(), std::forward<Args>(args)...);
+}
@@ -1,61 +1,271 @@
 #include "SceneNode.h"
+#include "Scene.h"
+#include "../Math3D/matrixops.h"
+#include <algorithm>
 
+bool SceneNode::Verbose = true;
 
-SceneNode::SceneNode(string name, ActorID id)
+
+SceneNode::SceneNode(const string& name, ActorID id)
 {
 	Parent = nullptr;
+	OwnerScene = nullptr;
+	Slot = ~0u;
+	LocalTransformation = FSmatrix4::identity();
+	WorldTransformation = FSmatrix4::identity();
+	LocalDirty = true;
+	WorldVersion = 0;
+	ParentVersion = 0;
 	ModelScale = Fvector(1.0f, 1.0f, 1.0f);
 	IsLeaf = false;
-	this->name = name;
+	Kind = Node_Group;
+	Tags = 0;
+	Mobility = Mobility_Movable;
+	Baked = false;
+	Tier = Tier_EveryFrame;
+	Occluder = false;
+	HasBounds = false;
+	SubtreeCenter = Fvector(0.0f, 0.0f, 0.0f);
+	SubtreeRadius = -1.0f;
+	this->name = NameTable::Intern(name);
+	NameText = &NameTable::GetString(this->name);
 	radius = 0.0f;
 	this->id = id;
+	NodeSize = sizeof(SceneNode);
+	SceneMemory::Allocated(Mem_Nodes, NodeSize);
 }
 
 SceneNode::~SceneNode()
 {
+	SceneMemory::Freed(Mem_Nodes, NodeSize);
+
+	// children kept alive elsewhere must not point back at us
+	for(auto child : Children)
+	{
+		if(child->Parent == this)
+			child->Parent = nullptr;
+	}
+}
+
+void SceneNode::SetNodeSize(size_t bytes)
+{
+	SceneMemory::Resized(Mem_Nodes, NodeSize, bytes);
+	NodeSize = (unsigned int)bytes;
 }
 
 // Add the child scene node to the list of children scene nodes 
 // and set its parent as this scene node
 void SceneNode::AddChild(shared_ptr<SceneNode> s)
 {
+	size_t capacity = Children.capacity();
 	Children.push_back(s);
 	s->Parent = this;
+	s->LocalDirty = true;
+	s->SetScene(OwnerScene);
+
+	if(OwnerScene && Children.capacity() != capacity)
+	{
+		OwnerScene->GetProfiler().Count(PC_Allocations);
+	}
 }
 
+void SceneNode::SetScene(Scene* s)
+{
+	if(OwnerScene)
+		OwnerScene->InvalidateQueries();
+	if(s)
+		s->InvalidateQueries();
+
+	unsigned int parentSlot = Parent ? Parent->Slot : ~0u;
+	if(OwnerScene != s)
+	{
+		if(OwnerScene && Slot != ~0u)
+			OwnerScene->GetNodeStore().Free(Slot);
+		if(OwnerScene)
+		{
+			if(Occluder)
+				OwnerScene->RemoveOccluder(this);
+			OwnerScene->GetNameIndex().Remove(name, this);
+			OwnerScene->GetEvents().Push(Event_NodeRemoved, this, Slot);
+		}
+
+		OwnerScene = s;
+		Slot = s ? s->GetNodeStore().Allocate(id, parentSlot) : ~0u;
+		LocalDirty = true;    // the new slot has not been written
+		if(s)
+		{
+			if(Occluder)
+				s->AddOccluder(this);
+			s->GetNameIndex().Add(name, this);
+			s->GetEvents().Push(Event_NodeAdded, this, Slot);
+		}
+	}
+	else if(s && Slot != ~0u)
+	{
+		s->GetNodeStore().SetParent(Slot, parentSlot);
+	}
+
+	for(auto child : Children)
+	{
+		child->SetScene(s);
+	}
+}
+
+void SceneNode::SetOccluder(bool o)
+{
+	if(OwnerScene && o != Occluder)
+	{
+		if(o)
+			OwnerScene->AddOccluder(this);
+		else
+			OwnerScene->RemoveOccluder(this);
+	}
+	Occluder = o;
+}
+
+void SceneNode::SetMobility(NodeMobility m)
+{
+	Mobility = m;
+	if(m == Mobility_Movable && Baked && OwnerScene)
+	{
+		OwnerScene->Unbake(this);
+	}
+}
+
+void SceneNode::GetBoundingBox(Fvector& min, Fvector& max) const
+{
+	if(HasBounds)
+	{
+		min = BoundsMin.mult(ModelScale);
+		max = BoundsMax.mult(ModelScale);
+	}
+	else
+	{
+		float r = radius * std::max(fabs(ModelScale.x), std::max(fabs(ModelScale.y), fabs(ModelScale.z)));
+		min = Fvector(-r, -r, -r);
+		max = Fvector(r, r, r);
+	}
+}
+
+void SceneNode::GetWorldSphere(Fvector& center, float& r) const
+{
+	const float* m = WorldTransformation.getData();
+	float modelScale = std::max(fabs(ModelScale.x), std::max(fabs(ModelScale.y), fabs(ModelScale.z)));
+	float sx = m[0]*m[0] + m[1]*m[1] + m[2]*m[2];
+	float sy = m[4]*m[4] + m[5]*m[5] + m[6]*m[6];
+	float sz = m[8]*m[8] + m[9]*m[9] + m[10]*m[10];
+
+	center = Fvector(m[12], m[13], m[14]);
+	r = radius * modelScale * sqrt(std::max(sx, std::max(sy, sz)));
+}
+
+// Grow the sphere (center, r) to enclose (c, cr); r < 0 is the empty sphere
+static void MergeSphere(Fvector& center, float& r, const Fvector& c, float cr)
+{
+	if(cr < 0.0f)
+		return;
+	if(r < 0.0f)
+	{
+		center = c;
+		r = cr;
+		return;
+	}
+
+	Fvector delta = c - center;
+	float d = delta.length();
+	if(d + cr <= r)
+		return;
+	if(d + r <= cr)
+	{
+		center = c;
+		r = cr;
+		return;
+	}
+
+	float merged = (d + r + cr) * 0.5f;
+	center += delta * ((merged - r) / d);
+	r = merged;
+}
+
+// Detach the direct child with this id; it leaves the scene with its subtree
 void SceneNode::RemoveChild(ActorID id)
 {
+	for(auto it = Children.begin(); it != Children.end(); ++it)
+	{
+		if((*it)->GetNodeID() != id)
+			continue;
 
-	// Tutorial exercise:  Implement remove child ...
-	cout<<"Child " <<id<<"been removed !"<<endl;
+		shared_ptr<SceneNode> child = *it;
+		Children.erase(it);
+		child->Parent = nullptr;
+		child->SetScene(nullptr);
+		return;
+	}
 }
 
-// Update the scene node's world transfermation matrix for this child scene node
-// by matrix multiplications. Walk down the graph to update all children ...
-// You can implement code to update other perporties of the scene nodes
-bool SceneNode::Update(float dt)
+void SceneNode::UpdateWorldTransformation()
 {
    // If this node has a parent
    if(Parent)
-   {
 	   WorldTransformation = Parent->GetWorldTransformation()* LocalTransformation;
-	   std::cout<<"Update " << name.data() <<std::endl;	
-   }
    else
-   {
 	   WorldTransformation = LocalTransformation;
-	   std::cout<<"Update " << name.data() <<std::endl;	
+}
+
+bool SceneNode::IsWorldStale() const
+{
+	return LocalDirty || (Parent && Parent->WorldVersion != ParentVersion);
+}
+
+Dvector SceneNode::GetAbsolutePosition() const
+{
+	const float* m = WorldTransformation.getData();
+	Dvector p(m[12], m[13], m[14]);
+	return OwnerScene ? OwnerScene->GetRenderOrigin() + p : p;
+}
+
+// Update the scene node's world transfermation matrix for this child scene node
+// by matrix multiplications. Walk down the graph to update all children ...
+// You can implement code to update other perporties of the scene nodes
+bool SceneNode::Update(float dt)
+{
+   // Baked subtrees are frozen; their world matrices live in the scene's static block
+   if(Baked)
+	   return true;
+
+   if(OwnerScene)
+	   OwnerScene->GetProfiler().Count(PC_NodesVisited);
+
+   // Nodes whose local matrix and parent did not change keep their world matrix
+   if(IsWorldStale())
+   {
+	   UpdateWorldTransformation();
+	   LocalDirty = false;
+	   WorldVersion++;
+	   ParentVersion = Parent ? Parent->WorldVersion : 0;
+	   if(OwnerScene)
+		   OwnerScene->GetProfiler().Count(PC_NodesRecomputed);
+
+	   if(OwnerScene && Slot != ~0u)
+		   if(OwnerScene->GetNodeStore().Write(Slot, LocalTransformation, WorldTransformation))
+			   OwnerScene->GetEvents().Push(Event_TransformChanged, this, Slot);
    }
+   if(Verbose) std::cout<<"Update " << NameText->data() <<std::endl;	
 
-   // Iterate thought the scene graph to update each child node
+   // Iterate thought the scene graph to update each child node.
+   // Leaf nodes are drawn by Scene::OnRender.
+
+   // Grouping nodes without a radius only bound their children
+   SubtreeRadius = -1.0f;
+   if(IsLeaf || radius > 0.0f)
+	   GetWorldSphere(SubtreeCenter, SubtreeRadius);
+
+   // Children on a lower update tier are run by the scheduler
    for(auto child : Children)
    {
-	   child->Update(dt);
-
-	   if(child->IsLeaf)
-	   {
-	      child->Draw();
-	   }
+	   if(child->GetUpdateTier() == Tier_EveryFrame)
+		   child->Update(dt);
+	   MergeSphere(SubtreeCenter, SubtreeRadius, child->GetSubtreeCenter(), child->GetSubtreeRadius());
    }
 
    return true;
@@ -66,13 +276,49 @@ bool SceneNode::Update(float dt)
 	 // Draw implementation in leaf node
  }
 
+OriginNode::OriginNode(const string& name, ActorID id, const Dvector& origin): SceneNode(name, id)
+{
+	Kind = Node_Origin;
+	SetNodeSize(sizeof(OriginNode));
+	Origin = origin;
+	AppliedRenderOrigin = Dvector(0.0, 0.0, 0.0);
+}
+
+OriginNode::~OriginNode()
+{
+}
+
+void OriginNode::UpdateWorldTransformation()
+{
+	// the subtraction is done in double; only the small camera-relative offset is rounded
+	AppliedRenderOrigin = OwnerScene ? OwnerScene->GetRenderOrigin() : Dvector(0.0, 0.0, 0.0);
+	Dvector offset = Origin - AppliedRenderOrigin;
+	WorldTransformation = LocalTransformation;
+	float* m = WorldTransformation.getData();
+	m[12] += (float)offset.x;
+	m[13] += (float)offset.y;
+	m[14] += (float)offset.z;
+}
+
+bool OriginNode::IsWorldStale() const
+{
+	if(SceneNode::IsWorldStale())
+		return true;
+	Dvector renderOrigin = OwnerScene ? OwnerScene->GetRenderOrigin() : Dvector(0.0, 0.0, 0.0);
+	return renderOrigin.x != AppliedRenderOrigin.x || renderOrigin.y != AppliedRenderOrigin.y || renderOrigin.z != AppliedRenderOrigin.z;
+}
+
 // MeshNode class implementation example
-MeshNode::MeshNode(string name , ActorID id/*, shared_ptr<Mesh> mesh */): SceneNode(name, id)
+MeshNode::MeshNode(const string& name , ActorID id/*, shared_ptr<Mesh> mesh */): SceneNode(name, id)
 {
+	Kind = Node_Mesh;
+	SetNodeSize(sizeof(MeshNode));
 	Parent = nullptr;
 	ModelScale = Fvector(1.0f, 1.0f, 1.0f);
 	IsLeaf = true;
 	// this-> mesh =  mesh ;
+	Metric = LOD_ScreenSize;
+	CurrentLOD = 0;
 }
 
 MeshNode::~MeshNode()
@@ -84,7 +330,152 @@ void MeshNode::Draw()
 	if(IsLeaf /*&& Mesh */)  // You need your own mesh class !
 	{
 	  /*this->Draw()*/;
-	  std::cout<<"Draw "<<name.data()<<std::endl;
+	  if(OwnerScene)
+	  {
+		  OwnerScene->GetProfiler().Count(PC_DrawsEmitted);
+	  }
+	  if(Verbose)
+	  {
+		  std::cout<<"Draw "<<NameText->data();
+		  if(CurrentLOD < LODs.size())
+			  std::cout<<" (LOD "<<CurrentLOD<<": "<<LODs[CurrentLOD].Mesh<<")";
+		  std::cout<<std::endl;
+	  }
+	}
+
+}
+
+void MeshNode::AddLOD(const string& mesh, float threshold)
+{
+	MeshLOD lod;
+	lod.Mesh = mesh;
+	lod.Threshold = threshold;
+
+	// screen size thresholds shrink and distance thresholds grow from fine to coarse
+	auto it = LODs.begin();
+	while(it != LODs.end() && (Metric == LOD_ScreenSize ? it->Threshold >= threshold : it->Threshold <= threshold))
+		++it;
+	LODs.insert(it, lod);
+}
+
+CameraNode::CameraNode(const string& name, ActorID id): SceneNode(name, id)
+{
+	Kind = Node_Camera;
+	SetNodeSize(sizeof(CameraNode));
+	IsLeaf = true;
+	SetPerspective(60.0f, 16.0f/9.0f, 0.1f, 1000.0f);
+}
+
+CameraNode::~CameraNode()
+{
+}
+
+void CameraNode::SetPerspective(float fovY, float aspect, float nearPlane, float farPlane)
+{
+	FovY = fovY;
+	Aspect = aspect;
+	Near = nearPlane;
+	Far = farPlane;
+	Projection = FSmatrix4::perspProj(fovY, aspect, nearPlane, farPlane);
+}
+
+Fvector CameraNode::GetPosition() const
+{
+	const float* m = WorldTransformation.getData();
+	return Fvector(m[12], m[13], m[14]);
+}
+
+void CameraNode::GetSliceCorners(float nearDistance, float farDistance, Fvector corners[8]) const
+{
+	float t = tan(FovY * 3.141592f / 360.0f);
+
+	for(int i = 0; i < 8; i++)
+	{
+		float d = (i < 4) ? nearDistance : farDistance;
+		corners[i] = Fvector(((i & 1) ? 1.0f : -1.0f) * d * t * Aspect, ((i & 2) ? 1.0f : -1.0f) * d * t, -d);
+	}
+	Math3d::transformPoints(WorldTransformation, corners, corners, 8);
+}
+
+
+LightNode::LightNode(const string& name, ActorID id, LightType type): SceneNode(name, id)
+{
+	Kind = Node_Light;
+	SetNodeSize(sizeof(LightNode));
+	IsLeaf = true;
+	Type = type;
+	Color = Fvector(1.0f, 1.0f, 1.0f);
+	Intensity = 1.0f;
+	Range = 10.0f;
+	SpotAngle = 30.0f;
+	CastShadows = false;
+	CasterDistance = 100.0f;
+}
+
+LightNode::~LightNode()
+{
+}
+
+Fvector LightNode::GetPosition() const
+{
+	const float* m = WorldTransformation.getData();
+	return Fvector(m[12], m[13], m[14]);
+}
+
+Fvector LightNode::GetDirection() const
+{
+	const float* m = WorldTransformation.getData();
+	Fvector dir(-m[8], -m[9], -m[10]);
+	return dir.normalize();
+}
+
+void LightNode::GetShadowFrusta(const CameraNode* camera, TrackedVector<Frustum, Mem_Render>& frusta) const
+{
+	if(!CastShadows)
+		return;
+
+	if(Type == Light_Spot)
+	{
+		FSmatrix4 projection = FSmatrix4::perspProj(SpotAngle * 2.0f, 1.0f, Range * 0.001f, Range);
+		frusta.push_back(Frustum::FromMatrix(projection * WorldTransformation.getInverse()));
+	}
+	else if(Type == Light_Point)
+	{
+		Fvector axes[3] = { Fvector(1.0f, 0.0f, 0.0f), Fvector(0.0f, 1.0f, 0.0f), Fvector(0.0f, 0.0f, 1.0f) };
+		frusta.push_back(Frustum::FromBox(GetPosition(), axes, Fvector(-Range, -Range, -Range), Fvector(Range, Range, Range)));
 	}
+	else if(camera)
+	{
+		// light space basis, z pointing along the light
+		Fvector axes[3];
+		axes[2] = GetDirection();
+		Fvector up = fabs(axes[2].y) < 0.99f ? Fvector(0.0f, 1.0f, 0.0f) : Fvector(1.0f, 0.0f, 0.0f);
+		axes[0] = (up ^ axes[2]).normalize();
+		axes[1] = axes[2] ^ axes[0];
+
+		// every cascade is a box around the bounding sphere of its slice of the
+		// camera volume, stretched back towards the light for off-screen casters
+		float start = camera->GetNear();
+		for(float end : CascadeSplits)
+		{
+			Fvector corners[8];
+			camera->GetSliceCorners(start, end, corners);
 
-}
\ No newline at end of file
+			Fvector center(0.0f, 0.0f, 0.0f);
+			for(int i = 0; i < 8; i++)
+			{
+				center += corners[i];
+			}
+			center /= 8.0f;
+
+			float r = 0.0f;
+			for(int i = 0; i < 8; i++)
+			{
+				r = std::max(r, (corners[i] - center).length());
+			}
+
+			frusta.push_back(Frustum::FromBox(center, axes, Fvector(-r, -r, -r - CasterDistance), Fvector(r, r, r)));
+			start = end;
+		}
+	}
+}
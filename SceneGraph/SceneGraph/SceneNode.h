@@ -12,63 +12,317 @@
 #include <vector>
 #include <memory>
 #include "../Math3D/math3d.h"
+#include "Frustum.h"
+#include "NameTable.h"
+#include "SceneMemory.h"
 
 // In addition to common headers, you also need to include your own vector3D.h, Vector4D.h, Matrix4x4.h
 
 using namespace std;
 typedef unsigned int ActorID;
 
+class Scene;
+class SceneNode;
+
+typedef TrackedVector<shared_ptr<SceneNode>, Mem_Hierarchy> SceneNodeList;
+
+class MeshNode;
+// Meshes gathered for rendering a frame
+typedef TrackedVector<MeshNode*, Mem_Render> MeshNodeList;
+
+// Static nodes never move after load and may be baked by Scene::BakeStatic
+enum NodeMobility
+{
+	Mobility_Movable,
+	Mobility_Static
+};
+
+// How often a node's subtree is updated; lower tiers are run by the
+// scene's UpdateScheduler instead of the per-frame traversal
+enum UpdateTier
+{
+	Tier_EveryFrame,
+	Tier_Interval,     // every Nth frame
+	Tier_OnDemand,     // only when requested
+	Tier_Count
+};
+
+// Concrete class of a node, for queries and tools
+enum NodeType
+{
+	Node_Group,
+	Node_Mesh,
+	Node_Camera,
+	Node_Light,
+	Node_Origin,
+	Node_Prefab,
+	Node_TypeCount
+};
+
 class SceneNode
 {
 public:
-	SceneNode(string name, ActorID id);
+	SceneNode(const string& name, ActorID id);
 	~SceneNode();
 
-	void SetTransformation( FSmatrix4  &localMatrix) { LocalTransformation = localMatrix;}
+	void SetTransformation( FSmatrix4  &localMatrix) { LocalTransformation = localMatrix; LocalDirty = true;}
     const FSmatrix4& GetTransform() const {return LocalTransformation;}
-	FSmatrix4 GetWorldTransformation() const {return WorldTransformation;}
+	// World matrices are relative to the scene's render origin (Scene::GetRenderOrigin)
+	const FSmatrix4& GetWorldTransformation() const {return WorldTransformation;}
+	Dvector GetAbsolutePosition() const;
    
 	void SetModelScale(Fvector s) { ModelScale = s;}
 	void SetRadius(float r) {radius = r;}
 	Fvector GetModelScale() const { return ModelScale;}
-	string GetNodeName() const {return name;}
+	// Names are interned (see NameTable); no copy is made
+	const string& GetNodeName() const {return *NameText;}
+	NameID GetNameID() const {return name;}
 	unsigned int GetNodeID() const {return id;}
-	float Radius() {return radius;}  // useful for the first pass test for collision detection etc.
+	bool IsLeafNode() const {return IsLeaf;}
+	NodeType GetNodeType() const {return Kind;}
+
+	// Game-defined tag bits, matched by SceneQuery
+	void SetTags(unsigned int tags) { Tags = tags;}
+	void AddTags(unsigned int tags) { Tags |= tags;}
+	void RemoveTags(unsigned int tags) { Tags &= ~tags;}
+	unsigned int GetTags() const { return Tags;}
+	float Radius() const {return radius;}  // useful for the first pass test for collision detection etc.
+
+	// Local-space bounding box; without one the box is the cube around Radius()
+	void SetBoundingBox(const Fvector& min, const Fvector& max) { BoundsMin = min; BoundsMax = max; HasBounds = true;}
+	// The local box scaled by ModelScale
+	void GetBoundingBox(Fvector& min, Fvector& max) const;
+	// Occluders have their bounding box rasterized into the occlusion buffer,
+	// so the box must lie inside the solid geometry. Any node type may occlude.
+	void SetOccluder(bool o);
+	bool IsOccluder() const { return Occluder;}
+
+	// World-space bounding sphere of this node alone, from Radius() and the scales
+	void GetWorldSphere(Fvector& center, float& r) const;
+	// Sphere around this node and all its descendants, refreshed by Update;
+	// a negative radius means the subtree has nothing to bound
+	const Fvector& GetSubtreeCenter() const { return SubtreeCenter;}
+	float GetSubtreeRadius() const { return SubtreeRadius;}
 
 	virtual void AddChild(shared_ptr<SceneNode> s);
 	virtual void RemoveChild(ActorID id);
+	// Rebuilds the world matrix only when the local matrix or the parent's
+	// world changed, then walks the every-frame children
 	virtual bool Update(float dt);
 	virtual void Draw(); // implement your own draw function
-	std::vector<shared_ptr<SceneNode>>::const_iterator GetChildInteratorStart() { return Children.begin();}
-	std::vector<shared_ptr<SceneNode>>::const_iterator GetChildInteratorEnd() { return Children.end();}
+	SceneNodeList::const_iterator GetChildInteratorStart() { return Children.begin();}
+	SceneNodeList::const_iterator GetChildInteratorEnd() { return Children.end();}
+
+	SceneNode* GetParent() const { return Parent;}
+
+	// Making a baked node movable unbakes it
+	void SetMobility(NodeMobility m);
+	NodeMobility GetMobility() const { return Mobility;}
+	// Baked nodes keep their world transformation and bounds frozen and are
+	// skipped by Update; set by StaticBlock
+	bool IsBaked() const { return Baked;}
+	void SetBaked(bool b) { Baked = b;}
+
+	// Set by UpdateScheduler; the parent skips nodes that are not updated every frame
+	void SetUpdateTier(UpdateTier t) { Tier = t;}
+	UpdateTier GetUpdateTier() const { return Tier;}
+
+	// The scene this node (and its subtree) belongs to, if any
+	void SetScene(Scene* s);
+	Scene* GetScene() const { return OwnerScene;}
+	// Slot of the node in the scene's NodeStore
+	unsigned int GetStoreSlot() const { return Slot;}
+	// Set by NodeCompactor when it moves the node's slot
+	void SetStoreSlot(unsigned int s) { Slot = s;}
+
+	// Print "Update"/"Draw" traces while walking the graph (on by default for the demo)
+	static bool Verbose;
 
 
 protected:
+	virtual void UpdateWorldTransformation();
+	// The local matrix or the parent's world changed since the last recompute
+	virtual bool IsWorldStale() const;
+	// Derived classes report their size for the Mem_Nodes accounting
+	void SetNodeSize(size_t bytes);
+
 	SceneNode* Parent;
+	Scene*     OwnerScene;
+	unsigned int Slot;
 	FSmatrix4  WorldTransformation;
 	FSmatrix4  LocalTransformation;
+	bool       LocalDirty;
+	unsigned int WorldVersion;         // bumped on every recompute
+	unsigned int ParentVersion;        // parent's WorldVersion at the last recompute
 	Fvector    ModelScale;
-	std::vector<shared_ptr<SceneNode>> Children;
+	SceneNodeList Children;
 	bool IsLeaf;
+	NodeType Kind;
+	unsigned int Tags;
+	NodeMobility Mobility;
+	bool Baked;
+	UpdateTier Tier;
+	bool Occluder;
+	bool HasBounds;
+	Fvector BoundsMin;
+	Fvector BoundsMax;
+	Fvector SubtreeCenter;
+	float SubtreeRadius;
 	float radius;
-	string name;  
+	NameID name;
+	const string* NameText;
 	ActorID  id;
+	unsigned int NodeSize;
 
 };
 
 
+// Root of a chunk of a large world. Its position is a double-precision
+// absolute origin and its children keep float transforms relative to it;
+// the world matrix is the origin minus the scene's render origin (taken in
+// double) followed by the local transformation, so nodes near the camera
+// stay precise however far from zero the chunk is. Origin nodes are placed
+// in absolute coordinates, so they belong directly below the scene root.
+class OriginNode: public SceneNode
+{
+public:
+	OriginNode(const string& name, ActorID id, const Dvector& origin = Dvector(0.0, 0.0, 0.0));
+	~OriginNode();
+
+	void SetOrigin(const Dvector& origin) { Origin = origin; LocalDirty = true;}
+	const Dvector& GetOrigin() const { return Origin;}
+
+protected:
+	virtual void UpdateWorldTransformation();
+	virtual bool IsWorldStale() const;
+
+	Dvector Origin;
+	Dvector AppliedRenderOrigin;       // render origin of the last recompute
+};
+
+
+// How MeshNode LOD thresholds are interpreted
+enum LODMetric
+{
+	LOD_ScreenSize,   // use the LOD while the projected radius in pixels is >= Threshold
+	LOD_Distance      // use the LOD while the distance to the viewer is <= Threshold
+};
+
+struct MeshLOD
+{
+	string Mesh;      // stands in for a mesh reference until there is a mesh class
+	float Threshold;
+};
+
 class MeshNode: public SceneNode
 {
 public:
-	MeshNode(string name , ActorID id/*, shared_ptr<Mesh> mesh */); // You need your own mesh class
+	MeshNode(const string& name , ActorID id/*, shared_ptr<Mesh> mesh */); // You need your own mesh class
 	~MeshNode();
 
 	//shared_ptr<Mesh> GetMesh() { return Mesh;}    // You need your own mesh class
 	//void SetMesh(shared_ptr<Mesh> m) {Mesh = m;}  // You need your own mesh class
 
+	// LOD 0 is the most detailed; entries are kept ordered from fine to coarse,
+	// so set the metric before adding LODs
+	void AddLOD(const string& mesh, float threshold);
+	void ClearLODs() { LODs.clear(); CurrentLOD = 0;}
+	void SetLODMetric(LODMetric m) { Metric = m;}
+	LODMetric GetLODMetric() const { return Metric;}
+	unsigned int GetLODCount() const { return (unsigned int)LODs.size();}
+	const MeshLOD& GetLOD(unsigned int lod) const { return LODs[lod];}
+	unsigned int GetCurrentLOD() const { return CurrentLOD;}
+	void SetCurrentLOD(unsigned int lod) { CurrentLOD = lod;}
+
 	virtual void Draw();
 
 protected:
 	shared_ptr<SceneNode> Parent;
 	// shared_ptr<Mesh> mesh;    // you need to have your own mesh class
+	TrackedVector<MeshLOD, Mem_Meshes> LODs;
+	LODMetric Metric;
+	unsigned int CurrentLOD;
+};
+
+
+// Camera looking down its local -Z axis; the view matrix is the inverse of
+// its world transformation, so it follows whatever it is parented to
+class CameraNode: public SceneNode
+{
+public:
+	CameraNode(const string& name, ActorID id);
+	~CameraNode();
+
+	// fovY in degrees
+	void SetPerspective(float fovY, float aspect, float nearPlane, float farPlane);
+	float GetFovY() const { return FovY;}
+	float GetAspect() const { return Aspect;}
+	float GetNear() const { return Near;}
+	float GetFar() const { return Far;}
+
+	Fvector GetPosition() const;
+	const FSmatrix4& GetProjection() const { return Projection;}
+	FSmatrix4 GetView() const { return WorldTransformation.getInverse();}
+	FSmatrix4 GetViewProjection() const { return Projection * GetView();}
+	Frustum GetFrustum() const { return Frustum::FromMatrix(GetViewProjection());}
+
+	// World-space corners of the view volume between two distances, near quad first
+	void GetSliceCorners(float nearDistance, float farDistance, Fvector corners[8]) const;
+
+protected:
+	float FovY, Aspect, Near, Far;
+	FSmatrix4 Projection;
+};
+
+
+enum LightType
+{
+	Light_Directional,   // shines down its local -Z axis
+	Light_Point,
+	Light_Spot           // cone around its local -Z axis
+};
+
+class LightNode: public SceneNode
+{
+public:
+	LightNode(const string& name, ActorID id, LightType type);
+	~LightNode();
+
+	LightType GetType() const { return Type;}
+	void SetColor(const Fvector& c) { Color = c;}
+	const Fvector& GetColor() const { return Color;}
+	void SetIntensity(float i) { Intensity = i;}
+	float GetIntensity() const { return Intensity;}
+	// Reach of point and spot lights
+	void SetRange(float r) { Range = r;}
+	float GetRange() const { return Range;}
+	// Half angle of the spot cone in degrees
+	void SetSpotAngle(float a) { SpotAngle = a;}
+	float GetSpotAngle() const { return SpotAngle;}
+
+	void SetCastShadows(bool c) { CastShadows = c;}
+	bool GetCastShadows() const { return CastShadows;}
+	// Directional lights: camera distances at which each shadow cascade ends
+	void SetCascadeSplits(const std::vector<float>& splits) { CascadeSplits.assign(splits.begin(), splits.end());}
+	const TrackedVector<float, Mem_Render>& GetCascadeSplits() const { return CascadeSplits;}
+	// How far towards the light shadow casters are still picked up for a cascade
+	void SetCasterDistance(float d) { CasterDistance = d;}
+
+	Fvector GetPosition() const;
+	Fvector GetDirection() const;
+
+	// Views shadow casters have to be drawn into: one per cascade for
+	// directional lights (fitted to the camera), the cone for spot lights and
+	// the box around the range for point lights
+	void GetShadowFrusta(const CameraNode* camera, TrackedVector<Frustum, Mem_Render>& frusta) const;
+
+protected:
+	LightType Type;
+	Fvector Color;
+	float Intensity;
+	float Range;
+	float SpotAngle;
+	bool CastShadows;
+	TrackedVector<float, Mem_Render> CascadeSplits;
+	float CasterDistance;
 };
@@ -0,0 +1,160 @@
+#include "SceneProfiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+SceneProfiler::SceneProfiler(unsigned int historySize)
+{
+	Enabled = true;
+	FrameOpen = false;
+	HistorySize = historySize > 0 ? historySize : 1;
+	Next = 0;
+	History.reserve(HistorySize);
+	memset(&Current, 0, sizeof(Current));
+}
+
+SceneProfiler::~SceneProfiler()
+{
+}
+
+void SceneProfiler::BeginFrame()
+{
+	if(!Enabled)
+		return;
+
+	Clock::time_point now = Clock::now();
+	if(FrameOpen)
+	{
+		std::chrono::duration<double, std::milli> elapsed = now - FrameStart;
+		Current.Timers[PT_Frame] = elapsed.count();
+		EndFrame();
+	}
+
+	FrameStart = now;
+	FrameOpen = true;
+}
+
+// Push the current frame into the ring and clear it for the next one
+void SceneProfiler::EndFrame()
+{
+	if(History.size() < HistorySize)
+	{
+		History.push_back(Current);
+	}
+	else
+	{
+		History[Next] = Current;
+	}
+	Next = (Next + 1) % HistorySize;
+
+	memset(&Current, 0, sizeof(Current));
+}
+
+const FrameProfile& SceneProfiler::GetFrame(unsigned int framesAgo) const
+{
+	unsigned int count = (unsigned int)History.size();
+	if(count == 0)
+		return Current;
+	if(framesAgo >= count)
+		framesAgo = count - 1;
+
+	return History[(Next + HistorySize - 1 - framesAgo) % HistorySize];
+}
+
+ProfileStats SceneProfiler::GetTimerStats(ProfileTimer t) const
+{
+	std::vector<double> values;
+	values.reserve(History.size());
+	for(auto& frame : History)
+		values.push_back(frame.Timers[t]);
+
+	return ComputeStats(values);
+}
+
+ProfileStats SceneProfiler::GetCounterStats(ProfileCounter c) const
+{
+	std::vector<double> values;
+	values.reserve(History.size());
+	for(auto& frame : History)
+		values.push_back(frame.Counters[c]);
+
+	return ComputeStats(values);
+}
+
+ProfileStats SceneProfiler::ComputeStats(std::vector<double>& values) const
+{
+	ProfileStats stats = { 0.0, 0.0, 0.0, 0.0, (unsigned int)values.size() };
+	if(values.empty())
+		return stats;
+
+	double sum = 0.0;
+	stats.Min = values[0];
+	stats.Max = values[0];
+	for(double v : values)
+	{
+		sum += v;
+		stats.Min = std::min(stats.Min, v);
+		stats.Max = std::max(stats.Max, v);
+	}
+	stats.Avg = sum / values.size();
+
+	// nearest-rank 99th percentile
+	size_t rank = (values.size() * 99 + 99) / 100;
+	std::nth_element(values.begin(), values.begin() + (rank - 1), values.end());
+	stats.P99 = values[rank - 1];
+
+	return stats;
+}
+
+void SceneProfiler::Reset()
+{
+	History.clear();
+	Next = 0;
+	FrameOpen = false;
+	memset(&Current, 0, sizeof(Current));
+}
+
+void SceneProfiler::Print() const
+{
+	std::cout<<"Profile over "<<History.size()<<" frames (min / avg / p99 / max)"<<std::endl;
+	for(int t = 0; t < PT_Count; t++)
+	{
+		ProfileStats s = GetTimerStats((ProfileTimer)t);
+		std::cout<<"  "<<GetTimerName((ProfileTimer)t)<<" ms: "<<s.Min<<" / "<<s.Avg<<" / "<<s.P99<<" / "<<s.Max<<std::endl;
+	}
+	for(int c = 0; c < PC_Count; c++)
+	{
+		ProfileStats s = GetCounterStats((ProfileCounter)c);
+		std::cout<<"  "<<GetCounterName((ProfileCounter)c)<<": "<<s.Min<<" / "<<s.Avg<<" / "<<s.P99<<" / "<<s.Max<<std::endl;
+	}
+}
+
+const char* SceneProfiler::GetTimerName(ProfileTimer t)
+{
+	switch(t)
+	{
+	case PT_Frame:  return "Frame";
+	case PT_Update: return "Update";
+	case PT_Render: return "Render";
+	case PT_Broadphase: return "Broadphase";
+	case PT_Animation: return "Animation";
+	case PT_LOD: return "LOD";
+	case PT_Occlusion: return "Occlusion";
+	case PT_Culling: return "Culling";
+	default:        return "?";
+	}
+}
+
+const char* SceneProfiler::GetCounterName(ProfileCounter c)
+{
+	switch(c)
+	{
+	case PC_NodesVisited:    return "Nodes visited";
+	case PC_NodesRecomputed: return "Nodes recomputed";
+	case PC_DrawsEmitted:    return "Draws emitted";
+	case PC_NodesCulled:     return "Nodes culled";
+	case PC_Allocations:     return "Allocations";
+	default:                 return "?";
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+// Per-frame instrumentation for the scene. Counters and timers are
+// accumulated for the current frame and committed into a ring of the
+// last N frames, which can be queried as min/avg/max/p99.
+
+enum ProfileCounter
+{
+	PC_NodesVisited,
+	PC_NodesRecomputed,      // world matrix rebuilt because the local matrix or the parent moved
+	PC_DrawsEmitted,
+	PC_NodesCulled,
+	PC_Allocations,
+	PC_Count
+};
+
+enum ProfileTimer
+{
+	PT_Frame,    // time between two consecutive BeginFrame calls
+	PT_Update,
+	PT_Render,
+	PT_Broadphase,
+	PT_Animation,
+	PT_LOD,
+	PT_Occlusion,
+	PT_Culling,
+	PT_Count
+};
+
+struct ProfileStats
+{
+	double Min;
+	double Avg;
+	double Max;
+	double P99;
+	unsigned int Frames;
+};
+
+struct FrameProfile
+{
+	double Timers[PT_Count];     // milliseconds
+	unsigned int Counters[PC_Count];
+};
+
+class SceneProfiler
+{
+public:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	SceneProfiler(unsigned int historySize = 120);
+	~SceneProfiler();
+
+	void SetEnabled(bool e) { Enabled = e;}
+	bool IsEnabled() const { return Enabled;}
+
+	// Commits the frame in progress (if any) and starts a new one
+	void BeginFrame();
+	void EndFrame();
+
+	void Count(ProfileCounter c, unsigned int n = 1) { if(Enabled) Current.Counters[c] += n;}
+	void AddTime(ProfileTimer t, double ms) { if(Enabled) Current.Timers[t] += ms;}
+
+	ProfileStats GetTimerStats(ProfileTimer t) const;
+	ProfileStats GetCounterStats(ProfileCounter c) const;
+	const FrameProfile& GetCurrentFrame() const { return Current;}
+	unsigned int GetFrameCount() const { return (unsigned int)History.size();}
+	// 0 is the most recently committed frame
+	const FrameProfile& GetFrame(unsigned int framesAgo) const;
+
+	void Reset();
+	void Print() const;
+
+	static const char* GetTimerName(ProfileTimer t);
+	static const char* GetCounterName(ProfileCounter c);
+
+protected:
+	ProfileStats ComputeStats(std::vector<double>& values) const;
+
+	bool Enabled;
+	bool FrameOpen;
+	Clock::time_point FrameStart;
+	FrameProfile Current;
+	std::vector<FrameProfile> History;   // ring buffer
+	unsigned int HistorySize;
+	unsigned int Next;
+};
+
+// Adds the elapsed time of a scope to one of the profiler timers
+class ScopedTimer
+{
+public:
+	ScopedTimer(SceneProfiler* p, ProfileTimer t) : profiler(p), timer(t)
+	{
+		if(profiler && profiler->IsEnabled())
+			start = SceneProfiler::Clock::now();
+		else
+			profiler = nullptr;
+	}
+	~ScopedTimer()
+	{
+		if(profiler)
+		{
+			std::chrono::duration<double, std::milli> elapsed = SceneProfiler::Clock::now() - start;
+			profiler->AddTime(timer, elapsed.count());
+		}
+	}
+
+private:
+	SceneProfiler* profiler;
+	ProfileTimer timer;
+	SceneProfiler::Clock::time_point start;
+};
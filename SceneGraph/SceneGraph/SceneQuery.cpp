@@ -0,0 +1,313 @@
+#include "SceneQuery.h"
+#include "../Math3D/simd.h"
+#include <algorithm>
+
+
+QueryIndex::QueryIndex()
+{
+}
+
+QueryIndex::~QueryIndex()
+{
+}
+
+void QueryIndex::Clear()
+{
+	Nodes.clear();
+	SubtreeEnd.clear();
+	Tags.clear();
+	TypeBits.clear();
+	Names.clear();
+	X.clear(); Y.clear(); Z.clear(); R.clear();
+	SlotIndex.clear();
+}
+
+void QueryIndex::Build(SceneNode* root)
+{
+	Clear();
+	if(root)
+		Gather(root);
+}
+
+void QueryIndex::Gather(SceneNode* node)
+{
+	unsigned int index = (unsigned int)Nodes.size();
+	Nodes.push_back(node);
+	SubtreeEnd.push_back(0);
+	Tags.push_back(node->GetTags());
+	TypeBits.push_back(1u << node->GetNodeType());
+	Names.push_back(node->GetNameID());
+
+	Fvector center;
+	float radius;
+	node->GetWorldSphere(center, radius);
+	if(node->GetNodeType() == Node_Prefab && node->GetSubtreeRadius() >= 0.0f)
+	{
+		// a prefab's own sphere is a point; its instances are around the subtree sphere
+		center = node->GetSubtreeCenter();
+		radius = node->GetSubtreeRadius();
+	}
+	X.push_back(center.x);
+	Y.push_back(center.y);
+	Z.push_back(center.z);
+	R.push_back(radius);
+
+	unsigned int slot = node->GetStoreSlot();
+	if(slot != ~0u)
+	{
+		if(slot >= SlotIndex.size())
+			SlotIndex.resize(slot + 1, ~0u);
+		SlotIndex[slot] = index;
+	}
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		Gather(it->get());
+	}
+	SubtreeEnd[index] = (unsigned int)Nodes.size();
+}
+
+unsigned int QueryIndex::Find(const SceneNode* node) const
+{
+	unsigned int slot = node->GetStoreSlot();
+	if(slot >= SlotIndex.size())
+		return ~0u;
+	unsigned int index = SlotIndex[slot];
+	return index < Nodes.size() && Nodes[index] == node ? index : ~0u;
+}
+
+
+SceneQuery::SceneQuery()
+{
+	Reset();
+}
+
+SceneQuery::~SceneQuery()
+{
+}
+
+void SceneQuery::Reset()
+{
+	TypeMask = 0;
+	AllTags = AnyTags = NoTags = 0;
+	Pattern.clear();
+	Shape = Region_None;
+	SubtreeRoot = nullptr;
+	IncludeRoot = false;
+	Compiled = false;
+	PatternCache.clear();
+}
+
+SceneQuery& SceneQuery::OfType(NodeType type)
+{
+	TypeMask |= 1u << type;
+	Compiled = false;
+	return *this;
+}
+
+SceneQuery& SceneQuery::WithAllTags(unsigned int tags)
+{
+	AllTags |= tags;
+	Compiled = false;
+	return *this;
+}
+
+SceneQuery& SceneQuery::WithAnyTags(unsigned int tags)
+{
+	AnyTags |= tags;
+	Compiled = false;
+	return *this;
+}
+
+SceneQuery& SceneQuery::WithoutTags(unsigned int tags)
+{
+	NoTags |= tags;
+	Compiled = false;
+	return *this;
+}
+
+SceneQuery& SceneQuery::Named(const string& pattern)
+{
+	Pattern = pattern;
+	PatternCache.clear();
+	Compiled = false;
+	return *this;
+}
+
+SceneQuery& SceneQuery::InSphere(const Fvector& center, float radius)
+{
+	Shape = Region_Sphere;
+	RegionMin = center;
+	RegionMax = Fvector(radius, 0.0f, 0.0f);
+	return *this;
+}
+
+SceneQuery& SceneQuery::InBox(const Fvector& min, const Fvector& max)
+{
+	Shape = Region_Box;
+	RegionMin = min;
+	RegionMax = max;
+	return *this;
+}
+
+SceneQuery& SceneQuery::Under(const SceneNode* root, bool includeRoot)
+{
+	SubtreeRoot = root;
+	IncludeRoot = includeRoot;
+	return *this;
+}
+
+void SceneQuery::Compile()
+{
+	TestMasks = TypeMask != 0 || AllTags != 0 || AnyTags != 0 || NoTags != 0;
+	ExactName = Pattern.find_first_of("*?") == string::npos;
+	Compiled = true;
+}
+
+bool SceneQuery::MatchPattern(const char* pattern, const char* name)
+{
+	// greedy wildcard match, backtracking to the last '*'
+	const char* star = nullptr;
+	const char* resume = nullptr;
+	while(*name)
+	{
+		if(*pattern == '*')
+		{
+			star = pattern++;
+			resume = name;
+		}
+		else if(*pattern == '?' || *pattern == *name)
+		{
+			pattern++;
+			name++;
+		}
+		else if(star)
+		{
+			pattern = star + 1;
+			name = ++resume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	while(*pattern == '*')
+		pattern++;
+	return *pattern == 0;
+}
+
+bool SceneQuery::NameMatches(NameID name)
+{
+	auto it = PatternCache.find(name);
+	if(it != PatternCache.end())
+		return it->second;
+
+	bool match = MatchPattern(Pattern.c_str(), NameTable::GetString(name).c_str());
+	PatternCache[name] = match;
+	return match;
+}
+
+unsigned int SceneQuery::Run(const QueryIndex& index, QueryResult& result)
+{
+	if(!Compiled)
+		Compile();
+
+	result.Nodes.clear();
+	auto& candidates = result.Candidates;
+	candidates.clear();
+
+	// subtree -> index range
+	unsigned int first = 0, end = index.GetCount();
+	if(SubtreeRoot)
+	{
+		unsigned int root = index.Find(SubtreeRoot);
+		if(root == ~0u)
+			return 0;
+		first = IncludeRoot ? root : root + 1;
+		end = index.GetSubtreeEnd(root);
+	}
+
+	// tags and type
+	unsigned int i = first;
+	if(!TestMasks)
+	{
+		for(; i < end; i++)
+		{
+			candidates.push_back(i);
+		}
+	}
+#ifdef MATH3D_SSE
+	else
+	{
+		const __m128i all = _mm_set1_epi32((int)AllTags), any = _mm_set1_epi32((int)AnyTags), none = _mm_set1_epi32((int)NoTags);
+		const __m128i types = _mm_set1_epi32(TypeMask ? (int)TypeMask : -1);
+		const __m128i zero = _mm_setzero_si128();
+		const int anyFree = AnyTags ? 0 : 0xf;
+		for(; i + 4 <= end; i += 4)
+		{
+			__m128i tags = _mm_loadu_si128((const __m128i*)&index.Tags[i]);
+			__m128i bits = _mm_loadu_si128((const __m128i*)&index.TypeBits[i]);
+			__m128i pass = _mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(tags, all), all), _mm_cmpeq_epi32(_mm_and_si128(tags, none), zero));
+			int mask = _mm_movemask_ps(_mm_castsi128_ps(pass));
+			mask &= ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(bits, types), zero)));
+			mask &= anyFree | ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(tags, any), zero)));
+
+			while(mask)
+			{
+				int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+				candidates.push_back(i + lane);
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+	if(TestMasks)
+	{
+		unsigned int types = TypeMask ? TypeMask : ~0u;
+		for(; i < end; i++)
+		{
+			unsigned int tags = index.Tags[i];
+			if((tags & AllTags) == AllTags && !(tags & NoTags) && (!AnyTags || (tags & AnyTags)) && (index.TypeBits[i] & types))
+				candidates.push_back(i);
+		}
+	}
+
+	// names
+	if(!Pattern.empty())
+	{
+		NameID exact = ExactName ? NameTable::Find(Pattern) : InvalidName;
+		if(ExactName && exact == InvalidName)
+			candidates.clear();
+
+		size_t kept = 0;
+		for(unsigned int c : candidates)
+		{
+			if(ExactName ? index.Names[c] == exact : NameMatches(index.Names[c]))
+				candidates[kept++] = c;
+		}
+		candidates.resize(kept);
+	}
+
+	// region, against the world bounding spheres
+	for(unsigned int c : candidates)
+	{
+		if(Shape == Region_Sphere)
+		{
+			float dx = index.X[c] - RegionMin.x, dy = index.Y[c] - RegionMin.y, dz = index.Z[c] - RegionMin.z;
+			float reach = index.R[c] + RegionMax.x;
+			if(dx*dx + dy*dy + dz*dz > reach*reach)
+				continue;
+		}
+		else if(Shape == Region_Box)
+		{
+			float dx = std::max(0.0f, std::max(RegionMin.x - index.X[c], index.X[c] - RegionMax.x));
+			float dy = std::max(0.0f, std::max(RegionMin.y - index.Y[c], index.Y[c] - RegionMax.y));
+			float dz = std::max(0.0f, std::max(RegionMin.z - index.Z[c], index.Z[c] - RegionMax.z));
+			if(dx*dx + dy*dy + dz*dz > index.R[c]*index.R[c])
+				continue;
+		}
+		result.Nodes.push_back(index.Nodes[c]);
+	}
+
+	return result.GetCount();
+}
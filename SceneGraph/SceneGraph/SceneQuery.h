@@ -0,0 +1,123 @@
+#pragma once
+#include <vector>
+#include <map>
+#include "SceneNode.h"
+
+// Flattened copy of a scene's nodes in depth-first order, so a subtree is a
+// contiguous range. Tags, type bits, names and world bounding spheres are
+// kept in separate arrays for the query filters. Built by Scene on the first
+// query after each update or structural change.
+class QueryIndex
+{
+public:
+	QueryIndex();
+	~QueryIndex();
+
+	void Build(SceneNode* root);
+	void Clear();
+
+	unsigned int GetCount() const { return (unsigned int)Nodes.size();}
+	SceneNode* GetNode(unsigned int i) const { return Nodes[i];}
+	// Position of a node, or ~0u if it is not indexed
+	unsigned int Find(const SceneNode* node) const;
+	// One past the last descendant of node i
+	unsigned int GetSubtreeEnd(unsigned int i) const { return SubtreeEnd[i];}
+
+protected:
+	friend class SceneQuery;
+
+	void Gather(SceneNode* node);
+
+	TrackedVector<SceneNode*, Mem_Indices> Nodes;
+	TrackedVector<unsigned int, Mem_Indices> SubtreeEnd;
+	TrackedVector<unsigned int, Mem_Indices> Tags;
+	TrackedVector<unsigned int, Mem_Indices> TypeBits;  // 1 << NodeType
+	TrackedVector<NameID, Mem_Indices> Names;
+	TrackedVector<float, Mem_Indices> X, Y, Z, R;
+	TrackedVector<unsigned int, Mem_Indices> SlotIndex; // NodeStore slot -> position
+};
+
+// Nodes selected by a query. Keeps its storage between runs, so a result
+// reused every frame stops allocating once it has grown to size.
+class QueryResult
+{
+public:
+	QueryResult(unsigned int capacity = 0) { Nodes.reserve(capacity); Candidates.reserve(capacity);}
+
+	unsigned int GetCount() const { return (unsigned int)Nodes.size();}
+	bool IsEmpty() const { return Nodes.empty();}
+	SceneNode* operator[](unsigned int i) const { return Nodes[i];}
+	SceneNode* const* begin() const { return Nodes.data();}
+	SceneNode* const* end() const { return Nodes.data() + Nodes.size();}
+	void Clear() { Nodes.clear();}
+
+protected:
+	friend class SceneQuery;
+
+	TrackedVector<SceneNode*, Mem_Indices> Nodes;
+	TrackedVector<unsigned int, Mem_Indices> Candidates;
+};
+
+// Node filter built from chained conditions, all of which must hold:
+//
+//   SceneQuery enemies;
+//   enemies.OfType(Node_Mesh).WithAllTags(TAG_ENEMY).InSphere(player, 50.0f);
+//   scene.Query(enemies, result);
+//
+// Compile turns the conditions into a plan run cheapest first: the subtree
+// becomes an index range, tags and types are tested four nodes at a time
+// with SSE, then names and finally the spatial region are checked on the
+// nodes left. Queries are meant to be built once and run every frame.
+class SceneQuery
+{
+public:
+	SceneQuery();
+	~SceneQuery();
+
+	// Any of the types given (repeat to add more)
+	SceneQuery& OfType(NodeType type);
+	SceneQuery& WithAllTags(unsigned int tags);
+	SceneQuery& WithAnyTags(unsigned int tags);
+	SceneQuery& WithoutTags(unsigned int tags);
+	// Exact name, or a pattern with '*' (any run) and '?' (any one character)
+	SceneQuery& Named(const string& pattern);
+	// Nodes whose world bounding sphere touches the region
+	SceneQuery& InSphere(const Fvector& center, float radius);
+	SceneQuery& InBox(const Fvector& min, const Fvector& max);
+	// Descendants of root, optionally with root itself; the node must outlive the query's use
+	SceneQuery& Under(const SceneNode* root, bool includeRoot = false);
+	// Drop all conditions
+	void Reset();
+
+	// Done by Run when the conditions changed
+	void Compile();
+	// Replaces the result's nodes with the matches; returns their number
+	unsigned int Run(const QueryIndex& index, QueryResult& result);
+
+	static bool MatchPattern(const char* pattern, const char* name);
+
+protected:
+	enum Region
+	{
+		Region_None,
+		Region_Sphere,
+		Region_Box
+	};
+
+	bool NameMatches(NameID name);
+
+	// conditions
+	unsigned int TypeMask;     // 0 = any type
+	unsigned int AllTags, AnyTags, NoTags;
+	string Pattern;
+	Region Shape;
+	Fvector RegionMin, RegionMax;   // box, or center and radius in RegionMin / RegionMax.x
+	const SceneNode* SubtreeRoot;
+	bool IncludeRoot;
+
+	// plan
+	bool Compiled;
+	bool TestMasks;
+	bool ExactName;
+	TrackedMap<NameID, bool, Mem_Indices> PatternCache;   // names are immutable per id, so results keep
+};
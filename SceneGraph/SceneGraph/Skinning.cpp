@@ -0,0 +1,146 @@
+#include "Skinning.h"
+#include "../Math3D/matrixops.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+
+SkinningPalette::SkinningPalette()
+{
+	Data = nullptr;
+	Count = 0;
+	Capacity = 0;
+}
+
+SkinningPalette::~SkinningPalette()
+{
+	Math3d::alignedFree(Data);
+}
+
+SkinningPalette::SkinningPalette(SkinningPalette&& other)
+{
+	Data = other.Data;
+	Count = other.Count;
+	Capacity = other.Capacity;
+	other.Data = nullptr;
+	other.Count = 0;
+	other.Capacity = 0;
+}
+
+SkinningPalette& SkinningPalette::operator=(SkinningPalette&& other)
+{
+	if(this != &other)
+	{
+		Math3d::alignedFree(Data);
+		Data = other.Data;
+		Count = other.Count;
+		Capacity = other.Capacity;
+		other.Data = nullptr;
+		other.Count = 0;
+		other.Capacity = 0;
+	}
+	return *this;
+}
+
+void SkinningPalette::Resize(unsigned int matrices)
+{
+	if(matrices > Capacity)
+	{
+		Math3d::alignedFree(Data);
+		Data = (float*)Math3d::alignedAlloc(matrices*16*sizeof(float), 64);
+		Capacity = matrices;
+	}
+	Count = matrices;
+}
+
+
+Skeleton::Skeleton(shared_ptr<SceneNode> root)
+{
+	Root = root;
+	GatherJoints(root.get());
+
+	InverseBind.reserve(Joints.size());
+	for(SceneNode* joint : Joints)
+	{
+		InverseBind.push_back(joint->GetWorldTransformation().getInverse());
+	}
+}
+
+Skeleton::Skeleton(shared_ptr<SceneNode> root, const std::vector<FSmatrix4>& inverseBind)
+{
+	Root = root;
+	GatherJoints(root.get());
+
+	InverseBind.assign(inverseBind.begin(), inverseBind.end());
+	InverseBind.resize(Joints.size(), FSmatrix4::identity());
+}
+
+Skeleton::~Skeleton()
+{
+}
+
+void Skeleton::GatherJoints(SceneNode* node)
+{
+	if(!node || node->IsLeafNode())
+		return;
+
+	Joints.push_back(node);
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		GatherJoints(it->get());
+	}
+}
+
+void Skeleton::BuildPalette(SkinningPalette& palette) const
+{
+	unsigned int count = GetJointCount();
+	palette.Resize(count);
+
+	float* out = palette.GetData();
+	for(unsigned int i = 0; i < count; i++)
+	{
+		Math3d::multiplyMatrix4(Joints[i]->GetWorldTransformation().getData(), InverseBind[i].getData(), out + i*16);
+	}
+}
+
+void BuildPalettes(const std::vector<const Skeleton*>& skeletons, std::vector<SkinningPalette>& palettes, unsigned int threads)
+{
+	palettes.resize(skeletons.size());
+	if(skeletons.empty())
+		return;
+
+	if(threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, (unsigned int)skeletons.size());
+
+	// workers pull small batches of skeletons so uneven skeleton sizes balance out
+	const unsigned int batch = 8;
+	std::atomic<unsigned int> next(0);
+	auto worker = [&]()
+	{
+		for(;;)
+		{
+			unsigned int first = next.fetch_add(batch);
+			if(first >= skeletons.size())
+				break;
+
+			unsigned int last = std::min(first + batch, (unsigned int)skeletons.size());
+			for(unsigned int i = first; i < last; i++)
+			{
+				skeletons[i]->BuildPalette(palettes[i]);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for(unsigned int t = 1; t < threads; t++)
+	{
+		pool.push_back(std::thread(worker));
+	}
+	worker();
+
+	for(auto& t : pool)
+	{
+		t.join();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+
+// Skinning matrix palettes built from scene node hierarchies.
+// The joints of a skeleton are the non-leaf nodes of a subtree in
+// depth-first order (leaf MeshNodes are attachments, not joints).
+
+// Contiguous, 64-byte aligned array of column-major 4x4 float matrices
+class SkinningPalette
+{
+public:
+	SkinningPalette();
+	~SkinningPalette();
+	SkinningPalette(SkinningPalette&& other);
+	SkinningPalette& operator=(SkinningPalette&& other);
+
+	void Resize(unsigned int matrices);
+	unsigned int GetCount() const { return Count;}
+	const float* GetData() const { return Data;}
+	float* GetData() { return Data;}
+	const float* GetMatrix(unsigned int joint) const { return Data + joint*16;}
+
+private:
+	SkinningPalette(const SkinningPalette&);
+	SkinningPalette& operator=(const SkinningPalette&);
+
+	float* Data;
+	unsigned int Count;
+	unsigned int Capacity;
+};
+
+class Skeleton
+{
+public:
+	// Captures the current world transforms of the joints as the bind pose
+	Skeleton(shared_ptr<SceneNode> root);
+	// One inverse bind matrix per joint, in joint order
+	Skeleton(shared_ptr<SceneNode> root, const std::vector<FSmatrix4>& inverseBind);
+	~Skeleton();
+
+	unsigned int GetJointCount() const { return (unsigned int)Joints.size();}
+	const SceneNode* GetJoint(unsigned int joint) const { return Joints[joint];}
+	shared_ptr<SceneNode> GetRoot() const { return Root;}
+
+	// palette[i] = WorldTransformation(joint i) * inverseBind[i]
+	void BuildPalette(SkinningPalette& palette) const;
+
+protected:
+	void GatherJoints(SceneNode* node);
+
+	shared_ptr<SceneNode> Root;
+	TrackedVector<SceneNode*, Mem_Transforms> Joints;
+	TrackedVector<FSmatrix4, Mem_Transforms> InverseBind;
+};
+
+// Builds palettes[i] for skeletons[i], spread across worker threads
+// (threads = 0 uses one per hardware thread)
+void BuildPalettes(const std::vector<const Skeleton*>& skeletons, std::vector<SkinningPalette>& palettes, unsigned int threads = 0);
@@ -0,0 +1,93 @@
+#include "StaticBlock.h"
+
+
+StaticBlock::StaticBlock()
+{
+}
+
+StaticBlock::~StaticBlock()
+{
+}
+
+unsigned int StaticBlock::Bake(SceneNode* root)
+{
+	if(!root || root->IsBaked())
+		return 0;
+
+	// Subtrees baked earlier under root are merged into its range, so no
+	// node ends up in two ranges
+	for(size_t r = Ranges.size(); r-- > 0;)
+	{
+		SceneNode* n = Ranges[r].Root->GetParent();
+		while(n && n != root)
+			n = n->GetParent();
+		if(n)
+			Unbake(Ranges[r].Root);
+	}
+
+	Range range;
+	range.Root = root;
+	range.First = (unsigned int)Nodes.size();
+	Gather(root);
+	range.Count = (unsigned int)Nodes.size() - range.First;
+	Ranges.push_back(range);
+
+	return range.Count;
+}
+
+void StaticBlock::Gather(SceneNode* node)
+{
+	node->SetBaked(true);
+	Nodes.push_back(node);
+	World.push_back(node->GetWorldTransformation());
+
+	const Fvector& c = node->GetSubtreeCenter();
+	Spheres.push_back(c.x);
+	Spheres.push_back(c.y);
+	Spheres.push_back(c.z);
+	Spheres.push_back(node->GetSubtreeRadius());
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		Gather(it->get());
+	}
+}
+
+bool StaticBlock::Unbake(SceneNode* root)
+{
+	for(size_t r = 0; r < Ranges.size(); r++)
+	{
+		if(Ranges[r].Root != root)
+			continue;
+
+		unsigned int first = Ranges[r].First, count = Ranges[r].Count;
+		for(unsigned int i = first; i < first + count; i++)
+		{
+			Nodes[i]->SetBaked(false);
+		}
+
+		// close the gap; later ranges move down
+		Nodes.erase(Nodes.begin() + first, Nodes.begin() + first + count);
+		World.erase(World.begin() + first, World.begin() + first + count);
+		Spheres.erase(Spheres.begin() + first*4, Spheres.begin() + (first + count)*4);
+		Ranges.erase(Ranges.begin() + r);
+		for(size_t i = r; i < Ranges.size(); i++)
+		{
+			Ranges[i].First -= count;
+		}
+		return true;
+	}
+	return false;
+}
+
+void StaticBlock::Clear()
+{
+	for(SceneNode* node : Nodes)
+	{
+		node->SetBaked(false);
+	}
+	Ranges.clear();
+	Nodes.clear();
+	World.clear();
+	Spheres.clear();
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+
+// Compact read-only copy of baked static subtrees. World matrices and
+// subtree bounding spheres of all baked nodes are stored contiguously, one
+// range per baked subtree in depth-first order, so consumers can walk static
+// geometry without touching the nodes; the nodes themselves are marked baked
+// and skipped by the per-frame Update.
+class StaticBlock
+{
+public:
+	StaticBlock();
+	~StaticBlock();
+
+	// Freeze the subtree at root with its current world transformations;
+	// baked subtrees below root are absorbed. Returns the number of nodes
+	// in the new range
+	unsigned int Bake(SceneNode* root);
+	// Unfreeze the baked subtree that has root as its baked root
+	bool Unbake(SceneNode* root);
+	void Clear();
+
+	unsigned int GetNodeCount() const { return (unsigned int)Nodes.size();}
+	unsigned int GetSubtreeCount() const { return (unsigned int)Ranges.size();}
+	SceneNode* GetNode(unsigned int i) const { return Nodes[i];}
+	const FSmatrix4& GetWorld(unsigned int i) const { return World[i];}
+	// xyz = center, w = radius
+	const float* GetSphere(unsigned int i) const { return &Spheres[i * 4];}
+
+protected:
+	struct Range
+	{
+		SceneNode* Root;
+		unsigned int First;
+		unsigned int Count;
+	};
+
+	void Gather(SceneNode* node);
+
+	TrackedVector<Range, Mem_Indices> Ranges;
+	TrackedVector<SceneNode*, Mem_Indices> Nodes;
+	TrackedVector<FSmatrix4, Mem_Transforms> World;
+	TrackedVector<float, Mem_Transforms> Spheres;
+};
@@ -0,0 +1,170 @@
+#include "UpdateScheduler.h"
+#include <algorithm>
+
+
+UpdateScheduler::UpdateScheduler()
+{
+	for(int t = 0; t < Tier_Count; t++)
+	{
+		Budgets[t] = 0;
+		Updated[t] = 0;
+	}
+	Frame = 0;
+	Time = 0.0;
+}
+
+UpdateScheduler::~UpdateScheduler()
+{
+	Clear();
+}
+
+unsigned int UpdateScheduler::FindEntry(SceneNode* node) const
+{
+	auto it = EntryMap.find(node);
+	return it == EntryMap.end() ? ~0u : it->second;
+}
+
+void UpdateScheduler::AddNode(shared_ptr<SceneNode> node, UpdateTier tier, unsigned int interval)
+{
+	if(!node)
+		return;
+
+	RemoveNode(node.get());
+	if(tier == Tier_EveryFrame)
+		return;
+
+	Entry entry;
+	entry.Node = node;
+	entry.Tier = tier;
+	entry.Interval = std::max(1u, interval);
+	entry.Phase = 0;
+	entry.LastUpdate = Time;
+	entry.Queued = false;
+
+	unsigned int index;
+	if(FreeEntries.empty())
+	{
+		index = (unsigned int)Entries.size();
+		Entries.push_back(entry);
+	}
+	else
+	{
+		index = FreeEntries.back();
+		FreeEntries.pop_back();
+		Entries[index] = entry;
+	}
+	EntryMap[node.get()] = index;
+	node->SetUpdateTier(tier);
+
+	if(tier == Tier_Interval)
+	{
+		// round robin over the phases of this interval
+		Entry& e = Entries[index];
+		e.Phase = NextPhase[e.Interval]++ % e.Interval;
+		auto& phases = Buckets[e.Interval];
+		phases.resize(e.Interval);
+		phases[e.Phase].push_back(index);
+	}
+}
+
+void UpdateScheduler::RemoveNode(SceneNode* node)
+{
+	unsigned int index = FindEntry(node);
+	if(index == ~0u)
+		return;
+
+	Entry& e = Entries[index];
+	if(e.Tier == Tier_Interval)
+	{
+		Bucket& bucket = Buckets[e.Interval][e.Phase];
+		bucket.erase(std::remove(bucket.begin(), bucket.end(), index), bucket.end());
+	}
+	if(e.Queued)
+	{
+		TierQueue& queue = Queues[e.Tier];
+		queue.erase(std::remove(queue.begin(), queue.end(), index), queue.end());
+	}
+
+	e.Node->SetUpdateTier(Tier_EveryFrame);
+	e.Node.reset();
+	EntryMap.erase(node);
+	FreeEntries.push_back(index);
+}
+
+void UpdateScheduler::Clear()
+{
+	for(Entry& e : Entries)
+	{
+		if(e.Node)
+			e.Node->SetUpdateTier(Tier_EveryFrame);
+	}
+	Entries.clear();
+	FreeEntries.clear();
+	EntryMap.clear();
+	Buckets.clear();
+	NextPhase.clear();
+	for(int t = 0; t < Tier_Count; t++)
+	{
+		Queues[t].clear();
+	}
+}
+
+void UpdateScheduler::Enqueue(unsigned int entry)
+{
+	Entry& e = Entries[entry];
+	if(!e.Queued)
+	{
+		e.Queued = true;
+		Queues[e.Tier].push_back(entry);
+	}
+}
+
+void UpdateScheduler::Request(SceneNode* node)
+{
+	unsigned int index = FindEntry(node);
+	if(index != ~0u)
+		Enqueue(index);
+}
+
+void UpdateScheduler::Refresh()
+{
+	for(Entry& e : Entries)
+	{
+		if(e.Node)
+			e.Node->Update(0.0f);
+	}
+}
+
+unsigned int UpdateScheduler::Update(float dt)
+{
+	Time += dt;
+
+	for(auto& interval : Buckets)
+	{
+		for(unsigned int index : interval.second[Frame % interval.first])
+		{
+			Enqueue(index);
+		}
+	}
+	Frame++;
+
+	// nodes over budget stay queued, in order, for the next frame
+	unsigned int total = 0;
+	for(int t = 0; t < Tier_Count; t++)
+	{
+		TierQueue& queue = Queues[t];
+		unsigned int count = Budgets[t] ? std::min(Budgets[t], (unsigned int)queue.size()) : (unsigned int)queue.size();
+
+		for(unsigned int i = 0; i < count; i++)
+		{
+			Entry& e = Entries[queue.front()];
+			queue.pop_front();
+			e.Queued = false;
+			e.Node->Update((float)(Time - e.LastUpdate));
+			e.LastUpdate = Time;
+		}
+		Updated[t] = count;
+		total += count;
+	}
+	return total;
+}
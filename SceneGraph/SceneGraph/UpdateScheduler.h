@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <map>
+#include "SceneNode.h"
+
+// Time-sliced updates for nodes that do not need to run every frame.
+// Interval nodes are given a phase when added, so the nodes of each interval
+// are spread evenly over its frames; on-demand nodes only run after Request.
+// Due nodes wait in a queue per tier and every tier updates at most its
+// budget of nodes per frame. Each node's Update gets the time that passed
+// since its previous update, however many frames that was.
+class UpdateScheduler
+{
+public:
+	UpdateScheduler();
+	~UpdateScheduler();
+
+	// The node and its subtree leave the per-frame traversal; interval is in frames
+	void AddNode(shared_ptr<SceneNode> node, UpdateTier tier, unsigned int interval = 1);
+	void RemoveNode(SceneNode* node);
+	void Clear();
+	unsigned int GetNodeCount() const { return (unsigned int)(Entries.size() - FreeEntries.size());}
+
+	// Queue an update for the node; ignored if it is already waiting
+	void Request(SceneNode* node);
+
+	// Maximum number of nodes of a tier updated per frame, 0 = unlimited
+	void SetBudget(UpdateTier tier, unsigned int maxNodes) { Budgets[tier] = maxNodes;}
+	unsigned int GetBudget(UpdateTier tier) const { return Budgets[tier];}
+
+	// Update every node now without advancing its time or schedule, for when
+	// the world moved under them (e.g. the render origin changed)
+	void Refresh();
+
+	// Run the nodes due this frame; returns how many were updated
+	unsigned int Update(float dt);
+	unsigned int GetUpdated(UpdateTier tier) const { return Updated[tier];}
+	unsigned int GetPending(UpdateTier tier) const { return (unsigned int)Queues[tier].size();}
+
+protected:
+	struct Entry
+	{
+		shared_ptr<SceneNode> Node;
+		UpdateTier Tier;
+		unsigned int Interval;
+		unsigned int Phase;
+		double LastUpdate;
+		bool Queued;
+	};
+
+	typedef TrackedVector<unsigned int, Mem_Hierarchy> Bucket;
+	typedef std::deque<unsigned int, TrackedAllocator<unsigned int, Mem_Hierarchy>> TierQueue;
+
+	unsigned int FindEntry(SceneNode* node) const;
+	void Enqueue(unsigned int entry);
+
+	TrackedVector<Entry, Mem_Hierarchy> Entries;
+	TrackedVector<unsigned int, Mem_Hierarchy> FreeEntries;
+	TrackedMap<SceneNode*, unsigned int, Mem_Hierarchy> EntryMap;
+	// interval -> entries per phase
+	TrackedMap<unsigned int, TrackedVector<Bucket, Mem_Hierarchy>, Mem_Hierarchy> Buckets;
+	TrackedMap<unsigned int, unsigned int, Mem_Hierarchy> NextPhase;
+	TierQueue Queues[Tier_Count];
+	unsigned int Budgets[Tier_Count];
+	unsigned int Updated[Tier_Count];
+
+	unsigned int Frame;
+	double Time;
+};
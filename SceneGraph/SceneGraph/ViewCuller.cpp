@@ -0,0 +1,140 @@
+#include "ViewCuller.h"
+#include "Prefab.h"
+#include "../Math3D/simd.h"
+
+
+ViewCuller::ViewCuller()
+{
+	SphereTests = 0;
+}
+
+ViewCuller::~ViewCuller()
+{
+}
+
+unsigned int ViewCuller::AddView(const Frustum& frustum)
+{
+	if(Views.size() >= MaxViews)
+		return MaxViews;
+
+	ViewPlanes view;
+	for(int p = 0; p < 8; p++)
+	{
+		bool pad = p >= 6;
+		view.NX[p] = pad ? 0.0f : frustum.Planes[p][0];
+		view.NY[p] = pad ? 0.0f : frustum.Planes[p][1];
+		view.NZ[p] = pad ? 0.0f : frustum.Planes[p][2];
+		view.D[p] = pad ? 1.0e30f : frustum.Planes[p][3];
+	}
+	Views.push_back(view);
+	return (unsigned int)Views.size() - 1;
+}
+
+void ViewCuller::Cull(SceneNode* root)
+{
+	Nodes.clear();
+	Masks.clear();
+	Prefabs.clear();
+	PrefabMasks.clear();
+	ViewNodes.resize(Views.size());
+	for(auto& list : ViewNodes)
+	{
+		list.clear();
+	}
+	SphereTests = 0;
+
+	if(!root || Views.empty())
+		return;
+
+	ViewMask all = Views.size() == MaxViews ? ~0u : (1u << Views.size()) - 1;
+	Walk(root, all, 0);
+
+	for(size_t i = 0; i < Nodes.size(); i++)
+	{
+		for(ViewMask m = Masks[i]; m; m &= m - 1)
+		{
+			unsigned int view = 0;
+			while(!(m & (1u << view)))
+				view++;
+			ViewNodes[view].push_back(Nodes[i]);
+		}
+	}
+}
+
+void ViewCuller::Walk(SceneNode* node, ViewMask undecided, ViewMask accepted)
+{
+	float radius = node->GetSubtreeRadius();
+	if(radius < 0.0f)
+		return;
+
+	const Fvector& center = node->GetSubtreeCenter();
+	for(ViewMask m = undecided; m; m &= m - 1)
+	{
+		unsigned int view = 0;
+		while(!(m & (1u << view)))
+			view++;
+
+		SphereTests++;
+		FrustumTest test = TestView(Views[view], center, radius);
+		if(test != FT_Intersects)
+		{
+			undecided &= ~(1u << view);
+			if(test == FT_Inside)
+				accepted |= 1u << view;
+		}
+	}
+
+	if(!(undecided | accepted))
+		return;
+
+	if(node->IsLeafNode())
+	{
+		MeshNode* mesh = dynamic_cast<MeshNode*>(node);
+		if(mesh)
+		{
+			Nodes.push_back(mesh);
+			Masks.push_back(undecided | accepted);
+		}
+		else if(PrefabNode* prefab = dynamic_cast<PrefabNode*>(node))
+		{
+			Prefabs.push_back(prefab);
+			PrefabMasks.push_back(undecided | accepted);
+		}
+		return;
+	}
+
+	for(auto it = node->GetChildInteratorStart(); it != node->GetChildInteratorEnd(); ++it)
+	{
+		Walk(it->get(), undecided, accepted);
+	}
+}
+
+FrustumTest ViewCuller::TestView(const ViewPlanes& view, const Fvector& center, float radius) const
+{
+#ifdef MATH3D_SSE
+	__m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	__m128 r = _mm_set1_ps(radius), negR = _mm_set1_ps(-radius);
+	int outside = 0, intersects = 0;
+	for(int p = 0; p < 8; p += 4)
+	{
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&view.NX[p]), cx), _mm_mul_ps(_mm_loadu_ps(&view.NY[p]), cy)),
+							  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&view.NZ[p]), cz), _mm_loadu_ps(&view.D[p])));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(d, negR));
+		intersects |= _mm_movemask_ps(_mm_cmplt_ps(d, r));
+	}
+	if(outside)
+		return FT_Outside;
+	return intersects ? FT_Intersects : FT_Inside;
+#else
+	FrustumTest result = FT_Inside;
+	for(int p = 0; p < 6; p++)
+	{
+		float d = view.NX[p]*center.x + view.NY[p]*center.y + view.NZ[p]*center.z + view.D[p];
+		if(d < -radius)
+			return FT_Outside;
+		if(d < radius)
+			result = FT_Intersects;
+	}
+	return result;
+#endif
+}
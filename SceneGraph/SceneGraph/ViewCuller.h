@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include "SceneNode.h"
+#include "Frustum.h"
+
+class PrefabNode;
+
+// One bit per view
+typedef unsigned int ViewMask;
+
+// Multi-view frustum culling in a single walk of the graph. Every node's
+// subtree sphere is tested only against the views still undecided for it:
+// views that reject the sphere drop out for the whole subtree, views that
+// contain it entirely accept the subtree without further tests. Each
+// visible MeshNode is reported once with the mask of views that see it.
+class ViewCuller
+{
+public:
+	static const unsigned int MaxViews = 32;
+
+	ViewCuller();
+	~ViewCuller();
+
+	void ClearViews() { Views.clear();}
+	// Returns the view index, or MaxViews once all slots are taken
+	unsigned int AddView(const Frustum& frustum);
+	unsigned int GetViewCount() const { return (unsigned int)Views.size();}
+
+	void Cull(SceneNode* root);
+
+	// Visible meshes with the views they are visible in
+	const MeshNodeList& GetVisibleNodes() const { return Nodes;}
+	const TrackedVector<ViewMask, Mem_Render>& GetVisibleMasks() const { return Masks;}
+	// Visible meshes of a single view
+	const MeshNodeList& GetViewNodes(unsigned int view) const { return ViewNodes[view];}
+	// Visible prefab instance sets, culled as a whole
+	const TrackedVector<PrefabNode*, Mem_Render>& GetVisiblePrefabs() const { return Prefabs;}
+	const TrackedVector<ViewMask, Mem_Render>& GetPrefabMasks() const { return PrefabMasks;}
+	unsigned int GetSphereTests() const { return SphereTests;}
+
+protected:
+	// Planes in SoA order so one sphere is tested against a view's six planes
+	// in two SIMD steps; the last two lanes are padding that always pass
+	struct ViewPlanes
+	{
+		float NX[8], NY[8], NZ[8], D[8];
+	};
+
+	void Walk(SceneNode* node, ViewMask undecided, ViewMask accepted);
+	FrustumTest TestView(const ViewPlanes& view, const Fvector& center, float radius) const;
+
+	TrackedVector<ViewPlanes, Mem_Render> Views;
+	MeshNodeList Nodes;
+	TrackedVector<ViewMask, Mem_Render> Masks;
+	TrackedVector<MeshNodeList, Mem_Render> ViewNodes;
+	TrackedVector<PrefabNode*, Mem_Render> Prefabs;
+	TrackedVector<ViewMask, Mem_Render> PrefabMasks;
+	unsigned int SphereTests;
+};
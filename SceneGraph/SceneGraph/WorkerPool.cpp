@@ -0,0 +1,83 @@
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool()
+{
+	Task = nullptr;
+	Next = 0;
+	Count = 0;
+	Pending = 0;
+	Quit = false;
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Quit = true;
+	}
+	Wake.notify_all();
+	for(auto& t : Workers)
+	{
+		t.join();
+	}
+}
+
+void WorkerPool::Reserve(unsigned int threads)
+{
+	while(Workers.size() + 1 < threads)
+	{
+		Workers.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+	}
+}
+
+void WorkerPool::Run(unsigned int count, const std::function<void(unsigned int)>& task)
+{
+	if(count == 0)
+		return;
+	if(Workers.empty() || count == 1)
+	{
+		for(unsigned int i = 0; i < count; i++)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(Lock);
+	Task = &task;
+	Next = 0;
+	Count = count;
+	Pending = count;
+	Wake.notify_all();
+
+	Drain(lock);
+	Done.wait(lock, [this]() { return Pending == 0; });
+	Task = nullptr;
+}
+
+void WorkerPool::Drain(std::unique_lock<std::mutex>& lock)
+{
+	while(Next < Count)
+	{
+		unsigned int i = Next++;
+		const std::function<void(unsigned int)>& task = *Task;
+		lock.unlock();
+		task(i);
+		lock.lock();
+		if(--Pending == 0)
+			Done.notify_all();
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	for(;;)
+	{
+		Wake.wait(lock, [this]() { return Quit || Next < Count; });
+		if(Quit)
+			return;
+		Drain(lock);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Worker threads that stay alive between frames. Run hands out task
+// indices to the workers and the calling thread and returns once all of
+// them are done, so per-frame work is spread without creating threads.
+class WorkerPool
+{
+public:
+	WorkerPool();
+	~WorkerPool();
+
+	// Threads that take part in Run, counting the caller; workers are
+	// started as needed and never stopped before the pool is destroyed
+	void Reserve(unsigned int threads);
+	unsigned int GetThreadCount() const { return (unsigned int)Workers.size() + 1;}
+
+	// task(i) for every i in [0, count)
+	void Run(unsigned int count, const std::function<void(unsigned int)>& task);
+
+protected:
+	void WorkerLoop();
+	// Claims and runs tasks of the current batch until none are left
+	void Drain(std::unique_lock<std::mutex>& lock);
+
+	std::vector<std::thread> Workers;
+	std::mutex Lock;
+	std::condition_variable Wake;
+	std::condition_variable Done;
+	const std::function<void(unsigned int)>* Task;
+	unsigned int Next;
+	unsigned int Count;
+	unsigned int Pending;     // tasks of the batch not finished yet
+	bool Quit;
+};